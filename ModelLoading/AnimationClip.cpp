@@ -0,0 +1,373 @@
+#include "AnimationClip.h"
+#include <algorithm>
+#include <cmath>
+#include <emmintrin.h>
+
+namespace
+{
+	//Last key at or before time, the first one when time is before every key
+	template<typename Key>
+	unsigned int findKey(const std::vector<Key>& keys, float time)
+	{
+		auto next = std::upper_bound(keys.begin(), keys.end(), time, [](float t, const Key& key) { return t < key.time; });
+		if (next == keys.begin())
+		{
+			return 0;
+		}
+		return (next - keys.begin()) - 1;
+	}
+
+	template<typename Key>
+	float keyFactor(const Key& a, const Key& b, float time)
+	{
+		float span = b.time - a.time;
+		return span > 0 ? glm::clamp((time - a.time) / span, 0.0f, 1.0f) : 0.0f;
+	}
+
+	glm::vec3 sampleVector(const std::vector<VectorKey>& keys, float time, const glm::vec3& fallback)
+	{
+		if (keys.empty())
+		{
+			return fallback;
+		}
+		unsigned int i = findKey(keys, time);
+		if (i + 1 >= keys.size())
+		{
+			return keys[i].value;
+		}
+		return glm::mix(keys[i].value, keys[i + 1].value, keyFactor(keys[i], keys[i + 1], time));
+	}
+
+	glm::fquat sampleRotation(const std::vector<RotationKey>& keys, float time)
+	{
+		if (keys.empty())
+		{
+			return glm::fquat(1, 0, 0, 0);
+		}
+		unsigned int i = findKey(keys, time);
+		if (i + 1 >= keys.size())
+		{
+			return keys[i].value;
+		}
+		return glm::slerp(keys[i].value, keys[i + 1].value, keyFactor(keys[i], keys[i + 1], time));
+	}
+
+	unsigned int roundUpToFour(unsigned int count)
+	{
+		return (count + 3) & ~3u;
+	}
+
+	int16_t quantizeUnit(float value)
+	{
+		return (int16_t)std::lround(glm::clamp(value, -1.0f, 1.0f) * 32767.0f);
+	}
+
+	//Four quaternions stored x, y, z, w as 16 bit integers, returned one component per register
+	inline void loadQuaternions(const int16_t* source, __m128& x, __m128& y, __m128& z, __m128& w)
+	{
+		const __m128 scale = _mm_set1_ps(1.0f / 32767.0f);
+		__m128i first = _mm_loadu_si128((const __m128i*)source);
+		__m128i second = _mm_loadu_si128((const __m128i*)(source + 8));
+		//Each 16 bit value goes to the top of a 32 bit lane and is shifted back down with its sign
+		__m128 q0 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(first, first), 16)), scale);
+		__m128 q1 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(first, first), 16)), scale);
+		__m128 q2 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(second, second), 16)), scale);
+		__m128 q3 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(second, second), 16)), scale);
+		_MM_TRANSPOSE4_PS(q0, q1, q2, q3);
+		x = q0;
+		y = q1;
+		z = q2;
+		w = q3;
+	}
+
+	//Normalized lerp with its factor corrected by a curve fitted to slerp over the angle between the
+	//inputs, so four rotations cost a few multiplies instead of four acos and sin calls
+	inline void slerpFour(__m128 ax, __m128 ay, __m128 az, __m128 aw, __m128 bx, __m128 by, __m128 bz, __m128 bw, __m128 t, __m128& x, __m128& y, __m128& z, __m128& w)
+	{
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 half = _mm_set1_ps(0.5f);
+		__m128 cosine = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+		__m128 sign = _mm_and_ps(cosine, signMask);
+		__m128 d = _mm_andnot_ps(signMask, cosine);
+
+		__m128 A = _mm_add_ps(_mm_set1_ps(1.0904f), _mm_mul_ps(d, _mm_add_ps(_mm_set1_ps(-3.2452f), _mm_mul_ps(d, _mm_sub_ps(_mm_set1_ps(3.55645f), _mm_mul_ps(d, _mm_set1_ps(1.43519f)))))));
+		__m128 B = _mm_add_ps(_mm_set1_ps(0.848013f), _mm_mul_ps(d, _mm_add_ps(_mm_set1_ps(-1.06021f), _mm_mul_ps(d, _mm_set1_ps(0.215638f)))));
+		__m128 centered = _mm_sub_ps(t, half);
+		__m128 k = _mm_add_ps(_mm_mul_ps(A, _mm_mul_ps(centered, centered)), B);
+		__m128 corrected = _mm_add_ps(t, _mm_mul_ps(_mm_mul_ps(t, centered), _mm_mul_ps(_mm_sub_ps(t, one), k)));
+
+		//The shorter way round, b is flipped when the two are more than half a turn apart
+		__m128 left = _mm_sub_ps(one, corrected);
+		__m128 right = _mm_xor_ps(corrected, sign);
+		x = _mm_add_ps(_mm_mul_ps(ax, left), _mm_mul_ps(bx, right));
+		y = _mm_add_ps(_mm_mul_ps(ay, left), _mm_mul_ps(by, right));
+		z = _mm_add_ps(_mm_mul_ps(az, left), _mm_mul_ps(bz, right));
+		w = _mm_add_ps(_mm_mul_ps(aw, left), _mm_mul_ps(bw, right));
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w))));
+		__m128 inverse = _mm_div_ps(one, length);
+		x = _mm_mul_ps(x, inverse);
+		y = _mm_mul_ps(y, inverse);
+		z = _mm_mul_ps(z, inverse);
+		w = _mm_mul_ps(w, inverse);
+	}
+
+	glm::fquat blendRotation(const glm::fquat& from, const glm::fquat& to, float weight)
+	{
+		return weight >= 1.0f ? to : glm::slerp(from, to, weight);
+	}
+}
+
+void AnimationClip::sample(float time, glm::vec3* positions, glm::fquat* rotations, glm::vec3* scales) const
+{
+	for (auto& channel : channels)
+	{
+		unsigned int joint = channel.joint;
+		positions[joint] = sampleVector(channel.positions, time, glm::vec3(0, 0, 0));
+		rotations[joint] = sampleRotation(channel.rotations, time);
+		scales[joint] = sampleVector(channel.scales, time, glm::vec3(1, 1, 1));
+	}
+}
+
+size_t AnimationClip::getMemoryBytes() const
+{
+	size_t bytes = sizeof(AnimationClip) + name.capacity() + joints.capacity() * sizeof(unsigned int);
+	for (auto& channel : channels)
+	{
+		bytes += sizeof(JointChannel);
+		bytes += (channel.positions.capacity() + channel.scales.capacity()) * sizeof(VectorKey) + channel.rotations.capacity() * sizeof(RotationKey);
+	}
+	return bytes;
+}
+
+CompressedClip::CompressedClip(const AnimationClip& clip, float sampleRate)
+{
+	name = clip.name;
+	duration = clip.duration;
+	this->sampleRate = sampleRate;
+	joints = clip.joints;
+	frameCount = std::max(2u, (unsigned int)std::ceil(duration * sampleRate) + 1);
+
+	//Every channel sampled at every frame, frame major
+	unsigned int channelCount = clip.channels.size();
+	unsigned int jointCount = 0;
+	for (unsigned int joint : joints)
+	{
+		jointCount = std::max(jointCount, joint + 1);
+	}
+	std::vector<glm::vec3> jointPositions(jointCount);
+	std::vector<glm::fquat> jointRotations(jointCount);
+	std::vector<glm::vec3> jointScales(jointCount);
+	std::vector<glm::vec3> sampledPositions(frameCount * channelCount);
+	std::vector<glm::fquat> sampledRotations(frameCount * channelCount);
+	std::vector<glm::vec3> sampledScales(frameCount * channelCount);
+	for (unsigned int frame = 0; frame < frameCount; ++frame)
+	{
+		clip.sample(std::min(frame / sampleRate, duration), jointPositions.data(), jointRotations.data(), jointScales.data());
+		for (unsigned int channel = 0; channel < channelCount; ++channel)
+		{
+			unsigned int joint = clip.channels[channel].joint;
+			unsigned int index = frame * channelCount + channel;
+			sampledPositions[index] = jointPositions[joint];
+			sampledRotations[index] = jointRotations[joint];
+			sampledScales[index] = jointScales[joint];
+			//q and -q are the same rotation, keeping neighbours on one side makes the interpolation take the short way
+			if (frame > 0 && glm::dot(sampledRotations[index - channelCount], sampledRotations[index]) < 0)
+			{
+				glm::fquat& q = sampledRotations[index];
+				q = glm::fquat(-q.w, -q.x, -q.y, -q.z);
+			}
+		}
+	}
+
+	//Tracks within quantization noise of their first frame are constant
+	const float tolerance = 1e-5f;
+	std::vector<unsigned int> rotationChannels;
+	std::vector<unsigned int> vectorChannels;
+	for (unsigned int channel = 0; channel < channelCount; ++channel)
+	{
+		unsigned int joint = clip.channels[channel].joint;
+		bool rotationConstant = true;
+		bool positionConstant = true;
+		bool scaleConstant = true;
+		for (unsigned int frame = 1; frame < frameCount; ++frame)
+		{
+			unsigned int index = frame * channelCount + channel;
+			glm::fquat a = sampledRotations[channel];
+			glm::fquat b = sampledRotations[index];
+			rotationConstant = rotationConstant && std::abs(a.x - b.x) < tolerance && std::abs(a.y - b.y) < tolerance && std::abs(a.z - b.z) < tolerance && std::abs(a.w - b.w) < tolerance;
+			glm::vec3 positionDelta = glm::abs(sampledPositions[index] - sampledPositions[channel]);
+			glm::vec3 scaleDelta = glm::abs(sampledScales[index] - sampledScales[channel]);
+			positionConstant = positionConstant && positionDelta.x < tolerance && positionDelta.y < tolerance && positionDelta.z < tolerance;
+			scaleConstant = scaleConstant && scaleDelta.x < tolerance && scaleDelta.y < tolerance && scaleDelta.z < tolerance;
+		}
+		if (rotationConstant)
+		{
+			constantRotationJoints.push_back(joint);
+			constantRotations.push_back(sampledRotations[channel]);
+		}
+		else
+		{
+			rotationJoints.push_back(joint);
+			rotationChannels.push_back(channel);
+		}
+		VectorTrack position = { joint, PositionTrack };
+		VectorTrack scale = { joint, ScaleTrack };
+		if (positionConstant)
+		{
+			constantVectorTracks.push_back(position);
+			constantVectors.push_back(sampledPositions[channel]);
+		}
+		else
+		{
+			vectorTracks.push_back(position);
+			vectorChannels.push_back(channel);
+		}
+		if (scaleConstant)
+		{
+			constantVectorTracks.push_back(scale);
+			constantVectors.push_back(sampledScales[channel]);
+		}
+		else
+		{
+			vectorTracks.push_back(scale);
+			vectorChannels.push_back(channel);
+		}
+	}
+
+	rotationSlots = roundUpToFour(rotationJoints.size());
+	rotationFrames.resize(frameCount * rotationSlots * 4, 0);
+	for (unsigned int frame = 0; frame < frameCount; ++frame)
+	{
+		int16_t* out = rotationFrames.data() + frame * rotationSlots * 4;
+		for (unsigned int slot = 0; slot < rotationSlots; ++slot)
+		{
+			glm::fquat q(1, 0, 0, 0);
+			if (slot < rotationChannels.size())
+			{
+				q = sampledRotations[frame * channelCount + rotationChannels[slot]];
+			}
+			out[slot * 4] = quantizeUnit(q.x);
+			out[slot * 4 + 1] = quantizeUnit(q.y);
+			out[slot * 4 + 2] = quantizeUnit(q.z);
+			out[slot * 4 + 3] = quantizeUnit(q.w);
+		}
+	}
+
+	unsigned int componentCount = vectorTracks.size() * 3;
+	vectorSlots = roundUpToFour(componentCount);
+	vectorMinimum.resize(vectorSlots, 0.0f);
+	vectorStep.resize(vectorSlots, 0.0f);
+	vectorFrames.resize(frameCount * vectorSlots, 0);
+	for (unsigned int component = 0; component < componentCount; ++component)
+	{
+		unsigned int track = component / 3;
+		unsigned int axis = component % 3;
+		const std::vector<glm::vec3>& sampled = vectorTracks[track].kind == PositionTrack ? sampledPositions : sampledScales;
+		unsigned int channel = vectorChannels[track];
+		float minimum = sampled[channel][axis];
+		float maximum = minimum;
+		for (unsigned int frame = 1; frame < frameCount; ++frame)
+		{
+			float value = sampled[frame * channelCount + channel][axis];
+			minimum = std::min(minimum, value);
+			maximum = std::max(maximum, value);
+		}
+		float step = (maximum - minimum) / 65535.0f;
+		vectorMinimum[component] = minimum;
+		vectorStep[component] = step;
+		for (unsigned int frame = 0; frame < frameCount; ++frame)
+		{
+			float value = sampled[frame * channelCount + channel][axis];
+			vectorFrames[frame * vectorSlots + component] = step > 0 ? (uint16_t)std::lround((value - minimum) / step) : 0;
+		}
+	}
+}
+
+void CompressedClip::sample(float time, glm::vec3* positions, glm::fquat* rotations, glm::vec3* scales, float weight) const
+{
+	float frame = glm::clamp(time * sampleRate, 0.0f, (float)(frameCount - 1));
+	unsigned int first = std::min((unsigned int)frame, frameCount - 2);
+	float t = frame - first;
+
+	for (unsigned int i = 0; i < constantRotationJoints.size(); ++i)
+	{
+		unsigned int joint = constantRotationJoints[i];
+		rotations[joint] = blendRotation(rotations[joint], constantRotations[i], weight);
+	}
+	for (unsigned int i = 0; i < constantVectorTracks.size(); ++i)
+	{
+		const VectorTrack& track = constantVectorTracks[i];
+		glm::vec3& target = track.kind == PositionTrack ? positions[track.joint] : scales[track.joint];
+		target = glm::mix(target, constantVectors[i], std::min(weight, 1.0f));
+	}
+
+	__m128 factor = _mm_set1_ps(t);
+	__m128 blendFactor = _mm_set1_ps(weight);
+	const int16_t* rotationsA = rotationFrames.data() + first * rotationSlots * 4;
+	const int16_t* rotationsB = rotationsA + rotationSlots * 4;
+	for (unsigned int slot = 0; slot < rotationSlots; slot += 4)
+	{
+		__m128 ax, ay, az, aw, bx, by, bz, bw, x, y, z, w;
+		loadQuaternions(rotationsA + slot * 4, ax, ay, az, aw);
+		loadQuaternions(rotationsB + slot * 4, bx, by, bz, bw);
+		slerpFour(ax, ay, az, aw, bx, by, bz, bw, factor, x, y, z, w);
+		unsigned int lanes = std::min(4u, (unsigned int)rotationJoints.size() - slot);
+		if (weight < 1.0f)
+		{
+			//What is already posed is the start of the blend, gathered into the same layout
+			float current[4][4] = { { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, { 1, 1, 1, 1 } };
+			for (unsigned int lane = 0; lane < lanes; ++lane)
+			{
+				const glm::fquat& q = rotations[rotationJoints[slot + lane]];
+				current[0][lane] = q.x;
+				current[1][lane] = q.y;
+				current[2][lane] = q.z;
+				current[3][lane] = q.w;
+			}
+			slerpFour(_mm_loadu_ps(current[0]), _mm_loadu_ps(current[1]), _mm_loadu_ps(current[2]), _mm_loadu_ps(current[3]), x, y, z, w, blendFactor, x, y, z, w);
+		}
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		float result[4][4];
+		_mm_storeu_ps(result[0], x);
+		_mm_storeu_ps(result[1], y);
+		_mm_storeu_ps(result[2], z);
+		_mm_storeu_ps(result[3], w);
+		for (unsigned int lane = 0; lane < lanes; ++lane)
+		{
+			rotations[rotationJoints[slot + lane]] = glm::fquat(result[lane][3], result[lane][0], result[lane][1], result[lane][2]);
+		}
+	}
+
+	const __m128i zero = _mm_setzero_si128();
+	const uint16_t* vectorsA = vectorFrames.data() + first * vectorSlots;
+	const uint16_t* vectorsB = vectorsA + vectorSlots;
+	unsigned int componentCount = vectorTracks.size() * 3;
+	for (unsigned int component = 0; component < vectorSlots; component += 4)
+	{
+		__m128 a = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(vectorsA + component)), zero));
+		__m128 b = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(vectorsB + component)), zero));
+		__m128 quantized = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), factor));
+		__m128 value = _mm_add_ps(_mm_loadu_ps(&vectorMinimum[component]), _mm_mul_ps(quantized, _mm_loadu_ps(&vectorStep[component])));
+		float result[4];
+		_mm_storeu_ps(result, value);
+		unsigned int lanes = std::min(4u, componentCount - component);
+		for (unsigned int lane = 0; lane < lanes; ++lane)
+		{
+			const VectorTrack& track = vectorTracks[(component + lane) / 3];
+			glm::vec3& target = track.kind == PositionTrack ? positions[track.joint] : scales[track.joint];
+			float& out = target[(component + lane) % 3];
+			out = weight >= 1.0f ? result[lane] : out + (result[lane] - out) * weight;
+		}
+	}
+}
+
+size_t CompressedClip::getMemoryBytes() const
+{
+	return sizeof(CompressedClip) + name.capacity() + joints.capacity() * sizeof(unsigned int)
+		+ rotationJoints.capacity() * sizeof(unsigned int) + vectorTracks.capacity() * sizeof(VectorTrack)
+		+ (vectorMinimum.capacity() + vectorStep.capacity()) * sizeof(float)
+		+ rotationFrames.capacity() * sizeof(int16_t) + vectorFrames.capacity() * sizeof(uint16_t)
+		+ constantRotationJoints.capacity() * sizeof(unsigned int) + constantRotations.capacity() * sizeof(glm::fquat)
+		+ constantVectorTracks.capacity() * sizeof(VectorTrack) + constantVectors.capacity() * sizeof(glm::vec3);
+}
\ No newline at end of file
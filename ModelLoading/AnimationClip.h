@@ -0,0 +1,100 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+struct VectorKey
+{
+	float time;
+	glm::vec3 value;
+};
+
+struct RotationKey
+{
+	float time;
+	glm::fquat value;
+};
+
+//Keys of one joint, times in seconds
+struct JointChannel
+{
+	unsigned int joint;
+	std::vector<VectorKey> positions;
+	std::vector<RotationKey> rotations;
+	std::vector<VectorKey> scales;
+};
+
+//Keys as imported, kept only until the clip is compressed
+struct AnimationClip
+{
+	std::string name;
+	//Seconds
+	float duration = 0;
+	std::vector<JointChannel> channels;
+	//Joint of each channel, the indices composeTRS writes the sampled transforms to
+	std::vector<unsigned int> joints;
+
+	//Writes the transform of every channel's joint into the joint indexed arrays, searching the keys
+	//and interpolating with glm one joint at a time
+	void sample(float time, glm::vec3* positions, glm::fquat* rotations, glm::vec3* scales) const;
+	size_t getMemoryBytes() const;
+};
+
+//Clip resampled at a fixed rate and quantized, stored frame by frame so sampling at any time reads
+//two neighbouring blocks of memory. Rotations are four 16 bit components, positions and scales
+//16 bits per component inside the range of their track, and tracks that never change are kept
+//once as floats instead of in every frame. Sampling decodes four tracks at a time with SSE2 and
+//interpolates rotations with a fitted slerp approximation, accurate to about 1e-4
+class CompressedClip
+{
+public:
+	CompressedClip() {}
+	CompressedClip(const AnimationClip& clip, float sampleRate = 30.0f);
+
+	//Writes the transform of every animated joint into the joint indexed arrays. With a weight
+	//below 1 the result is blended into what the arrays already hold, for cross fades
+	void sample(float time, glm::vec3* positions, glm::fquat* rotations, glm::vec3* scales, float weight = 1.0f) const;
+
+	const std::string& getName() const { return name; }
+	float getDuration() const { return duration; }
+	const std::vector<unsigned int>& getJoints() const { return joints; }
+	size_t getMemoryBytes() const;
+private:
+	enum TrackKind
+	{
+		PositionTrack,
+		ScaleTrack
+	};
+	struct VectorTrack
+	{
+		unsigned int joint;
+		TrackKind kind;
+	};
+
+	std::string name;
+	float duration = 0;
+	float sampleRate = 30.0f;
+	unsigned int frameCount = 0;
+	std::vector<unsigned int> joints;
+
+	//Tracks that change, in the order they sit in every frame. Both counts are padded to a multiple
+	//of four, the padding tracks are decoded and thrown away
+	std::vector<unsigned int> rotationJoints;
+	std::vector<VectorTrack> vectorTracks;
+	unsigned int rotationSlots = 0;
+	unsigned int vectorSlots = 0;
+	//Dequantization of every vector component in the frame, value = minimum + q * step
+	std::vector<float> vectorMinimum;
+	std::vector<float> vectorStep;
+	//Rotations then vector components of frame 0, then frame 1 and so on
+	std::vector<int16_t> rotationFrames;
+	std::vector<uint16_t> vectorFrames;
+
+	//Tracks that never change
+	std::vector<unsigned int> constantRotationJoints;
+	std::vector<glm::fquat> constantRotations;
+	std::vector<VectorTrack> constantVectorTracks;
+	std::vector<glm::vec3> constantVectors;
+};
\ No newline at end of file
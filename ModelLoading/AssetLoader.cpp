@@ -0,0 +1,165 @@
+#include "AssetLoader.h"
+#include "JobSystem.h"
+#include "Model.h"
+#include "stb_image.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <unordered_map>
+
+AssetLoader& AssetLoader::get()
+{
+	static AssetLoader loader;
+	return loader;
+}
+
+void AssetLoader::WorkerAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+	JobSystem::get().run([handle]() { handle.resume(); });
+}
+
+void AssetLoader::queueMainThread(std::coroutine_handle<> handle)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	mainThreadQueue.push_back(handle);
+}
+
+void AssetLoader::pump(double budgetMs)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	if (resuming.empty())
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		resuming.swap(mainThreadQueue);
+	}
+	//Whatever is left when the budget runs out goes first next time
+	size_t resumed = 0;
+	while (resumed < resuming.size())
+	{
+		resuming[resumed++].resume();
+		++stats.mainThreadResumes;
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		if (elapsed.count() > budgetMs)
+		{
+			break;
+		}
+	}
+	resuming.erase(resuming.begin(), resuming.begin() + resumed);
+}
+
+void AssetLoader::helpWorkers()
+{
+	if (!JobSystem::get().runOne())
+	{
+		std::this_thread::yield();
+	}
+}
+
+Task<unsigned int> AssetLoader::loadTexture(std::string filename, TextureUsage usage, bool flip)
+{
+	co_await resumeOnWorker();
+	int width, height, channels;
+	stbi_set_flip_vertically_on_load_thread(flip);
+	unsigned char* data = stbi_load(filename.c_str(), &width, &height, &channels, 0);
+	//Later jobs on this worker decode unflipped, like everything else
+	stbi_set_flip_vertically_on_load_thread(false);
+
+	co_await resumeOnMainThread();
+	//The caches are only touched here, so two loads of one file decode twice but upload once
+	unsigned int id;
+	bool cached = usage == TextureUsage::Mesh ? Model::findCachedTexture(filename, id) : Sprite::findCachedTexture(filename, id);
+	if (cached)
+	{
+		++stats.texturesCached;
+	}
+	else
+	{
+		id = usage == TextureUsage::Mesh ? Model::uploadTexture(filename, data, width, height) : Sprite::uploadTexture(filename, data, width, height);
+		++stats.texturesDecoded;
+	}
+	stbi_image_free(data);
+	co_return id;
+}
+
+Task<AssetLoader::DecodedImage> AssetLoader::decodeImage(std::string filename)
+{
+	co_await resumeOnWorker();
+	DecodedImage image;
+	int channels;
+	image.data = stbi_load(filename.c_str(), &image.width, &image.height, &channels, 0);
+	co_return image;
+}
+
+Task<unsigned int> AssetLoader::loadCubeMap(std::vector<std::string> faces)
+{
+	std::vector<Task<DecodedImage>> decodes;
+	decodes.reserve(faces.size());
+	for (auto& face : faces)
+	{
+		decodes.push_back(decodeImage(face));
+	}
+	std::vector<DecodedImage> images;
+	for (auto& decode : decodes)
+	{
+		images.push_back(co_await decode);
+	}
+
+	co_await resumeOnMainThread();
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+	for (unsigned int i = 0; i < images.size(); ++i)
+	{
+		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, images[i].width, images[i].height, 0, GL_RGBA, GL_UNSIGNED_BYTE, images[i].data);
+		stbi_image_free(images[i].data);
+		++stats.texturesDecoded;
+	}
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	co_return texture;
+}
+
+Task<std::unique_ptr<Model>> AssetLoader::loadModel(std::string filename)
+{
+	co_await resumeOnWorker();
+	ModelData data = Model::parse(filename);
+
+	//Every distinct texture decodes in its own job while this waits
+	std::vector<std::string> paths;
+	for (auto& mesh : data.meshes)
+	{
+		for (auto& texture : mesh.textures)
+		{
+			if (std::find(paths.begin(), paths.end(), texture.path) == paths.end())
+			{
+				paths.push_back(texture.path);
+			}
+		}
+	}
+	std::vector<Task<unsigned int>> textures;
+	textures.reserve(paths.size());
+	for (auto& path : paths)
+	{
+		textures.push_back(loadTexture(path));
+	}
+	std::unordered_map<std::string, unsigned int> ids;
+	for (unsigned int i = 0; i < textures.size(); ++i)
+	{
+		ids[paths[i]] = co_await textures[i];
+	}
+
+	co_await resumeOnMainThread();
+	for (auto& mesh : data.meshes)
+	{
+		for (auto& texture : mesh.textures)
+		{
+			texture.id = ids[texture.path];
+		}
+	}
+	++stats.modelsLoaded;
+	co_return std::make_unique<Model>(std::move(data));
+}
\ No newline at end of file
@@ -0,0 +1,103 @@
+#pragma once
+#include "Task.h"
+#include <coroutine>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class Model;
+
+enum class TextureUsage
+{
+	//Uploaded and cached like Model::loadTexture
+	Mesh,
+	//Uploaded and cached like the Sprite constructor, clamped with alpha
+	Sprite
+};
+
+struct AssetLoaderStats
+{
+	unsigned int texturesDecoded = 0;
+	//Textures found in a cache once decoded, loaded by someone else in the meantime
+	unsigned int texturesCached = 0;
+	unsigned int modelsLoaded = 0;
+	//Coroutines resumed on the GL thread by pump
+	unsigned int mainThreadResumes = 0;
+};
+
+//Loads assets with coroutines. File reads, parsing and image decoding run as jobs on the JobSystem,
+//everything that touches GL resumes on the GL thread the next time pump is called. The loads start
+//right away, so tasks created one after another overlap and are awaited in any order:
+//	Task<unsigned int> albedo = loader.loadTexture("a.png");
+//	Task<std::unique_ptr<Model>> model = loader.loadModel("b.obj");
+//	unsigned int id = co_await albedo;
+class AssetLoader
+{
+public:
+	static AssetLoader& get();
+	AssetLoader(const AssetLoader&) = delete;
+	AssetLoader& operator=(const AssetLoader&) = delete;
+
+	struct WorkerAwaiter
+	{
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> handle);
+		void await_resume() const noexcept {}
+	};
+	struct MainThreadAwaiter
+	{
+		AssetLoader& loader;
+
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> handle) { loader.queueMainThread(handle); }
+		void await_resume() const noexcept {}
+	};
+	//co_await either to carry on as a job on a worker or on the GL thread
+	WorkerAwaiter resumeOnWorker() { return WorkerAwaiter(); }
+	MainThreadAwaiter resumeOnMainThread() { return MainThreadAwaiter{ *this }; }
+
+	//Called by the GL thread every frame. Resumes the coroutines waiting for it until the budget
+	//runs out, so a big scene uploads over several frames instead of stalling one
+	void pump(double budgetMs = 4.0);
+	//Blocks the GL thread until the task finishes, pumping and running jobs meanwhile
+	template<typename T>
+	T wait(Task<T>& task)
+	{
+		while (!task.isReady())
+		{
+			pump(1000.0);
+			helpWorkers();
+		}
+		return task.get();
+	}
+
+	//Decodes on a worker with the flip applied to that thread only, uploads on the GL thread
+	Task<unsigned int> loadTexture(std::string filename, TextureUsage usage = TextureUsage::Mesh, bool flip = false);
+	//Parses on a worker, decodes every texture of the model in parallel and creates it on the GL thread
+	Task<std::unique_ptr<Model>> loadModel(std::string filename);
+	//Decodes the faces in parallel, ordered +x -x +y -y +z -z, and uploads them as one cube map
+	Task<unsigned int> loadCubeMap(std::vector<std::string> faces);
+
+	const AssetLoaderStats& getStats() const { return stats; }
+private:
+	struct DecodedImage
+	{
+		//Freed by whoever uploads it
+		unsigned char* data = nullptr;
+		int width = 0;
+		int height = 0;
+	};
+
+	AssetLoader() {}
+	Task<DecodedImage> decodeImage(std::string filename);
+	void queueMainThread(std::coroutine_handle<> handle);
+	//Runs one queued job on the calling thread, or yields when there is none
+	void helpWorkers();
+
+	std::mutex mutex;
+	std::vector<std::coroutine_handle<>> mainThreadQueue;
+	//Swapped with the queue by pump, so coroutines queued while pumping wait for the next call
+	std::vector<std::coroutine_handle<>> resuming;
+	AssetLoaderStats stats;
+};
\ No newline at end of file
@@ -0,0 +1,845 @@
+#include "Benchmark.h"
+#include "Window.h"
+#include "Model.h"
+#include "InstanceSet.h"
+#include "SpriteBatch.h"
+#include "CommandList.h"
+#include "SimdMath.h"
+#include "DynamicBvh.h"
+#include "FrustumCuller.h"
+#include "OcclusionCuller.h"
+#include "JobSystem.h"
+#include "Skeleton.h"
+#include "FftOcean.h"
+#include "GerstnerWaves.h"
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cmath>
+#include <random>
+
+namespace
+{
+	const int framesPerSample = 20;
+	//Past this the one draw per copy path takes seconds per frame and only slows the run down
+	const unsigned int maxNaiveCount = 10000;
+
+	glm::vec3 gridPosition(unsigned int index, unsigned int count)
+	{
+		unsigned int perAxis = (unsigned int)std::ceil(std::cbrt((float)count));
+		float spacing = 1.5f;
+		float offset = perAxis * spacing * 0.5f;
+		return glm::vec3((index % perAxis) * spacing - offset, ((index / perAxis) % perAxis) * spacing - offset, -(float)(index / (perAxis * perAxis)) * spacing - 2.0f);
+	}
+
+	template<typename F>
+	double timeFrames(Window& window, F drawFrame)
+	{
+		glFinish();
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < framesPerSample; ++i)
+		{
+			window.clear();
+			drawFrame();
+			window.swapBuffers();
+		}
+		glFinish();
+		auto end = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::milli>(end - start).count() / framesPerSample;
+	}
+
+	template<typename F>
+	double timeRuns(F run)
+	{
+		const int runs = 10;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < runs; ++i)
+		{
+			run();
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::milli>(end - start).count() / runs;
+	}
+
+	template<typename F>
+	double timeOnce(F run)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		run();
+		auto end = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+	//Jobs run by every JobSystem worker since the last resetStats, worker 0 is the main thread
+	void printWorkerStats()
+	{
+		std::vector<WorkerStats> stats = JobSystem::get().getStats();
+		std::cout << std::setw(10) << "worker" << std::setw(10) << "jobs" << std::setw(10) << "stolen" << std::setw(12) << "busy ms" << std::setw(12) << "busy %" << std::endl;
+		for (unsigned int i = 0; i < stats.size(); ++i)
+		{
+			std::cout << std::setw(10) << i << std::setw(10) << stats[i].jobs << std::setw(10) << stats[i].stolen << std::fixed << std::setprecision(1);
+			std::cout << std::setw(12) << stats[i].busyMs << std::setw(12) << stats[i].utilization * 100 << std::endl;
+		}
+	}
+
+	//Whether the segment from one point to the other passes through the box before reaching its end
+	bool segmentHitsBox(const glm::vec3& from, const glm::vec3& to, const AABB& box)
+	{
+		float enter = 0;
+		float exit = 1;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float delta = to[axis] - from[axis];
+			if (delta == 0)
+			{
+				if (from[axis] < box.min[axis] || from[axis] > box.max[axis])
+				{
+					return false;
+				}
+				continue;
+			}
+			float toMin = (box.min[axis] - from[axis]) / delta;
+			float toMax = (box.max[axis] - from[axis]) / delta;
+			enter = std::max(enter, std::min(toMin, toMax));
+			exit = std::min(exit, std::max(toMin, toMax));
+		}
+		return enter <= exit && enter < 1;
+	}
+
+	void printRow(const char* name, unsigned int count, double naive, double instanced)
+	{
+		std::cout << std::setw(8) << name << std::setw(10) << count;
+		if (naive < 0)
+		{
+			std::cout << std::setw(16) << "-";
+		}
+		else
+		{
+			std::cout << std::setw(16) << std::fixed << std::setprecision(3) << naive;
+		}
+		std::cout << std::setw(16) << std::fixed << std::setprecision(3) << instanced << std::endl;
+	}
+}
+
+void runInstancingBenchmark(Window& window, Model& model, Sprite& sprite, Shader& modelShader, Shader& instancedModelShader, Shader& spriteShader, Shader& instancedSpriteShader)
+{
+	const unsigned int counts[] = { 1, 10, 100, 1000, 10000, 100000 };
+	const glm::vec3 scale(0.2f, 0.2f, 0.2f);
+
+	window.setView(glm::vec3(0, 0, 40), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+	window.setProjection(glm::perspective(45.0f, (float)1980 / 1080, 0.1f, 500.0f));
+
+	std::cout << std::setw(8) << "object" << std::setw(10) << "count" << std::setw(16) << "per draw ms" << std::setw(16) << "instanced ms" << std::endl;
+	for (unsigned int count : counts)
+	{
+		InstanceSet instances(count);
+		InstanceData instance;
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			instance.model = glm::scale(glm::translate(glm::mat4(1.0f), gridPosition(i, count)), scale);
+			instances.add(instance);
+		}
+
+		double naive = -1;
+		if (count <= maxNaiveCount)
+		{
+			naive = timeFrames(window, [&]()
+			{
+				model.setScale(scale);
+				for (unsigned int i = 0; i < count; ++i)
+				{
+					model.setPosition(gridPosition(i, count));
+					model.draw(window, modelShader);
+				}
+			});
+		}
+		double instanced = timeFrames(window, [&]()
+		{
+			model.drawInstanced(window, instancedModelShader, instances);
+		});
+		printRow("model", count, naive, instanced);
+
+		naive = -1;
+		if (count <= maxNaiveCount)
+		{
+			naive = timeFrames(window, [&]()
+			{
+				sprite.setScale(scale);
+				for (unsigned int i = 0; i < count; ++i)
+				{
+					sprite.setPosition(gridPosition(i, count));
+					sprite.draw(window, spriteShader);
+				}
+			});
+		}
+		instanced = timeFrames(window, [&]()
+		{
+			sprite.drawInstanced(window, instancedSpriteShader, instances);
+		});
+		printRow("sprite", count, naive, instanced);
+	}
+}
+
+void runSpriteBatchBenchmark(Window& window, Sprite& first, Sprite& second, Shader& spriteShader, Shader& batchShader)
+{
+	const unsigned int counts[] = { 1000, 10000, 50000, 100000 };
+	const glm::vec3 scale(0.2f, 0.2f, 0.2f);
+
+	window.setView(glm::vec3(0, 0, 40), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+	window.setProjection(glm::perspective(45.0f, (float)1980 / 1080, 0.1f, 500.0f));
+
+	SpriteBatch batch;
+	std::cout << "persistent mapping: " << (batch.isPersistent() ? "yes" : "no") << std::endl;
+	std::cout << std::setw(10) << "count" << std::setw(16) << "per draw ms" << std::setw(16) << "batched ms" << std::setw(12) << "draws" << std::setw(14) << "fence waits" << std::endl;
+	for (unsigned int count : counts)
+	{
+		double naive = -1;
+		if (count <= maxNaiveCount)
+		{
+			naive = timeFrames(window, [&]()
+			{
+				for (unsigned int i = 0; i < count; ++i)
+				{
+					Sprite& sprite = i % 2 ? second : first;
+					sprite.setScale(scale);
+					sprite.setPosition(gridPosition(i, count));
+					sprite.draw(window, spriteShader);
+				}
+			});
+		}
+		unsigned int fenceWaits = 0;
+		double batched = timeFrames(window, [&]()
+		{
+			batch.begin();
+			for (unsigned int i = 0; i < count; ++i)
+			{
+				glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), gridPosition(i, count)), scale);
+				batch.draw((i % 2 ? second : first).getTexture(), model);
+			}
+			batch.end(window, batchShader);
+			fenceWaits += batch.getStats().fenceWaits;
+		});
+
+		std::cout << std::setw(10) << count;
+		if (naive < 0)
+		{
+			std::cout << std::setw(16) << "-";
+		}
+		else
+		{
+			std::cout << std::setw(16) << std::fixed << std::setprecision(3) << naive;
+		}
+		std::cout << std::setw(16) << std::fixed << std::setprecision(3) << batched << std::setw(12) << batch.getStats().drawCalls << std::setw(14) << fenceWaits << std::endl;
+	}
+}
+
+void runCommandListBenchmark(Window& window, Model& model, Shader& shader)
+{
+	const unsigned int counts[] = { 1000, 10000, 50000 };
+	//Fixed so every thread count replays the same lists
+	const unsigned int parts = 64;
+	const glm::vec3 scale(0.2f, 0.2f, 0.2f);
+
+	window.setView(glm::vec3(0, 0, 40), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+	window.setProjection(glm::perspective(45.0f, (float)1980 / 1080, 0.1f, 500.0f));
+
+	std::vector<unsigned int> threadCounts = { 1 };
+	ParallelRecorder widest;
+	if (widest.getThreadCount() > 1)
+	{
+		threadCounts.push_back(widest.getThreadCount());
+	}
+
+	JobSystem::get().resetStats();
+	std::cout << std::setw(10) << "count" << std::setw(10) << "threads" << std::setw(14) << "record ms" << std::setw(14) << "replay ms" << std::setw(14) << "frame ms" << std::endl;
+	for (unsigned int count : counts)
+	{
+		for (unsigned int threads : threadCounts)
+		{
+			ParallelRecorder recorder(threads);
+			double recordMs = 0;
+			double executeMs = 0;
+			double frame = timeFrames(window, [&]()
+			{
+				recorder.record(parts, [&](CommandList& list, unsigned int part)
+				{
+					list.bindPipeline(shader);
+					unsigned int first = count * part / parts;
+					unsigned int last = count * (part + 1) / parts;
+					for (unsigned int i = first; i < last; ++i)
+					{
+						model.record(list, glm::scale(glm::translate(glm::mat4(1.0f), gridPosition(i, count)), scale));
+					}
+				});
+				recorder.execute(window);
+				recordMs += recorder.getStats().recordMs;
+				executeMs += recorder.getStats().executeMs;
+			});
+			std::cout << std::setw(10) << count << std::setw(10) << threads << std::fixed << std::setprecision(3) << std::setw(14) << recordMs / framesPerSample << std::setw(14) << executeMs / framesPerSample << std::setw(14) << frame << std::endl;
+		}
+	}
+	printWorkerStats();
+}
+
+void runMathBenchmark()
+{
+	const unsigned int counts[] = { 1000, 10000, 100000, 1000000 };
+
+	std::cout << std::setw(10) << "count" << std::setw(12) << "kernel" << std::setw(12) << "glm ms" << std::setw(12) << "simd ms" << std::setw(10) << "speedup" << std::endl;
+	for (unsigned int count : counts)
+	{
+		std::vector<glm::vec3> positions(count);
+		std::vector<glm::fquat> rotations(count);
+		std::vector<glm::vec3> scales(count);
+		std::vector<AABB> boxes(count);
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			positions[i] = gridPosition(i, count);
+			rotations[i] = glm::angleAxis(i * 0.01f, glm::normalize(glm::vec3(1, 2, 3)));
+			scales[i] = glm::vec3(0.2f, 0.3f, 0.4f);
+			boxes[i].min = glm::vec3(-1, -1, -1);
+			boxes[i].max = glm::vec3(1, 2, 1);
+		}
+		std::vector<glm::mat4> models(count);
+		std::vector<glm::mat4> results(count);
+		std::vector<AABB> transformed(count);
+		glm::mat4 viewProjection = glm::perspective(45.0f, (float)1980 / 1080, 0.1f, 500.0f) * glm::lookAt(glm::vec3(0, 0, 40), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+
+		auto printKernel = [count](const char* name, double scalar, double vectorized)
+		{
+			std::cout << std::setw(10) << count << std::setw(12) << name << std::fixed << std::setprecision(3) << std::setw(12) << scalar << std::setw(12) << vectorized << std::setw(9) << std::setprecision(2) << scalar / vectorized << "x" << std::endl;
+		};
+
+		double scalar = timeRuns([&]()
+		{
+			for (unsigned int i = 0; i < count; ++i)
+			{
+				models[i] = glm::translate(glm::mat4(1.0f), positions[i]) * glm::toMat4(rotations[i]) * glm::scale(glm::mat4(1.0f), scales[i]);
+			}
+		});
+		double vectorized = timeRuns([&]()
+		{
+			simd::composeTRS(positions.data(), rotations.data(), scales.data(), models.data(), count);
+		});
+		printKernel("trs", scalar, vectorized);
+
+		scalar = timeRuns([&]()
+		{
+			for (unsigned int i = 0; i < count; ++i)
+			{
+				results[i] = viewProjection * models[i];
+			}
+		});
+		vectorized = timeRuns([&]()
+		{
+			simd::multiply(viewProjection, models.data(), results.data(), count);
+		});
+		printKernel("mat4 mul", scalar, vectorized);
+
+		scalar = timeRuns([&]()
+		{
+			for (unsigned int i = 0; i < count; ++i)
+			{
+				results[i] = glm::mat4(glm::transpose(glm::inverse(glm::mat3(models[i]))));
+			}
+		});
+		vectorized = timeRuns([&]()
+		{
+			simd::normalMatrices(models.data(), results.data(), count);
+		});
+		printKernel("normal", scalar, vectorized);
+
+		//The scalar version transforms all eight corners, which is what a per object bounds update does without the kernel
+		scalar = timeRuns([&]()
+		{
+			for (unsigned int i = 0; i < count; ++i)
+			{
+				glm::vec3 lower(1e30f, 1e30f, 1e30f);
+				glm::vec3 upper(-1e30f, -1e30f, -1e30f);
+				for (int corner = 0; corner < 8; ++corner)
+				{
+					glm::vec3 point(corner & 1 ? boxes[i].max.x : boxes[i].min.x, corner & 2 ? boxes[i].max.y : boxes[i].min.y, corner & 4 ? boxes[i].max.z : boxes[i].min.z);
+					glm::vec3 world = glm::vec3(models[i] * glm::vec4(point, 1.0f));
+					lower = glm::min(lower, world);
+					upper = glm::max(upper, world);
+				}
+				transformed[i].min = lower;
+				transformed[i].max = upper;
+			}
+		});
+		vectorized = timeRuns([&]()
+		{
+			simd::transformAABBs(models.data(), boxes.data(), transformed.data(), count);
+		});
+		printKernel("aabb", scalar, vectorized);
+	}
+}
+
+void runBvhBenchmark()
+{
+	const unsigned int counts[] = { 10000, 100000, 1000000 };
+	const unsigned int queries = 100;
+
+	std::cout << std::setw(10) << "count" << std::setw(14) << "operation" << std::setw(12) << "bvh ms" << std::setw(12) << "linear ms" << std::setw(12) << "results" << std::endl;
+	for (unsigned int count : counts)
+	{
+		//Same density at every count, about one object per 4x4x4 cell
+		float side = std::cbrt((float)count) * 4.0f;
+		std::mt19937 random(count);
+		std::uniform_real_distribution<float> coordinate(-side / 2, side / 2);
+		std::uniform_real_distribution<float> size(0.25f, 1.5f);
+		std::uniform_real_distribution<float> jitter(-0.5f, 0.5f);
+		std::vector<AABB> boxes(count);
+		for (auto& box : boxes)
+		{
+			glm::vec3 center(coordinate(random), coordinate(random), coordinate(random));
+			glm::vec3 extent(size(random), size(random), size(random));
+			box.min = center - extent;
+			box.max = center + extent;
+		}
+		auto printOperation = [count](const char* name, double tree, double linear, size_t results)
+		{
+			std::cout << std::setw(10) << count << std::setw(14) << name << std::fixed << std::setprecision(3) << std::setw(12) << tree;
+			if (linear < 0)
+			{
+				std::cout << std::setw(12) << "-";
+			}
+			else
+			{
+				std::cout << std::setw(12) << linear;
+			}
+			std::cout << std::setw(12) << results << std::endl;
+		};
+
+		DynamicBvh bvh;
+		std::vector<unsigned int> proxies(count);
+		double time = timeOnce([&]()
+		{
+			for (unsigned int i = 0; i < count; ++i)
+			{
+				proxies[i] = bvh.insert(boxes[i], i);
+			}
+		});
+		float insertedCost = bvh.computeCost();
+		printOperation("insert", time, -1, bvh.getStats().leaves);
+		time = timeOnce([&]() { bvh.rebuild(); });
+		printOperation("sah rebuild", time, -1, bvh.getStats().nodes);
+		std::cout << std::setw(10) << count << std::setw(14) << "sah cost" << std::setprecision(2) << std::setw(12) << insertedCost << " -> " << bvh.getStats().cost << std::endl;
+
+		time = timeOnce([&]()
+		{
+			for (unsigned int i = 0; i < count; i += 10)
+			{
+				glm::vec3 offset(jitter(random), jitter(random), jitter(random));
+				boxes[i].min += offset;
+				boxes[i].max += offset;
+				bvh.update(proxies[i], boxes[i]);
+			}
+		});
+		printOperation("refit 10%", time, -1, bvh.getStats().refits);
+
+		FrustumCuller culler;
+		culler.setViewProjection(glm::perspective(45.0f, (float)1980 / 1080, 0.1f, side / 2) * glm::lookAt(glm::vec3(0, 0, 0), glm::vec3(0, 0, -1), glm::vec3(0, 1, 0)));
+		std::vector<unsigned int> found;
+		time = timeOnce([&]() { bvh.query(culler, found); });
+		size_t treeResults = found.size();
+		std::vector<unsigned char> visible(count);
+		double linear = timeOnce([&]() { culler.cullBoxes(boxes.data(), count, visible.data()); });
+		printOperation("frustum", time, linear, treeResults);
+
+		std::vector<AABB> ranges(queries);
+		for (auto& range : ranges)
+		{
+			glm::vec3 center(coordinate(random), coordinate(random), coordinate(random));
+			range.min = center - glm::vec3(8, 8, 8);
+			range.max = center + glm::vec3(8, 8, 8);
+		}
+		found.clear();
+		time = timeOnce([&]()
+		{
+			for (auto& range : ranges)
+			{
+				bvh.query(range, found);
+			}
+		});
+		treeResults = found.size();
+		found.clear();
+		linear = timeOnce([&]()
+		{
+			for (auto& range : ranges)
+			{
+				for (unsigned int i = 0; i < count; ++i)
+				{
+					if (boxes[i].min.x <= range.max.x && boxes[i].max.x >= range.min.x && boxes[i].min.y <= range.max.y && boxes[i].max.y >= range.min.y && boxes[i].min.z <= range.max.z && boxes[i].max.z >= range.min.z)
+					{
+						found.push_back(i);
+					}
+				}
+			}
+		});
+		printOperation("range x100", time, linear, treeResults);
+
+		std::vector<glm::vec3> origins(queries);
+		std::vector<glm::vec3> directions(queries);
+		for (unsigned int i = 0; i < queries; ++i)
+		{
+			origins[i] = glm::vec3(coordinate(random), coordinate(random), coordinate(random));
+			directions[i] = glm::vec3(jitter(random), jitter(random), jitter(random));
+		}
+		unsigned int hits = 0;
+		time = timeOnce([&]()
+		{
+			BvhRayHit hit;
+			for (unsigned int i = 0; i < queries; ++i)
+			{
+				hits += bvh.raycast(origins[i], directions[i], side, hit);
+			}
+		});
+		linear = timeOnce([&]()
+		{
+			for (unsigned int i = 0; i < queries; ++i)
+			{
+				glm::vec3 inverseDirection = 1.0f / directions[i];
+				float closest = side;
+				for (auto& box : boxes)
+				{
+					glm::vec3 t0 = (box.min - origins[i]) * inverseDirection;
+					glm::vec3 t1 = (box.max - origins[i]) * inverseDirection;
+					glm::vec3 tNear = glm::min(t0, t1);
+					glm::vec3 tFar = glm::max(t0, t1);
+					float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+					float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, closest));
+					if (enter <= exit)
+					{
+						closest = enter;
+					}
+				}
+			}
+		});
+		printOperation("ray x100", time, linear, hits);
+	}
+}
+
+void runOcclusionBenchmark()
+{
+	//A row of buildings in front of the camera hiding a field of small boxes behind it
+	const unsigned int buildings = 64;
+	const unsigned int candidates = 100000;
+	const glm::vec3 cubePositions[8] = {
+		glm::vec3(-1, -1, -1), glm::vec3(1, -1, -1), glm::vec3(1, 1, -1), glm::vec3(-1, 1, -1),
+		glm::vec3(-1, -1, 1), glm::vec3(1, -1, 1), glm::vec3(1, 1, 1), glm::vec3(-1, 1, 1)
+	};
+	//Counter clockwise seen from outside
+	const unsigned int cubeIndices[36] = {
+		0, 2, 1, 0, 3, 2, 4, 5, 6, 4, 6, 7, 0, 1, 5, 0, 5, 4,
+		3, 6, 2, 3, 7, 6, 0, 4, 7, 0, 7, 3, 1, 2, 6, 1, 6, 5
+	};
+	std::vector<glm::mat4> occluders(buildings);
+	for (unsigned int i = 0; i < buildings; ++i)
+	{
+		float x = ((float)(i % 16) - 7.5f) * 2.5f;
+		float z = -10.0f - (float)(i / 16) * 3.0f;
+		occluders[i] = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(x, 2, z)), glm::vec3(1.3f, 4, 1.3f));
+	}
+	std::mt19937 random(candidates);
+	std::uniform_real_distribution<float> spread(-40, 40);
+	std::uniform_real_distribution<float> distance(-80, -5);
+	std::vector<AABB> boxes(candidates);
+	for (auto& box : boxes)
+	{
+		glm::vec3 center(spread(random), spread(random) * 0.1f + 1, distance(random));
+		box.min = center - glm::vec3(0.3f, 0.3f, 0.3f);
+		box.max = center + glm::vec3(0.3f, 0.3f, 0.3f);
+	}
+	glm::mat4 viewProjection = glm::perspective(45.0f, (float)1980 / 1080, 0.1f, 100.0f) * glm::lookAt(glm::vec3(0, 1, 0), glm::vec3(0, 1, -1), glm::vec3(0, 1, 0));
+
+	const unsigned int sizes[2][2] = { { 320, 180 }, { 640, 360 } };
+	const unsigned int threadCounts[] = { 1, 2, 4, JobSystem::get().getWorkerCount() };
+	JobSystem::get().resetStats();
+	std::cout << std::setw(10) << "size" << std::setw(9) << "threads" << std::setw(12) << "setup ms" << std::setw(12) << "raster ms" << std::setw(12) << "test ms" << std::setw(12) << "occluded" << std::endl;
+	for (auto& size : sizes)
+	{
+		for (unsigned int threads : threadCounts)
+		{
+			OcclusionCuller culler(size[0], size[1], threads);
+			double setup = timeRuns([&]()
+			{
+				culler.begin(viewProjection);
+				for (auto& transform : occluders)
+				{
+					culler.addOccluder(cubePositions, cubeIndices, 36, transform);
+				}
+			});
+			double raster = timeRuns([&]() { culler.rasterize(); });
+			unsigned int occluded = 0;
+			double test = timeRuns([&]()
+			{
+				occluded = 0;
+				for (auto& box : boxes)
+				{
+					occluded += !culler.isVisible(box);
+				}
+			});
+			std::cout << std::setw(6) << size[0] << "x" << std::setw(3) << size[1] << std::setw(9) << threads << std::fixed << std::setprecision(3);
+			std::cout << std::setw(12) << setup << std::setw(12) << raster << std::setw(12) << test << std::setw(12) << occluded << std::endl;
+		}
+	}
+
+	//The culler has to err towards visible: every corner of a box it hides must be out of sight of
+	//the eye behind one of the buildings, checked by casting a segment to it against their boxes
+	std::vector<AABB> buildingBounds(buildings);
+	for (unsigned int i = 0; i < buildings; ++i)
+	{
+		buildingBounds[i].min = glm::vec3(occluders[i] * glm::vec4(-1, -1, -1, 1));
+		buildingBounds[i].max = glm::vec3(occluders[i] * glm::vec4(1, 1, 1, 1));
+	}
+	const glm::vec3 eye(0, 1, 0);
+	std::cout << std::setw(10) << "size" << std::setw(12) << "occluded" << std::setw(16) << "wrongly hidden" << std::endl;
+	for (auto& size : sizes)
+	{
+		OcclusionCuller culler(size[0], size[1]);
+		culler.begin(viewProjection);
+		for (auto& transform : occluders)
+		{
+			culler.addOccluder(cubePositions, cubeIndices, 36, transform);
+		}
+		culler.rasterize();
+		unsigned int occluded = 0;
+		unsigned int wronglyHidden = 0;
+		for (auto& box : boxes)
+		{
+			if (culler.isVisible(box))
+			{
+				continue;
+			}
+			++occluded;
+			for (int corner = 0; corner < 8; ++corner)
+			{
+				glm::vec3 point(corner & 1 ? box.max.x : box.min.x, corner & 2 ? box.max.y : box.min.y, corner & 4 ? box.max.z : box.min.z);
+				bool blocked = false;
+				for (auto& building : buildingBounds)
+				{
+					if (segmentHitsBox(eye, point, building))
+					{
+						blocked = true;
+						break;
+					}
+				}
+				if (!blocked)
+				{
+					++wronglyHidden;
+					break;
+				}
+			}
+		}
+		std::cout << std::setw(6) << size[0] << "x" << std::setw(3) << size[1] << std::setw(12) << occluded << std::setw(16) << wronglyHidden << std::endl;
+	}
+	printWorkerStats();
+}
+
+void runAnimationBenchmark()
+{
+	//A humanoid sized tree, every joint rotates, only the root moves and nothing scales, keyed at
+	//30 per second like a baked export
+	const unsigned int jointCount = 64;
+	const float duration = 4.0f;
+	const unsigned int keyCount = 121;
+	Skeleton skeleton;
+	AnimationClip raw;
+	raw.name = "bench";
+	raw.duration = duration;
+	for (unsigned int i = 0; i < jointCount; ++i)
+	{
+		std::string name = "joint" + std::to_string(i);
+		skeleton.addJoint(name, i == 0 ? -1 : (int)(i - 1) / 2, glm::vec3(0, 0.1f, 0), glm::fquat(1, 0, 0, 0), glm::vec3(1));
+		skeleton.addBone(name, glm::mat4(1.0f));
+		JointChannel channel;
+		channel.joint = i;
+		glm::vec3 axis = glm::normalize(glm::vec3(1.0f, (float)(i % 3), (float)(i % 5) - 2.0f));
+		for (unsigned int k = 0; k < keyCount; ++k)
+		{
+			float time = duration * k / (keyCount - 1);
+			glm::vec3 position = i == 0 ? glm::vec3(std::sin(time), 0, std::cos(time)) : glm::vec3(0, 0.1f, 0);
+			channel.positions.push_back({ time, position });
+			channel.rotations.push_back({ time, glm::angleAxis(0.8f * std::sin(time * 3.0f + i), axis) });
+			channel.scales.push_back({ time, glm::vec3(1) });
+		}
+		raw.channels.push_back(channel);
+		raw.joints.push_back(i);
+	}
+	std::vector<CompressedClip> clips = { CompressedClip(raw) };
+	Animator probe(skeleton, clips);
+	std::cout << "clip: " << jointCount << " joints, " << duration << " s, raw " << raw.getMemoryBytes() << " bytes, compressed " << clips[0].getMemoryBytes() << " bytes" << std::endl;
+	std::cout << "per character: " << probe.getMemoryBytes() << " bytes of pose and palette" << std::endl;
+
+	//Worst palette difference the compression causes, sampled between the keys
+	std::vector<glm::vec3> positions(jointCount), scales(jointCount);
+	std::vector<glm::fquat> rotations(jointCount);
+	std::vector<glm::mat4> locals(jointCount), globals(jointCount), palette(jointCount);
+	float maxError = 0;
+	for (unsigned int step = 0; step < 400; ++step)
+	{
+		float time = duration * (step + 0.37f) / 400;
+		probe.play(0);
+		probe.setTime(time);
+		probe.update(0);
+		raw.sample(time, positions.data(), rotations.data(), scales.data());
+		simd::composeTRS(positions.data(), rotations.data(), scales.data(), locals.data(), jointCount);
+		skeleton.computePalette(locals.data(), globals.data(), palette.data());
+		for (unsigned int i = 0; i < jointCount; ++i)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				for (int r = 0; r < 4; ++r)
+				{
+					maxError = std::max(maxError, std::abs(palette[i][c][r] - probe.getPalette()[i][c][r]));
+				}
+			}
+		}
+	}
+	std::cout << "max palette error against the raw keys: " << maxError << std::endl;
+
+	//Glm sampling of the raw keys is what the animator did before the clips were compressed
+	const unsigned int counts[] = { 1, 100, 1000, 10000 };
+	const float deltaTime = 1.0f / 60.0f;
+	JobSystem::get().resetStats();
+	std::cout << std::setw(10) << "count" << std::setw(12) << "raw ms" << std::setw(14) << "compressed ms" << std::setw(12) << "jobs ms" << std::setw(14) << "us/character" << std::endl;
+	for (unsigned int count : counts)
+	{
+		std::vector<Animator> animators(count, Animator(skeleton, clips));
+		std::vector<float> times(count);
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			animators[i].play(0);
+			animators[i].setTime(duration * i / count);
+			times[i] = duration * i / count;
+		}
+		std::vector<glm::mat4> rawPalettes((size_t)count * jointCount);
+		double rawMs = timeRuns([&]()
+		{
+			for (unsigned int i = 0; i < count; ++i)
+			{
+				times[i] = std::fmod(times[i] + deltaTime, duration);
+				raw.sample(times[i], positions.data(), rotations.data(), scales.data());
+				simd::composeTRS(positions.data(), rotations.data(), scales.data(), locals.data(), jointCount);
+				skeleton.computePalette(locals.data(), globals.data(), &rawPalettes[(size_t)i * jointCount]);
+			}
+		});
+		double compressedMs = timeRuns([&]()
+		{
+			for (auto& animator : animators)
+			{
+				animator.update(deltaTime);
+			}
+		});
+		double jobsMs = timeRuns([&]() { Animator::updateAll(animators.data(), count, deltaTime); });
+		std::cout << std::setw(10) << count << std::fixed << std::setprecision(3) << std::setw(12) << rawMs << std::setw(14) << compressedMs;
+		std::cout << std::setw(12) << jobsMs << std::setw(14) << jobsMs * 1000.0 / count << std::endl;
+	}
+	printWorkerStats();
+}
+
+void runOceanBenchmark()
+{
+	const unsigned int resolutions[] = { 128, 256, 512 };
+	const unsigned int threadCounts[] = { 1, 2, 4, JobSystem::get().getWorkerCount() };
+	JobSystem::get().resetStats();
+	std::cout << std::setw(10) << "size" << std::setw(9) << "threads" << std::setw(14) << "spectrum ms" << std::setw(10) << "fft ms" << std::setw(10) << "pack ms" << std::setw(12) << "frame ms" << std::endl;
+	for (unsigned int resolution : resolutions)
+	{
+		for (unsigned int threads : threadCounts)
+		{
+			OceanSettings settings;
+			settings.resolution = resolution;
+			FftOcean ocean(settings, threads);
+			//A frame at 60 Hz per run, the stage times are averaged over the same runs
+			float time = 0;
+			unsigned int runs = 0;
+			OceanStats total;
+			double frame = timeRuns([&]()
+			{
+				ocean.simulate(time);
+				time += 1.0f / 60.0f;
+				++runs;
+				total.spectrumMs += ocean.getStats().spectrumMs;
+				total.fftMs += ocean.getStats().fftMs;
+				total.packMs += ocean.getStats().packMs;
+			});
+			std::cout << std::setw(10) << resolution << std::setw(9) << threads << std::fixed << std::setprecision(3) << std::setw(14) << total.spectrumMs / runs;
+			std::cout << std::setw(10) << total.fftMs / runs << std::setw(10) << total.packMs / runs << std::setw(12) << frame << std::endl;
+		}
+	}
+	printWorkerStats();
+}
+
+void runWaveBenchmark()
+{
+	const unsigned int counts[] = { 1000, 10000, 100000 };
+	GerstnerWaves waves = GerstnerWaves::makeDefault();
+	const WaveData& data = waves.getData();
+	const float time = 12.5f;
+	std::cout << std::setw(10) << "points" << std::setw(12) << "scalar ms" << std::setw(12) << "simd ms" << std::setw(10) << "speedup" << std::setw(14) << "ns / point" << std::setw(14) << "max error" << std::endl;
+	for (unsigned int count : counts)
+	{
+		std::mt19937 random(count);
+		std::uniform_real_distribution<float> spread(-500.0f, 500.0f);
+		std::vector<float> x(count);
+		std::vector<float> z(count);
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			x[i] = spread(random);
+			z[i] = spread(random);
+		}
+		std::vector<float> heights(count);
+		std::vector<float> reference(count);
+		std::vector<glm::vec3> normals(count);
+
+		//The same fixed point inversion and sums one point at a time with std::sin and std::cos, heights only
+		double scalar = timeRuns([&]()
+		{
+			for (unsigned int point = 0; point < count; ++point)
+			{
+				float restX = x[point];
+				float restZ = z[point];
+				for (int step = 0; step < 3; ++step)
+				{
+					float movedX = 0;
+					float movedZ = 0;
+					for (int i = 0; i < data.count; ++i)
+					{
+						float sideways = data.size[i].y * std::cos(data.shape[i].z * (data.shape[i].x * restX + data.shape[i].y * restZ) - data.shape[i].w * time);
+						movedX += sideways * data.shape[i].x;
+						movedZ += sideways * data.shape[i].y;
+					}
+					restX = x[point] - movedX;
+					restZ = z[point] - movedZ;
+				}
+				float height = 0;
+				for (int i = 0; i < data.count; ++i)
+				{
+					height += data.size[i].x * std::sin(data.shape[i].z * (data.shape[i].x * restX + data.shape[i].y * restZ) - data.shape[i].w * time);
+				}
+				reference[point] = height;
+			}
+		});
+		double vectorized = timeRuns([&]()
+		{
+			waves.sample(x.data(), z.data(), count, time, heights.data(), nullptr);
+		});
+		double withNormals = timeRuns([&]()
+		{
+			waves.sample(x.data(), z.data(), count, time, heights.data(), normals.data());
+		});
+		float error = 0;
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			error = std::max(error, std::abs(heights[i] - reference[i]));
+		}
+		std::cout << std::setw(10) << count << std::fixed << std::setprecision(3) << std::setw(12) << scalar << std::setw(12) << vectorized << std::setw(9) << std::setprecision(2) << scalar / vectorized << "x";
+		std::cout << std::setw(14) << withNormals * 1e6 / count << std::scientific << std::setw(14) << error << std::defaultfloat << std::endl;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+
+class Window;
+class Shader;
+class Model;
+class Sprite;
+
+//Renders 1 to 100k copies of the model and sprite, once with a draw call per copy and
+//once through an InstanceSet, and prints the average frame time of each path
+void runInstancingBenchmark(Window& window, Model& model, Sprite& sprite, Shader& modelShader, Shader& instancedModelShader, Shader& spriteShader, Shader& instancedSpriteShader);
+
+//Draws tens of thousands of sprites alternating between two textures, one draw call per sprite
+//against a SpriteBatch, and prints frame time, draw calls and fence waits
+void runSpriteBatchBenchmark(Window& window, Sprite& first, Sprite& second, Shader& spriteShader, Shader& batchShader);
+
+//Records thousands of model copies into command lists with one job and then with one per
+//JobSystem worker, and prints the recording, replay and total frame time of each and the worker load
+void runCommandListBenchmark(Window& window, Model& model, Shader& shader);
+
+//Times the SimdMath batch kernels against the per object glm code they replace (the transform
+//Model and Sprite used to build in draw) for 1k to 1M objects. Needs no GL context
+void runMathBenchmark();
+
+//Builds a DynamicBvh over 10k to 1M boxes and times inserting, SAH rebuilds, refits after moving
+//a tenth of them and frustum, range and ray queries against a linear scan. Needs no GL context
+void runBvhBenchmark();
+
+//Rasterizes a row of building occluders into the OcclusionCuller at two resolutions in one band up
+//to one per JobSystem worker and times setup, rasterization and testing 100k boxes. Needs no GL context
+void runOcclusionBenchmark();
+
+//Plays a 64 joint clip on 1 to 10k animators, sampling the raw keys with glm, the compressed clip
+//one character after the other and the compressed clip over the JobSystem workers, and prints the
+//time per character, clip and per character memory and the palette error. Needs no GL context
+void runAnimationBenchmark();
+
+//Steps the FFT ocean at 128 to 512 samples per side on one thread up to one per JobSystem worker and
+//prints the spectrum, FFT and packing time of a frame. Needs no GL context
+void runOceanBenchmark();
+
+//Samples the default Gerstner waves at 1k to 100k points with GerstnerWaves::sample against the same
+//sums one point at a time, and prints both times, the time per point with normals and the largest
+//height difference. Needs no GL context
+void runWaveBenchmark();
\ No newline at end of file
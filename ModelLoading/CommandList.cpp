@@ -0,0 +1,179 @@
+#include "CommandList.h"
+#include "JobSystem.h"
+#include "Window.h"
+#include "Shader.h"
+#include "Mesh.h"
+#include "SceneGraph.h"
+#include <glad/glad.h>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	//Draw data is copied into the ring in blocks of this many entries, well below a region
+	const unsigned int drawDataBlock = 4096;
+}
+
+void CommandList::reset()
+{
+	commands.clear();
+	drawData.clear();
+}
+
+void CommandList::bindPipeline(Shader& shader)
+{
+	RenderCommand command;
+	command.type = RenderCommandType::BindPipeline;
+	command.shader = &shader;
+	commands.push_back(command);
+}
+
+void CommandList::bindMaterial(const Mesh& mesh)
+{
+	RenderCommand command;
+	command.type = RenderCommandType::BindMaterial;
+	command.material = &mesh;
+	commands.push_back(command);
+}
+
+void CommandList::setDrawData(const glm::mat4& model)
+{
+	RenderCommand command;
+	command.type = RenderCommandType::SetDrawData;
+	command.drawData = drawData.size();
+	drawData.push_back(ObjectData(model));
+	commands.push_back(command);
+}
+
+void CommandList::drawRange(const MeshRange& range)
+{
+	RenderCommand command;
+	command.type = RenderCommandType::DrawRange;
+	command.range = range;
+	commands.push_back(command);
+}
+
+ParallelRecorder::ParallelRecorder(unsigned int threadCount)
+{
+	if (threadCount == 0)
+	{
+		threadCount = JobSystem::get().getWorkerCount();
+	}
+	this->threadCount = threadCount;
+}
+
+void ParallelRecorder::record(unsigned int parts, const std::function<void(CommandList&, unsigned int)>& recorder)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	if (lists.size() < parts)
+	{
+		lists.resize(parts);
+	}
+	partCount = parts;
+	//Reading a dirty graph updates it, which must not happen from several threads at once
+	if (SceneGraph::get().isDirty())
+	{
+		SceneGraph::get().update();
+	}
+	for (unsigned int i = 0; i < parts; ++i)
+	{
+		lists[i].reset();
+	}
+
+	//Every job takes every n-th part, the lists are separate so nothing is shared while recording
+	unsigned int workers = std::min(threadCount, parts);
+	auto recordParts = [this, workers, parts, &recorder](unsigned int first)
+	{
+		for (unsigned int part = first; part < parts; part += workers)
+		{
+			recorder(lists[part], part);
+		}
+	};
+	JobSystem& jobs = JobSystem::get();
+	JobCounter counter;
+	for (unsigned int i = 1; i < workers; ++i)
+	{
+		jobs.run([&recordParts, i]() { recordParts(i); }, &counter);
+	}
+	if (workers > 0)
+	{
+		recordParts(0);
+	}
+	jobs.wait(counter);
+
+	stats = ParallelRecorderStats();
+	stats.threads = workers;
+	stats.recordMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void ParallelRecorder::execute(Window& window)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	//Redundant binds are skipped across list boundaries as well, the lists replay as one stream
+	Shader* pipeline = nullptr;
+	const Mesh* material = nullptr;
+	glBindVertexArray(GeometryArena::get().getVertexArray());
+	for (unsigned int i = 0; i < partCount; ++i)
+	{
+		executeList(window, lists[i], pipeline, material);
+	}
+	glBindVertexArray(0);
+	stats.executeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void ParallelRecorder::executeList(Window& window, const CommandList& list, Shader*& pipeline, const Mesh*& material)
+{
+	const std::vector<ObjectData>& drawData = list.getDrawData();
+	GpuRingBuffer& ring = window.getUniformRing();
+	size_t stride = (sizeof(ObjectData) + GpuRingBuffer::getUniformAlignment() - 1) / GpuRingBuffer::getUniformAlignment() * GpuRingBuffer::getUniformAlignment();
+	RingAllocation block;
+	unsigned int blockStart = 0;
+	unsigned int blockEnd = 0;
+
+	for (const RenderCommand& command : list.getCommands())
+	{
+		switch (command.type)
+		{
+		case RenderCommandType::BindPipeline:
+			if (command.shader != pipeline)
+			{
+				pipeline = command.shader;
+				material = nullptr;
+				pipeline->use();
+				window.bindFrameData();
+				Mesh::bindSceneLight(window);
+				++stats.stateChanges;
+			}
+			break;
+		case RenderCommandType::BindMaterial:
+			if (command.material != material && pipeline)
+			{
+				material = command.material;
+				material->bindMaterial(*pipeline);
+				++stats.stateChanges;
+			}
+			break;
+		case RenderCommandType::SetDrawData:
+			//Copied a block at a time so the staging path flushes once per block instead of per draw
+			if (command.drawData >= blockEnd)
+			{
+				blockStart = command.drawData;
+				blockEnd = std::min(blockStart + drawDataBlock, (unsigned int)drawData.size());
+				block = ring.allocate(stride * (blockEnd - blockStart), GpuRingBuffer::getUniformAlignment());
+				for (unsigned int j = blockStart; j < blockEnd; ++j)
+				{
+					memcpy((char*)block.data + stride * (j - blockStart), &drawData[j], sizeof(ObjectData));
+				}
+				ring.flush();
+			}
+			glBindBufferRange(GL_UNIFORM_BUFFER, ObjectData::binding, ring.getBuffer(), block.offset + stride * (command.drawData - blockStart), sizeof(ObjectData));
+			break;
+		case RenderCommandType::DrawRange:
+			glDrawElementsBaseVertex(GL_TRIANGLES, command.range.indexCount, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int) * command.range.firstIndex), command.range.baseVertex);
+			++stats.draws;
+			break;
+		}
+		++stats.commands;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include <glm/glm.hpp>
+#include "GeometryArena.h"
+#include "UniformBlocks.h"
+
+class Window;
+class Shader;
+class Mesh;
+
+enum class RenderCommandType : unsigned char
+{
+	BindPipeline,
+	BindMaterial,
+	SetDrawData,
+	DrawRange
+};
+
+//Only the fields of its type are used, nothing here touches GL
+struct RenderCommand
+{
+	RenderCommandType type;
+	Shader* shader = nullptr;
+	const Mesh* material = nullptr;
+	//Index into the draw data of the list
+	unsigned int drawData = 0;
+	MeshRange range;
+};
+
+//Draws recorded without a GL context, so any thread can fill one. The per draw data (model and
+//normal matrix) is computed while recording and only copied into the uniform ring on replay
+class CommandList
+{
+public:
+	void reset();
+
+	void bindPipeline(Shader& shader);
+	void bindMaterial(const Mesh& mesh);
+	void setDrawData(const glm::mat4& model);
+	//Drawn from the GeometryArena with the last pipeline, material and draw data
+	void drawRange(const MeshRange& range);
+
+	const std::vector<RenderCommand>& getCommands() const { return commands; }
+	const std::vector<ObjectData>& getDrawData() const { return drawData; }
+private:
+	std::vector<RenderCommand> commands;
+	std::vector<ObjectData> drawData;
+};
+
+struct ParallelRecorderStats
+{
+	unsigned int threads = 0;
+	unsigned int commands = 0;
+	unsigned int draws = 0;
+	//Pipeline and material binds actually issued after skipping the redundant ones
+	unsigned int stateChanges = 0;
+	double recordMs = 0;
+	double executeMs = 0;
+};
+
+//Splits recording of a frame into parts filled in parallel, one command list per part, then
+//replays the lists in part order on the GL thread
+class ParallelRecorder
+{
+public:
+	//Parts are spread over this many jobs on the JobSystem, 0 uses one per worker
+	ParallelRecorder(unsigned int threadCount = 0);
+
+	//Calls recorder(list, part) once per part. The calling thread takes part of the work, so a
+	//single thread records everything in place
+	void record(unsigned int parts, const std::function<void(CommandList&, unsigned int)>& recorder);
+	void execute(Window& window);
+
+	unsigned int getThreadCount() const { return threadCount; }
+	const ParallelRecorderStats& getStats() const { return stats; }
+private:
+	void executeList(Window& window, const CommandList& list, Shader*& pipeline, const Mesh*& material);
+
+	unsigned int threadCount;
+	unsigned int partCount = 0;
+	//Kept between frames so the command storage is reused
+	std::vector<CommandList> lists;
+	ParallelRecorderStats stats;
+};
\ No newline at end of file
@@ -0,0 +1,559 @@
+#include "DynamicBvh.h"
+#include "FrustumCuller.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+const unsigned int DynamicBvh::nullNode;
+
+namespace
+{
+	const unsigned int binCount = 12;
+
+	AABB merge(const AABB& a, const AABB& b)
+	{
+		AABB result;
+		result.min = glm::min(a.min, b.min);
+		result.max = glm::max(a.max, b.max);
+		return result;
+	}
+
+	//Half the surface area, only ever compared against other areas
+	float area(const AABB& box)
+	{
+		glm::vec3 size = box.max - box.min;
+		return size.x * size.y + size.y * size.z + size.z * size.x;
+	}
+
+	bool overlaps(const AABB& a, const AABB& b)
+	{
+		return a.min.x <= b.max.x && a.max.x >= b.min.x && a.min.y <= b.max.y && a.max.y >= b.min.y && a.min.z <= b.max.z && a.max.z >= b.min.z;
+	}
+
+	bool contains(const AABB& outer, const AABB& inner)
+	{
+		return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z && outer.max.x >= inner.max.x && outer.max.y >= inner.max.y && outer.max.z >= inner.max.z;
+	}
+
+	bool sameBox(const AABB& a, const AABB& b)
+	{
+		return a.min == b.min && a.max == b.max;
+	}
+
+	//Slab test, entry distance in t when the ray hits the box before maxDistance
+	bool intersectRay(const AABB& box, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, float& t)
+	{
+		float enter = 0.0f;
+		float exit = maxDistance;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			//A ray parallel to the slab is inside it everywhere or nowhere. Multiplying would give 0 * inf
+			//for an origin on a face, which flat boxes such as the water's have on every ray along them
+			if (std::isinf(inverseDirection[axis]))
+			{
+				if (origin[axis] < box.min[axis] || origin[axis] > box.max[axis])
+				{
+					return false;
+				}
+				continue;
+			}
+			float t0 = (box.min[axis] - origin[axis]) * inverseDirection[axis];
+			float t1 = (box.max[axis] - origin[axis]) * inverseDirection[axis];
+			enter = std::max(enter, std::min(t0, t1));
+			exit = std::min(exit, std::max(t0, t1));
+		}
+		t = enter;
+		return enter <= exit;
+	}
+}
+
+unsigned int DynamicBvh::allocateNode()
+{
+	unsigned int node;
+	if (!freeNodes.empty())
+	{
+		node = freeNodes.back();
+		freeNodes.pop_back();
+		nodes[node] = Node();
+	}
+	else
+	{
+		node = nodes.size();
+		nodes.push_back(Node());
+	}
+	++stats.nodes;
+	return node;
+}
+
+void DynamicBvh::freeNode(unsigned int node)
+{
+	freeNodes.push_back(node);
+	--stats.nodes;
+}
+
+unsigned int DynamicBvh::insert(const AABB& bounds, unsigned int object)
+{
+	unsigned int leaf = allocateNode();
+	nodes[leaf].bounds = bounds;
+	nodes[leaf].object = object;
+	insertLeaf(leaf);
+	++stats.leaves;
+	++refitsSinceRebuild;
+	return leaf;
+}
+
+void DynamicBvh::remove(unsigned int proxy)
+{
+	removeLeaf(proxy);
+	freeNode(proxy);
+	--stats.leaves;
+}
+
+void DynamicBvh::update(unsigned int proxy, const AABB& bounds)
+{
+	nodes[proxy].bounds = bounds;
+	refitFrom(nodes[proxy].parent);
+	++stats.refits;
+	++refitsSinceRebuild;
+}
+
+void DynamicBvh::refitFrom(unsigned int node)
+{
+	while (node != nullNode)
+	{
+		AABB bounds = merge(nodes[nodes[node].left].bounds, nodes[nodes[node].right].bounds);
+		//Nothing above changes once a box comes out the same
+		if (sameBox(bounds, nodes[node].bounds))
+		{
+			break;
+		}
+		nodes[node].bounds = bounds;
+		node = nodes[node].parent;
+	}
+}
+
+void DynamicBvh::insertLeaf(unsigned int leaf)
+{
+	if (root == nullNode)
+	{
+		root = leaf;
+		nodes[leaf].parent = nullNode;
+		return;
+	}
+
+	//Walk down while pushing the leaf lower is cheaper than making it a sibling here
+	const AABB& leafBounds = nodes[leaf].bounds;
+	unsigned int index = root;
+	while (!nodes[index].isLeaf())
+	{
+		const Node& node = nodes[index];
+		float combinedArea = area(merge(node.bounds, leafBounds));
+		float cost = 2.0f * combinedArea;
+		float inheritance = 2.0f * (combinedArea - area(node.bounds));
+
+		float childCost[2];
+		unsigned int children[2] = { node.left, node.right };
+		for (int i = 0; i < 2; ++i)
+		{
+			const Node& child = nodes[children[i]];
+			float grown = area(merge(leafBounds, child.bounds));
+			childCost[i] = (child.isLeaf() ? grown : grown - area(child.bounds)) + inheritance;
+		}
+		if (cost < childCost[0] && cost < childCost[1])
+		{
+			break;
+		}
+		index = childCost[0] < childCost[1] ? children[0] : children[1];
+	}
+
+	unsigned int sibling = index;
+	unsigned int oldParent = nodes[sibling].parent;
+	unsigned int newParent = allocateNode();
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].bounds = merge(nodes[leaf].bounds, nodes[sibling].bounds);
+	nodes[newParent].left = sibling;
+	nodes[newParent].right = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+	if (oldParent == nullNode)
+	{
+		root = newParent;
+	}
+	else
+	{
+		if (nodes[oldParent].left == sibling)
+		{
+			nodes[oldParent].left = newParent;
+		}
+		else
+		{
+			nodes[oldParent].right = newParent;
+		}
+		refitFrom(oldParent);
+	}
+}
+
+void DynamicBvh::removeLeaf(unsigned int leaf)
+{
+	if (leaf == root)
+	{
+		root = nullNode;
+		return;
+	}
+	unsigned int parent = nodes[leaf].parent;
+	unsigned int grandParent = nodes[parent].parent;
+	unsigned int sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+	//The sibling takes the parent's place
+	if (grandParent == nullNode)
+	{
+		root = sibling;
+		nodes[sibling].parent = nullNode;
+	}
+	else
+	{
+		if (nodes[grandParent].left == parent)
+		{
+			nodes[grandParent].left = sibling;
+		}
+		else
+		{
+			nodes[grandParent].right = sibling;
+		}
+		nodes[sibling].parent = grandParent;
+		refitFrom(grandParent);
+	}
+	freeNode(parent);
+	nodes[leaf].parent = nullNode;
+}
+
+void DynamicBvh::rebuild()
+{
+	buildLeaves.clear();
+	if (root != nullNode)
+	{
+		//Leaves are kept, every inner node is freed and built again
+		stack.clear();
+		stack.push_back(root);
+		while (!stack.empty())
+		{
+			unsigned int node = stack.back();
+			stack.pop_back();
+			if (nodes[node].isLeaf())
+			{
+				buildLeaves.push_back(node);
+			}
+			else
+			{
+				stack.push_back(nodes[node].left);
+				stack.push_back(nodes[node].right);
+				freeNode(node);
+			}
+		}
+	}
+	root = buildLeaves.empty() ? nullNode : build(buildLeaves.data(), buildLeaves.size());
+	if (root != nullNode)
+	{
+		nodes[root].parent = nullNode;
+	}
+	refitsSinceRebuild = 0;
+	rebuiltCost = computeCost();
+	stats.cost = rebuiltCost;
+	++stats.rebuilds;
+}
+
+unsigned int DynamicBvh::build(unsigned int* leaves, unsigned int count)
+{
+	if (count == 1)
+	{
+		return leaves[0];
+	}
+
+	AABB centroidBounds;
+	centroidBounds.min = (nodes[leaves[0]].bounds.min + nodes[leaves[0]].bounds.max) * 0.5f;
+	centroidBounds.max = centroidBounds.min;
+	for (unsigned int i = 1; i < count; ++i)
+	{
+		glm::vec3 centroid = (nodes[leaves[i]].bounds.min + nodes[leaves[i]].bounds.max) * 0.5f;
+		centroidBounds.min = glm::min(centroidBounds.min, centroid);
+		centroidBounds.max = glm::max(centroidBounds.max, centroid);
+	}
+	glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+	int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+	float axisMin = centroidBounds.min[axis];
+	float axisExtent = extent[axis];
+
+	unsigned int mid = count / 2;
+	if (axisExtent > 0)
+	{
+		auto binOf = [&](unsigned int leaf)
+		{
+			float centroid = (nodes[leaf].bounds.min[axis] + nodes[leaf].bounds.max[axis]) * 0.5f;
+			return std::min((unsigned int)((centroid - axisMin) / axisExtent * binCount), binCount - 1);
+		};
+		AABB binBounds[binCount];
+		unsigned int binCounts[binCount] = {};
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			unsigned int bin = binOf(leaves[i]);
+			binBounds[bin] = binCounts[bin] ? merge(binBounds[bin], nodes[leaves[i]].bounds) : nodes[leaves[i]].bounds;
+			++binCounts[bin];
+		}
+
+		//Cost of splitting after each bin, swept from both sides
+		float leftCost[binCount - 1];
+		AABB accumulated;
+		unsigned int accumulatedCount = 0;
+		for (unsigned int i = 0; i < binCount - 1; ++i)
+		{
+			if (binCounts[i])
+			{
+				accumulated = accumulatedCount ? merge(accumulated, binBounds[i]) : binBounds[i];
+				accumulatedCount += binCounts[i];
+			}
+			leftCost[i] = accumulatedCount ? accumulatedCount * area(accumulated) : 0;
+		}
+		float bestCost = 0;
+		unsigned int bestSplit = binCount;
+		accumulatedCount = 0;
+		for (unsigned int i = binCount - 1; i > 0; --i)
+		{
+			if (binCounts[i])
+			{
+				accumulated = accumulatedCount ? merge(accumulated, binBounds[i]) : binBounds[i];
+				accumulatedCount += binCounts[i];
+			}
+			float cost = leftCost[i - 1] + (accumulatedCount ? accumulatedCount * area(accumulated) : 0);
+			if (accumulatedCount && accumulatedCount < count && (bestSplit == binCount || cost < bestCost))
+			{
+				bestCost = cost;
+				bestSplit = i - 1;
+			}
+		}
+		if (bestSplit != binCount)
+		{
+			mid = std::partition(leaves, leaves + count, [&](unsigned int leaf) { return binOf(leaf) <= bestSplit; }) - leaves;
+		}
+	}
+	//Every centroid in one place or one bin, split in the middle instead
+	if (mid == 0 || mid == count || axisExtent <= 0)
+	{
+		mid = count / 2;
+		std::nth_element(leaves, leaves + mid, leaves + count, [&](unsigned int a, unsigned int b)
+		{
+			return nodes[a].bounds.min[axis] + nodes[a].bounds.max[axis] < nodes[b].bounds.min[axis] + nodes[b].bounds.max[axis];
+		});
+	}
+
+	unsigned int left = build(leaves, mid);
+	unsigned int right = build(leaves + mid, count - mid);
+	unsigned int node = allocateNode();
+	nodes[node].left = left;
+	nodes[node].right = right;
+	nodes[node].bounds = merge(nodes[left].bounds, nodes[right].bounds);
+	nodes[left].parent = node;
+	nodes[right].parent = node;
+	return node;
+}
+
+bool DynamicBvh::rebuildIfNeeded(float costRatio)
+{
+	//Checking the cost walks the whole tree, so it only happens once a quarter of the leaves moved
+	if (stats.leaves < 2 || refitsSinceRebuild < stats.leaves / 4)
+	{
+		return false;
+	}
+	refitsSinceRebuild = 0;
+	stats.cost = computeCost();
+	if (stats.cost <= rebuiltCost * costRatio && rebuiltCost > 0)
+	{
+		return false;
+	}
+	rebuild();
+	return true;
+}
+
+float DynamicBvh::computeCost() const
+{
+	if (root == nullNode || nodes[root].isLeaf())
+	{
+		return 0;
+	}
+	float rootArea = area(nodes[root].bounds);
+	if (rootArea <= 0)
+	{
+		return 0;
+	}
+	float total = 0;
+	std::vector<unsigned int> pending;
+	pending.push_back(root);
+	while (!pending.empty())
+	{
+		unsigned int node = pending.back();
+		pending.pop_back();
+		if (!nodes[node].isLeaf())
+		{
+			total += area(nodes[node].bounds);
+			pending.push_back(nodes[node].left);
+			pending.push_back(nodes[node].right);
+		}
+	}
+	return total / rootArea;
+}
+
+void DynamicBvh::collectLeaves(unsigned int node, std::vector<unsigned int>& objects)
+{
+	size_t base = stack.size();
+	stack.push_back(node);
+	while (stack.size() > base)
+	{
+		unsigned int current = stack.back();
+		stack.pop_back();
+		++stats.nodesVisited;
+		if (nodes[current].isLeaf())
+		{
+			objects.push_back(nodes[current].object);
+		}
+		else
+		{
+			stack.push_back(nodes[current].left);
+			stack.push_back(nodes[current].right);
+		}
+	}
+}
+
+void DynamicBvh::query(const FrustumCuller& culler, std::vector<unsigned int>& objects)
+{
+	stats.nodesVisited = 0;
+	if (root == nullNode)
+	{
+		return;
+	}
+	stack.clear();
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		unsigned int node = stack.back();
+		stack.pop_back();
+		++stats.nodesVisited;
+		FrustumTest test = culler.classify(nodes[node].bounds);
+		if (test == FrustumTest::Outside)
+		{
+			continue;
+		}
+		if (nodes[node].isLeaf())
+		{
+			objects.push_back(nodes[node].object);
+		}
+		else if (test == FrustumTest::Inside)
+		{
+			--stats.nodesVisited;
+			collectLeaves(node, objects);
+		}
+		else
+		{
+			stack.push_back(nodes[node].left);
+			stack.push_back(nodes[node].right);
+		}
+	}
+}
+
+void DynamicBvh::query(const AABB& range, std::vector<unsigned int>& objects)
+{
+	stats.nodesVisited = 0;
+	if (root == nullNode)
+	{
+		return;
+	}
+	stack.clear();
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		unsigned int node = stack.back();
+		stack.pop_back();
+		++stats.nodesVisited;
+		if (!overlaps(nodes[node].bounds, range))
+		{
+			continue;
+		}
+		if (nodes[node].isLeaf())
+		{
+			objects.push_back(nodes[node].object);
+		}
+		else if (contains(range, nodes[node].bounds))
+		{
+			--stats.nodesVisited;
+			collectLeaves(node, objects);
+		}
+		else
+		{
+			stack.push_back(nodes[node].left);
+			stack.push_back(nodes[node].right);
+		}
+	}
+}
+
+bool DynamicBvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, BvhRayHit& hit)
+{
+	stats.nodesVisited = 0;
+	if (root == nullNode)
+	{
+		return false;
+	}
+	glm::vec3 inverseDirection = 1.0f / direction;
+	float closest = maxDistance;
+	bool found = false;
+	//Entry distance kept next to each pending node so farther subtrees are skipped once something closer was hit
+	std::vector<std::pair<unsigned int, float>>& pending = rayStack;
+	pending.clear();
+	float t;
+	if (!intersectRay(nodes[root].bounds, origin, inverseDirection, closest, t))
+	{
+		return false;
+	}
+	pending.push_back(std::make_pair(root, t));
+	while (!pending.empty())
+	{
+		std::pair<unsigned int, float> entry = pending.back();
+		pending.pop_back();
+		++stats.nodesVisited;
+		if (entry.second > closest)
+		{
+			continue;
+		}
+		const Node& node = nodes[entry.first];
+		if (node.isLeaf())
+		{
+			closest = entry.second;
+			hit.object = node.object;
+			hit.distance = entry.second;
+			found = true;
+			continue;
+		}
+		float tLeft, tRight;
+		bool hitLeft = intersectRay(nodes[node.left].bounds, origin, inverseDirection, closest, tLeft);
+		bool hitRight = intersectRay(nodes[node.right].bounds, origin, inverseDirection, closest, tRight);
+		//The nearer child goes on top so it is visited first
+		if (hitLeft && hitRight)
+		{
+			if (tLeft < tRight)
+			{
+				pending.push_back(std::make_pair(node.right, tRight));
+				pending.push_back(std::make_pair(node.left, tLeft));
+			}
+			else
+			{
+				pending.push_back(std::make_pair(node.left, tLeft));
+				pending.push_back(std::make_pair(node.right, tRight));
+			}
+		}
+		else if (hitLeft)
+		{
+			pending.push_back(std::make_pair(node.left, tLeft));
+		}
+		else if (hitRight)
+		{
+			pending.push_back(std::make_pair(node.right, tRight));
+		}
+	}
+	return found;
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+#include <vector>
+#include <utility>
+#include <glm/glm.hpp>
+#include "SimdMath.h"
+
+class FrustumCuller;
+
+struct BvhRayHit
+{
+	unsigned int object = 0;
+	//Distance along the ray to where it enters the object's box
+	float distance = 0;
+};
+
+struct BvhStats
+{
+	unsigned int leaves = 0;
+	unsigned int nodes = 0;
+	unsigned int refits = 0;
+	unsigned int rebuilds = 0;
+	//Nodes touched by the last query
+	unsigned int nodesVisited = 0;
+	//Surface area heuristic cost relative to the root, recomputed on rebuild
+	float cost = 0;
+};
+
+//Dynamic AABB tree over objects identified by an unsigned int. Inserting descends towards the
+//sibling that grows the least, moving an object only refits the boxes above its leaf, and the
+//tree is rebuilt top down with binned SAH once the refits have made it noticeably worse.
+//Leaves keep their node index for their whole life, so the index returned by insert is the handle
+class DynamicBvh
+{
+public:
+	static const unsigned int nullNode = 0xFFFFFFFF;
+
+	DynamicBvh() {}
+	DynamicBvh(const DynamicBvh&) = delete;
+	DynamicBvh& operator=(const DynamicBvh&) = delete;
+
+	unsigned int insert(const AABB& bounds, unsigned int object);
+	void remove(unsigned int proxy);
+	//Refits the leaf and its ancestors, the shape of the tree stays the same
+	void update(unsigned int proxy, const AABB& bounds);
+	void rebuild();
+	//Rebuilds when enough leaves moved since the last rebuild and the SAH cost grew past the ratio
+	bool rebuildIfNeeded(float costRatio = 1.3f);
+
+	const AABB& getBounds(unsigned int proxy) const { return nodes[proxy].bounds; }
+	unsigned int getObject(unsigned int proxy) const { return nodes[proxy].object; }
+
+	//Appends the objects whose boxes touch the frustum, whole subtrees inside it are added without testing
+	void query(const FrustumCuller& culler, std::vector<unsigned int>& objects);
+	void query(const AABB& range, std::vector<unsigned int>& objects);
+	//Closest box hit along the ray, direction does not need to be normalized
+	bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, BvhRayHit& hit);
+
+	float computeCost() const;
+	const BvhStats& getStats() const { return stats; }
+private:
+	struct Node
+	{
+		AABB bounds;
+		unsigned int parent = nullNode;
+		//Both nullNode for leaves
+		unsigned int left = nullNode;
+		unsigned int right = nullNode;
+		unsigned int object = 0;
+		bool isLeaf() const { return left == nullNode; }
+	};
+
+	unsigned int allocateNode();
+	void freeNode(unsigned int node);
+	void insertLeaf(unsigned int leaf);
+	void removeLeaf(unsigned int leaf);
+	void refitFrom(unsigned int node);
+	unsigned int build(unsigned int* leaves, unsigned int count);
+	void collectLeaves(unsigned int node, std::vector<unsigned int>& objects);
+
+	std::vector<Node> nodes;
+	std::vector<unsigned int> freeNodes;
+	unsigned int root = nullNode;
+	unsigned int refitsSinceRebuild = 0;
+	float rebuiltCost = 0;
+	std::vector<unsigned int> stack;
+	std::vector<std::pair<unsigned int, float>> rayStack;
+	std::vector<unsigned int> buildLeaves;
+	BvhStats stats;
+};
\ No newline at end of file
@@ -0,0 +1,378 @@
+#include "EntityStore.h"
+#include "SceneGraph.h"
+#include "Model.h"
+#include "Window.h"
+#include "Shader.h"
+#include "FrustumCuller.h"
+#include "OcclusionCuller.h"
+#include "HiZCuller.h"
+#include "IndirectRenderer.h"
+#include "SpriteBatch.h"
+#include "WaterClipmap.h"
+#include "FftOcean.h"
+#include "RippleField.h"
+#include "GerstnerWaves.h"
+#include "JobSystem.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace
+{
+	//Rows per job in the update and cull stages, fewer run on the calling thread
+	const unsigned int batchSize = 2048;
+
+	//Locations are unique among live entities, which is all the Hi-Z culler asks of its keys
+	const void* getHiZKey(const Entity& entity)
+	{
+		return (const void*)(uintptr_t)(entity.index + 1);
+	}
+
+	template<typename T>
+	void removeRow(std::vector<T>& column, unsigned int row)
+	{
+		column[row] = column.back();
+		column.pop_back();
+	}
+}
+
+Entity EntityStore::allocate(Archetype archetype, unsigned int row)
+{
+	unsigned int index;
+	if (freeLocations.empty())
+	{
+		index = locations.size();
+		locations.push_back(Location());
+	}
+	else
+	{
+		index = freeLocations.back();
+		freeLocations.pop_back();
+	}
+	Location& location = locations[index];
+	location.archetype = archetype;
+	location.row = row;
+	location.alive = true;
+
+	Entity entity;
+	entity.index = index;
+	entity.generation = location.generation;
+	return entity;
+}
+
+Entity EntityStore::createMesh(unsigned int node, Mesh& mesh)
+{
+	Entity entity = allocate(Archetype::Mesh, meshRows.entities.size());
+	meshRows.entities.push_back(entity);
+	meshRows.nodes.push_back(node);
+	meshRows.meshes.push_back(&mesh);
+	meshRows.localBounds.push_back(mesh.getBounds());
+	meshRows.transforms.push_back(glm::mat4(1.0f));
+	meshRows.worldBounds.push_back(mesh.getBounds());
+	meshRows.visible.push_back(1);
+	meshRows.proxies.push_back(meshBvh.insert(mesh.getBounds(), entity.index));
+	++stats.meshes;
+	return entity;
+}
+
+Entity EntityStore::createSprite(unsigned int node, unsigned int texture, const glm::vec4& tint)
+{
+	Entity entity = allocate(Archetype::Sprite, spriteRows.entities.size());
+	spriteRows.entities.push_back(entity);
+	spriteRows.nodes.push_back(node);
+	spriteRows.textures.push_back(texture);
+	spriteRows.tints.push_back(tint);
+	spriteRows.localBounds.push_back(Sprite::getQuadBounds());
+	spriteRows.transforms.push_back(glm::mat4(1.0f));
+	spriteRows.worldBounds.push_back(Sprite::getQuadBounds());
+	spriteRows.visible.push_back(1);
+	++stats.sprites;
+	return entity;
+}
+
+Entity EntityStore::createWater(unsigned int node, const WaterComponent& water, const AABB& bounds)
+{
+	Entity entity = allocate(Archetype::Water, waterRows.entities.size());
+	waterRows.entities.push_back(entity);
+	waterRows.nodes.push_back(node);
+	waterRows.water.push_back(water);
+	waterRows.localBounds.push_back(bounds);
+	waterRows.transforms.push_back(glm::mat4(1.0f));
+	waterRows.normalMatrices.push_back(glm::mat4(1.0f));
+	waterRows.worldBounds.push_back(bounds);
+	waterRows.visible.push_back(1);
+	++stats.water;
+	return entity;
+}
+
+bool EntityStore::isAlive(Entity entity) const
+{
+	return entity.index < locations.size() && locations[entity.index].alive && locations[entity.index].generation == entity.generation;
+}
+
+void EntityStore::moved(const Entity& entity, unsigned int row)
+{
+	locations[entity.index].row = row;
+}
+
+void EntityStore::destroy(Entity entity)
+{
+	if (!isAlive(entity))
+	{
+		return;
+	}
+	Location& location = locations[entity.index];
+	unsigned int row = location.row;
+	switch (location.archetype)
+	{
+	case Archetype::Mesh:
+		destroyedMeshKeys.push_back(getHiZKey(entity));
+		meshBvh.remove(meshRows.proxies[row]);
+		removeRow(meshRows.entities, row);
+		removeRow(meshRows.nodes, row);
+		removeRow(meshRows.meshes, row);
+		removeRow(meshRows.localBounds, row);
+		removeRow(meshRows.transforms, row);
+		removeRow(meshRows.worldBounds, row);
+		removeRow(meshRows.visible, row);
+		removeRow(meshRows.proxies, row);
+		if (row < meshRows.entities.size())
+		{
+			moved(meshRows.entities[row], row);
+		}
+		--stats.meshes;
+		break;
+	case Archetype::Sprite:
+		removeRow(spriteRows.entities, row);
+		removeRow(spriteRows.nodes, row);
+		removeRow(spriteRows.textures, row);
+		removeRow(spriteRows.tints, row);
+		removeRow(spriteRows.localBounds, row);
+		removeRow(spriteRows.transforms, row);
+		removeRow(spriteRows.worldBounds, row);
+		removeRow(spriteRows.visible, row);
+		if (row < spriteRows.entities.size())
+		{
+			moved(spriteRows.entities[row], row);
+		}
+		--stats.sprites;
+		break;
+	case Archetype::Water:
+		removeRow(waterRows.entities, row);
+		removeRow(waterRows.nodes, row);
+		removeRow(waterRows.water, row);
+		removeRow(waterRows.localBounds, row);
+		removeRow(waterRows.transforms, row);
+		removeRow(waterRows.normalMatrices, row);
+		removeRow(waterRows.worldBounds, row);
+		removeRow(waterRows.visible, row);
+		if (row < waterRows.entities.size())
+		{
+			moved(waterRows.entities[row], row);
+		}
+		--stats.water;
+		break;
+	}
+	location.alive = false;
+	++location.generation;
+	freeLocations.push_back(entity.index);
+}
+
+void EntityStore::setTint(Entity entity, const glm::vec4& tint)
+{
+	if (isAlive(entity) && locations[entity.index].archetype == Archetype::Sprite)
+	{
+		spriteRows.tints[locations[entity.index].row] = tint;
+	}
+}
+
+void EntityStore::update()
+{
+	SceneGraph& graph = SceneGraph::get();
+	graph.gather(meshRows.nodes.data(), meshRows.nodes.size(), meshRows.transforms.data());
+	JobSystem::get().parallelFor(meshRows.nodes.size(), batchSize, [this](unsigned int begin, unsigned int end)
+	{
+		simd::transformAABBs(meshRows.transforms.data() + begin, meshRows.localBounds.data() + begin, meshRows.worldBounds.data() + begin, end - begin);
+	});
+	std::fill(meshRows.visible.begin(), meshRows.visible.end(), 1);
+	//Only the leaves that moved are refitted, static rows leave the tree alone
+	for (unsigned int row = 0; row < meshRows.proxies.size(); ++row)
+	{
+		const AABB& bounds = meshRows.worldBounds[row];
+		const AABB& leaf = meshBvh.getBounds(meshRows.proxies[row]);
+		if (bounds.min != leaf.min || bounds.max != leaf.max)
+		{
+			meshBvh.update(meshRows.proxies[row], bounds);
+		}
+	}
+	meshBvh.rebuildIfNeeded();
+
+	graph.gather(spriteRows.nodes.data(), spriteRows.nodes.size(), spriteRows.transforms.data());
+	simd::transformAABBs(spriteRows.transforms.data(), spriteRows.localBounds.data(), spriteRows.worldBounds.data(), spriteRows.nodes.size());
+	std::fill(spriteRows.visible.begin(), spriteRows.visible.end(), 1);
+
+	graph.gather(waterRows.nodes.data(), waterRows.nodes.size(), waterRows.transforms.data(), waterRows.normalMatrices.data());
+	simd::transformAABBs(waterRows.transforms.data(), waterRows.localBounds.data(), waterRows.worldBounds.data(), waterRows.nodes.size());
+	std::fill(waterRows.visible.begin(), waterRows.visible.end(), 1);
+
+	stats.visible = meshRows.nodes.size() + spriteRows.nodes.size() + waterRows.nodes.size();
+}
+
+void EntityStore::cullRows(FrustumCuller& culler, OcclusionCuller* occlusion, HiZCuller* hiZ, CullingStats* cullingStats, const std::vector<Entity>& entities, const std::vector<AABB>& bounds, std::vector<unsigned char>& visible)
+{
+	JobSystem::get().parallelFor(bounds.size(), batchSize, [&culler, &bounds, &visible](unsigned int begin, unsigned int end)
+	{
+		culler.cullBoxes(bounds.data() + begin, end - begin, visible.data() + begin);
+	});
+	occludeRows(occlusion, hiZ, cullingStats, entities, bounds, visible);
+}
+
+void EntityStore::occludeRows(OcclusionCuller* occlusion, HiZCuller* hiZ, CullingStats* cullingStats, const std::vector<Entity>& entities, const std::vector<AABB>& bounds, std::vector<unsigned char>& visible)
+{
+	bool occlusionCulling = occlusion && occlusion->isEnabled();
+	CullingStats unused;
+	CullingStats& counts = cullingStats ? *cullingStats : unused;
+	for (unsigned int row = 0; row < bounds.size(); ++row)
+	{
+		bool hiZVisible = !hiZ || hiZ->isVisible(getHiZKey(entities[row]), bounds[row]);
+		if (visible[row] && ((occlusionCulling && !occlusion->isVisible(bounds[row])) || !hiZVisible))
+		{
+			visible[row] = 0;
+			++counts.meshesOccluded;
+		}
+		else if (visible[row])
+		{
+			++counts.meshesVisible;
+			++stats.visible;
+		}
+		else
+		{
+			++counts.meshesCulled;
+		}
+	}
+}
+
+void EntityStore::cull(FrustumCuller& culler, OcclusionCuller* occlusion, HiZCuller* hiZ)
+{
+	if (!culler.isEnabled())
+	{
+		return;
+	}
+	stats.visible = 0;
+	//A mesh made in a destroyed one's location must not start with its last result
+	for (const void* key : destroyedMeshKeys)
+	{
+		if (hiZ)
+		{
+			hiZ->remove(key);
+		}
+	}
+	destroyedMeshKeys.clear();
+	std::fill(meshRows.visible.begin(), meshRows.visible.end(), 0);
+	meshesInFrustum.clear();
+	meshBvh.query(culler, meshesInFrustum);
+	for (unsigned int index : meshesInFrustum)
+	{
+		meshRows.visible[locations[index].row] = 1;
+	}
+	occludeRows(occlusion, hiZ, &culler.getStats(), meshRows.entities, meshRows.worldBounds, meshRows.visible);
+	//Sprites and water are drawn blended over what is behind them, so only the frustum applies
+	cullRows(culler, nullptr, nullptr, nullptr, spriteRows.entities, spriteRows.worldBounds, spriteRows.visible);
+	cullRows(culler, nullptr, nullptr, nullptr, waterRows.entities, waterRows.worldBounds, waterRows.visible);
+}
+
+void EntityStore::submitMeshes(IndirectRenderer& renderer) const
+{
+	for (unsigned int row = 0; row < meshRows.meshes.size(); ++row)
+	{
+		if (meshRows.visible[row])
+		{
+			renderer.add(*meshRows.meshes[row], meshRows.transforms[row]);
+		}
+	}
+}
+
+void EntityStore::drawMeshes(Window& window, Shader& shader) const
+{
+	shader.use();
+
+	window.bindFrameData();
+	Mesh::bindSceneLight(window);
+	for (unsigned int row = 0; row < meshRows.meshes.size(); ++row)
+	{
+		if (meshRows.visible[row])
+		{
+			window.getUniformRing().bindUniform(ObjectData::binding, ObjectData(meshRows.transforms[row]));
+			meshRows.meshes[row]->draw(window, shader);
+		}
+	}
+}
+
+void EntityStore::submitSprites(SpriteBatch& batch) const
+{
+	for (unsigned int row = 0; row < spriteRows.textures.size(); ++row)
+	{
+		if (spriteRows.visible[row])
+		{
+			batch.draw(spriteRows.textures[row], spriteRows.transforms[row], spriteRows.tints[row]);
+		}
+	}
+}
+
+void EntityStore::drawWater(Window& window, Shader& shader) const
+{
+	for (unsigned int row = 0; row < waterRows.water.size(); ++row)
+	{
+		if (waterRows.visible[row])
+		{
+			drawWater(window, shader, waterRows.water[row], waterRows.transforms[row], waterRows.normalMatrices[row]);
+		}
+	}
+}
+
+void EntityStore::drawWater(Window& window, Shader& shader, const WaterComponent& water, const glm::mat4& model, const glm::mat4& normalMatrix)
+{
+	shader.use();
+
+	window.bindFrameData();
+	window.getUniformRing().bindUniform(ObjectData::binding, ObjectData(model, normalMatrix));
+
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, water.cubeMap);
+	//setting a static directional light for now
+
+	glUniform1i(glGetUniformLocation(shader.getID(), "cubeMap"), 1);
+
+	window.getUniformRing().bindUniform(LightData::binding, LightData(glm::vec3(std::sin(1.5f), -2, std::cos(1.5f))));
+
+	glUniform1i(glGetUniformLocation(shader.getID(), "useOcean"), water.ocean != nullptr);
+	if (water.ocean)
+	{
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D, water.ocean->getDisplacementTexture());
+		glActiveTexture(GL_TEXTURE3);
+		glBindTexture(GL_TEXTURE_2D, water.ocean->getNormalTexture());
+		glUniform1i(glGetUniformLocation(shader.getID(), "oceanDisplacement"), 2);
+		glUniform1i(glGetUniformLocation(shader.getID(), "oceanNormals"), 3);
+		glUniform1f(glGetUniformLocation(shader.getID(), "oceanPatch"), water.ocean->getSettings().patchSize);
+	}
+	else
+	{
+		window.getUniformRing().bindUniform(WaveData::binding, water.waves->getData());
+	}
+	glUniform1i(glGetUniformLocation(shader.getID(), "useRipples"), water.ripples != nullptr);
+	if (water.ripples)
+	{
+		glActiveTexture(GL_TEXTURE4);
+		glBindTexture(GL_TEXTURE_2D, water.ripples->getTexture());
+		glUniform1i(glGetUniformLocation(shader.getID(), "rippleHeights"), 4);
+		glm::vec2 origin = water.ripples->getOrigin();
+		glm::vec2 size = water.ripples->getSize();
+		glUniform4f(glGetUniformLocation(shader.getID(), "rippleArea"), origin.x, origin.y, size.x, size.y);
+	}
+
+	//The clipmap levels centre on the camera, found in the water's object space
+	glm::vec4 camera = glm::inverse(model) * glm::inverse(window.getView())[3];
+	water.clipmap->draw(shader, glm::vec2(camera.x, camera.y));
+}
\ No newline at end of file
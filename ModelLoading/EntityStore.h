@@ -0,0 +1,156 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "SimdMath.h"
+#include "DynamicBvh.h"
+
+class Window;
+class Shader;
+class Mesh;
+class FrustumCuller;
+class OcclusionCuller;
+class HiZCuller;
+struct CullingStats;
+class IndirectRenderer;
+class SpriteBatch;
+class WaterClipmap;
+class FftOcean;
+class RippleField;
+class GerstnerWaves;
+
+//Handle to a row in one of the archetypes, the generation catches handles to destroyed entities
+struct Entity
+{
+	unsigned int index = 0xFFFFFFFF;
+	unsigned int generation = 0;
+};
+
+enum class Archetype : unsigned char
+{
+	Mesh,
+	Sprite,
+	Water
+};
+
+//Everything the water surface needs to be drawn, owned by the WaterBody that created it
+struct WaterComponent
+{
+	const WaterClipmap* clipmap = nullptr;
+	unsigned int cubeMap = 0;
+	//Drawn when there is no ocean
+	const GerstnerWaves* waves = nullptr;
+	//Null for the waves
+	const FftOcean* ocean = nullptr;
+	//Null for none
+	const RippleField* ripples = nullptr;
+};
+
+struct EntityStoreStats
+{
+	unsigned int meshes = 0;
+	unsigned int sprites = 0;
+	unsigned int water = 0;
+	//Rows left after the last cull, over every archetype
+	unsigned int visible = 0;
+};
+
+//Scene objects split by archetype, each archetype a set of packed component arrays indexed by row.
+//The frame runs as stages over whole arrays: update copies the world matrices out of the SceneGraph
+//and transforms the bounds, cull queries the mesh BVH and tests the other boxes at once, submit hands
+//the visible rows to the IndirectRenderer and the SpriteBatch. Nothing in the stages is called per
+//object through a vtable.
+//Rows are removed by moving the last row into the hole, so handles go through a location table
+class EntityStore
+{
+public:
+	//The material component is taken from the mesh's MaterialLibrary index and the bounds from the mesh
+	Entity createMesh(unsigned int node, Mesh& mesh);
+	Entity createSprite(unsigned int node, unsigned int texture, const glm::vec4& tint = glm::vec4(1, 1, 1, 1));
+	Entity createWater(unsigned int node, const WaterComponent& water, const AABB& bounds);
+	void destroy(Entity entity);
+	bool isAlive(Entity entity) const;
+	void setTint(Entity entity, const glm::vec4& tint);
+
+	//Resets every row to visible, so without a cull every row is submitted
+	void update();
+	//Rows outside the frustum, and the ones found hidden by the occlusion or Hi-Z culler, are skipped by the submits
+	void cull(FrustumCuller& culler, OcclusionCuller* occlusion = nullptr, HiZCuller* hiZ = nullptr);
+	void submitMeshes(IndirectRenderer& renderer) const;
+	//Draws the visible mesh rows one by one, for passes such as outlines that need their own shader
+	void drawMeshes(Window& window, Shader& shader) const;
+	void submitSprites(SpriteBatch& batch) const;
+	void drawWater(Window& window, Shader& shader) const;
+	//Same draw as the store's water rows, for a WaterBody drawn on its own
+	static void drawWater(Window& window, Shader& shader, const WaterComponent& water, const glm::mat4& model, const glm::mat4& normalMatrix);
+
+	const EntityStoreStats& getStats() const { return stats; }
+private:
+	struct Location
+	{
+		Archetype archetype;
+		unsigned int row;
+		unsigned int generation = 0;
+		bool alive = false;
+	};
+
+	//Transform, mesh and bounds, the mesh carries its material index. The proxy is the row's leaf in
+	//the mesh BVH
+	struct MeshRows
+	{
+		std::vector<Entity> entities;
+		std::vector<unsigned int> nodes;
+		std::vector<Mesh*> meshes;
+		std::vector<AABB> localBounds;
+		std::vector<glm::mat4> transforms;
+		std::vector<AABB> worldBounds;
+		std::vector<unsigned char> visible;
+		std::vector<unsigned int> proxies;
+	};
+
+	//Transform, sprite and bounds
+	struct SpriteRows
+	{
+		std::vector<Entity> entities;
+		std::vector<unsigned int> nodes;
+		std::vector<unsigned int> textures;
+		std::vector<glm::vec4> tints;
+		std::vector<AABB> localBounds;
+		std::vector<glm::mat4> transforms;
+		std::vector<AABB> worldBounds;
+		std::vector<unsigned char> visible;
+	};
+
+	//Transform, water and bounds
+	struct WaterRows
+	{
+		std::vector<Entity> entities;
+		std::vector<unsigned int> nodes;
+		std::vector<WaterComponent> water;
+		std::vector<AABB> localBounds;
+		std::vector<glm::mat4> transforms;
+		std::vector<glm::mat4> normalMatrices;
+		std::vector<AABB> worldBounds;
+		std::vector<unsigned char> visible;
+	};
+
+	Entity allocate(Archetype archetype, unsigned int row);
+	//Keeps the location of the row moved into the hole up to date
+	void moved(const Entity& entity, unsigned int row);
+	//Mesh rows are counted in the culler's stats, others pass no stats
+	void cullRows(FrustumCuller& culler, OcclusionCuller* occlusion, HiZCuller* hiZ, CullingStats* cullingStats, const std::vector<Entity>& entities, const std::vector<AABB>& bounds, std::vector<unsigned char>& visible);
+	//Hides the rows left by the frustum test that the occlusion or Hi-Z culler finds hidden, and counts them
+	void occludeRows(OcclusionCuller* occlusion, HiZCuller* hiZ, CullingStats* cullingStats, const std::vector<Entity>& entities, const std::vector<AABB>& bounds, std::vector<unsigned char>& visible);
+
+	std::vector<Location> locations;
+	std::vector<unsigned int> freeLocations;
+	//Hi-Z keys of meshes destroyed since the last cull
+	std::vector<const void*> destroyedMeshKeys;
+	MeshRows meshRows;
+	//World bounds of the mesh rows, the objects are entity locations. The frustum query goes through it
+	//so whole subtrees outside or inside are settled with one test
+	DynamicBvh meshBvh;
+	std::vector<unsigned int> meshesInFrustum;
+	SpriteRows spriteRows;
+	WaterRows waterRows;
+	EntityStoreStats stats;
+};
\ No newline at end of file
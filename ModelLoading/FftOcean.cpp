@@ -0,0 +1,377 @@
+#include "FftOcean.h"
+#include "JobSystem.h"
+#include <glad/glad.h>
+#include "SimdAvx.h"
+#include "SimdMath.h"
+#include <emmintrin.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <exception>
+
+namespace
+{
+	const float gravity = 9.81f;
+	const float pi = 3.14159265358979f;
+
+	//Adjacent columns go through the same butterflies, one lane each. This is the SSE version, the
+	//AVX one in SimdAvx runs eight lanes
+	typedef __m128 Lanes;
+	const unsigned int sseLanes = 4;
+	inline Lanes load(const float* p) { return _mm_loadu_ps(p); }
+	inline void store(float* p, Lanes v) { _mm_storeu_ps(p, v); }
+	inline Lanes broadcast(float f) { return _mm_set1_ps(f); }
+	inline Lanes add(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+	inline Lanes sub(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+	inline Lanes mul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+
+	//Copies a block row of four or eight floats
+	inline void copyLanes(const float* from, float* to, unsigned int lanes)
+	{
+		for (unsigned int lane = 0; lane < lanes; lane += 4)
+		{
+			_mm_storeu_ps(to + lane, _mm_loadu_ps(from + lane));
+		}
+	}
+
+	//Frequency of sample i, the upper half stands for the negative ones
+	inline int signedIndex(unsigned int i, unsigned int size)
+	{
+		return i < size / 2 ? (int)i : (int)i - (int)size;
+	}
+
+	//Inverse FFT of sseLanes sequences side by side, element e of lane l at e * sseLanes + l. Stockham
+	//passes, each halving the sub transform length n and doubling the stride s, ping pong between the
+	//first two and the last two buffers, real parts first. The result is left in the first two
+	void inverseFft(float* buffers[4], unsigned int size, const float* twiddleRe, const float* twiddleIm)
+	{
+		float* xRe = buffers[0];
+		float* xIm = buffers[1];
+		float* yRe = buffers[2];
+		float* yIm = buffers[3];
+		for (unsigned int n = size, s = 1; n > 1; n /= 2, s *= 2)
+		{
+			unsigned int half = n / 2;
+			unsigned int step = size / n;
+			for (unsigned int p = 0; p < half; ++p)
+			{
+				Lanes wRe = broadcast(twiddleRe[p * step]);
+				Lanes wIm = broadcast(twiddleIm[p * step]);
+				for (unsigned int q = 0; q < s; ++q)
+				{
+					unsigned int a = (q + s * p) * sseLanes;
+					unsigned int b = (q + s * (p + half)) * sseLanes;
+					unsigned int sum = (q + s * 2 * p) * sseLanes;
+					unsigned int difference = sum + s * sseLanes;
+					Lanes aRe = load(xRe + a);
+					Lanes aIm = load(xIm + a);
+					Lanes bRe = load(xRe + b);
+					Lanes bIm = load(xIm + b);
+					Lanes dRe = sub(aRe, bRe);
+					Lanes dIm = sub(aIm, bIm);
+					store(yRe + sum, add(aRe, bRe));
+					store(yIm + sum, add(aIm, bIm));
+					store(yRe + difference, sub(mul(dRe, wRe), mul(dIm, wIm)));
+					store(yIm + difference, add(mul(dRe, wIm), mul(dIm, wRe)));
+				}
+			}
+			std::swap(xRe, yRe);
+			std::swap(xIm, yIm);
+		}
+		buffers[0] = xRe;
+		buffers[1] = xIm;
+		buffers[2] = yRe;
+		buffers[3] = yIm;
+	}
+
+	double since(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+}
+
+FftOcean::FftOcean(const OceanSettings& settings, unsigned int threadCount)
+{
+	this->settings = settings;
+	size = settings.resolution;
+	if (size < 16 || (size & (size - 1)) != 0)
+	{
+		throw std::exception("Ocean resolution has to be a power of two from 16 up!");
+	}
+	if (threadCount == 0)
+	{
+		threadCount = JobSystem::get().getWorkerCount();
+	}
+	laneCount = simd::hasAvx2() ? 8 : 4;
+	this->threadCount = std::min(threadCount, size / laneCount);
+	//A power of two row length puts every sample of a column in the same few cache sets
+	stride = size + 16;
+
+	float windSpeed = glm::length(settings.wind);
+	glm::vec2 windDirection = windSpeed > 0 ? settings.wind / windSpeed : glm::vec2(1, 0);
+	//Largest wave the wind raises, and the ripples below a thousandth of it are damped away
+	float largest = windSpeed * windSpeed / gravity;
+	float smallest = largest / 1000.0f;
+	std::mt19937 random(settings.seed);
+	std::normal_distribution<float> gaussian;
+	startSpectrum.resize(size * size);
+	mirroredSpectrum.resize(size * size);
+	frequencies.resize(size * size);
+	for (unsigned int m = 0; m < size; ++m)
+	{
+		for (unsigned int n = 0; n < size; ++n)
+		{
+			unsigned int i = m * size + n;
+			glm::vec2 k = glm::vec2(signedIndex(n, size), signedIndex(m, size)) * (2 * pi / settings.patchSize);
+			float kLength = glm::length(k);
+			frequencies[i] = std::sqrt(gravity * kLength);
+			float phillips = 0;
+			//The Nyquist row and column have no mirror of opposite frequency, so they are left out
+			if (kLength > 1e-6f && m != size / 2 && n != size / 2)
+			{
+				float cosine = glm::dot(k / kLength, windDirection);
+				float kL = kLength * largest;
+				phillips = settings.amplitude * std::exp(-1.0f / (kL * kL)) / (kLength * kLength * kLength * kLength) * cosine * cosine * std::exp(-kLength * kLength * smallest * smallest);
+				//Waves running against the wind are mostly damped
+				if (cosine < 0)
+				{
+					phillips *= 0.07f;
+				}
+			}
+			float real = gaussian(random);
+			float imaginary = gaussian(random);
+			startSpectrum[i] = std::complex<float>(real, imaginary) * std::sqrt(phillips * 0.5f);
+		}
+	}
+	double variance = 0;
+	for (unsigned int m = 0; m < size; ++m)
+	{
+		for (unsigned int n = 0; n < size; ++n)
+		{
+			unsigned int i = m * size + n;
+			mirroredSpectrum[i] = std::conj(startSpectrum[((size - m) % size) * size + (size - n) % size]);
+			variance += std::norm(startSpectrum[i]) + std::norm(mirroredSpectrum[i]);
+		}
+	}
+	maxHeight = 4.0f * (float)std::sqrt(variance);
+
+	twiddleRe.resize(size / 2);
+	twiddleIm.resize(size / 2);
+	for (unsigned int j = 0; j < size / 2; ++j)
+	{
+		twiddleRe[j] = std::cos(2 * pi * j / size);
+		twiddleIm[j] = std::sin(2 * pi * j / size);
+	}
+	for (unsigned int f = 0; f < fieldCount; ++f)
+	{
+		fields[f].re.resize(size * stride);
+		fields[f].im.resize(size * stride);
+	}
+	displacements.resize(size * size);
+	normals.resize(size * size);
+}
+
+FftOcean::~FftOcean()
+{
+	//Never uploaded in the headless benchmark, where there is no context to delete from
+	if (displacementTexture)
+	{
+		glDeleteTextures(1, &displacementTexture);
+		glDeleteTextures(1, &normalTexture);
+	}
+}
+
+template<typename F>
+void FftOcean::runBands(unsigned int count, const F& function)
+{
+	//Bands share nothing, every job writes its own rows or columns
+	unsigned int bands = std::min(threadCount, count);
+	JobSystem& jobs = JobSystem::get();
+	JobCounter counter;
+	for (unsigned int i = 1; i < bands; ++i)
+	{
+		unsigned int first = count * i / bands;
+		unsigned int end = count * (i + 1) / bands;
+		jobs.run([&function, first, end]() { function(first, end); }, &counter);
+	}
+	function(0, count / bands);
+	jobs.wait(counter);
+}
+
+void FftOcean::simulate(float time)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	runBands(size, [this, time](unsigned int first, unsigned int end) { fillSpectrum(first, end, time); });
+	stats.spectrumMs = since(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	//Blocks of laneCount columns, then of laneCount rows, which leaves row z and column x
+	runBands(size / laneCount, [this](unsigned int first, unsigned int end)
+	{
+		std::vector<float> scratch;
+		for (unsigned int f = 0; f < fieldCount; ++f)
+		{
+			fftColumns(fields[f], first, end, scratch);
+		}
+	});
+	runBands(size / laneCount, [this](unsigned int first, unsigned int end)
+	{
+		std::vector<float> scratch;
+		for (unsigned int f = 0; f < fieldCount; ++f)
+		{
+			fftRows(fields[f], first, end, scratch);
+		}
+	});
+	stats.fftMs = since(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	runBands(size, [this](unsigned int first, unsigned int end) { pack(first, end); });
+	stats.packMs = since(start);
+}
+
+void FftOcean::fillSpectrum(unsigned int firstRow, unsigned int endRow, float time)
+{
+	float kStep = 2 * pi / settings.patchSize;
+	float choppiness = settings.choppiness;
+	for (unsigned int m = firstRow; m < endRow; ++m)
+	{
+		float kz = signedIndex(m, size) * kStep;
+		for (unsigned int n = 0; n < size; ++n)
+		{
+			unsigned int i = m * size + n;
+			unsigned int sample = m * stride + n;
+			float kx = signedIndex(n, size) * kStep;
+			float phase = frequencies[i] * time;
+			std::complex<float> turn(std::cos(phase), std::sin(phase));
+			std::complex<float> h = startSpectrum[i] * turn + mirroredSpectrum[i] * std::conj(turn);
+			float kLength = std::sqrt(kx * kx + kz * kz);
+			float sideways = kLength > 0 ? choppiness / kLength : 0;
+			//i k h for the slopes and -i k / |k| h for the sideways displacement
+			std::complex<float> slopeX(-kx * h.imag(), kx * h.real());
+			std::complex<float> slopeZ(-kz * h.imag(), kz * h.real());
+			std::complex<float> sidewaysX(kx * sideways * h.imag(), -kx * sideways * h.real());
+			std::complex<float> sidewaysZ(kz * sideways * h.imag(), -kz * sideways * h.real());
+			//Every output is real, so a second one rides along as the imaginary part
+			fields[0].re[sample] = h.real() - slopeX.imag();
+			fields[0].im[sample] = h.imag() + slopeX.real();
+			fields[1].re[sample] = slopeZ.real() - sidewaysX.imag();
+			fields[1].im[sample] = slopeZ.imag() + sidewaysX.real();
+			fields[2].re[sample] = sidewaysZ.real();
+			fields[2].im[sample] = sidewaysZ.imag();
+		}
+	}
+}
+
+void FftOcean::runInverseFft(float* buffers[4]) const
+{
+	if (laneCount == 8)
+	{
+		simd::avx::inverseFft(buffers, size, twiddleRe.data(), twiddleIm.data());
+	}
+	else
+	{
+		inverseFft(buffers, size, twiddleRe.data(), twiddleIm.data());
+	}
+}
+
+void FftOcean::fftColumns(ComplexField& field, unsigned int firstBlock, unsigned int endBlock, std::vector<float>& scratch) const
+{
+	//The block is copied out so the passes run on buffers that stay in L1
+	unsigned int blockFloats = size * laneCount;
+	scratch.resize(blockFloats * 4);
+	for (unsigned int block = firstBlock; block < endBlock; ++block)
+	{
+		unsigned int column = block * laneCount;
+		float* buffers[4] = { scratch.data(), scratch.data() + blockFloats, scratch.data() + blockFloats * 2, scratch.data() + blockFloats * 3 };
+		for (unsigned int row = 0; row < size; ++row)
+		{
+			copyLanes(&field.re[row * stride + column], buffers[0] + row * laneCount, laneCount);
+			copyLanes(&field.im[row * stride + column], buffers[1] + row * laneCount, laneCount);
+		}
+		runInverseFft(buffers);
+		for (unsigned int row = 0; row < size; ++row)
+		{
+			copyLanes(buffers[0] + row * laneCount, &field.re[row * stride + column], laneCount);
+			copyLanes(buffers[1] + row * laneCount, &field.im[row * stride + column], laneCount);
+		}
+	}
+}
+
+void FftOcean::fftRows(ComplexField& field, unsigned int firstBlock, unsigned int endBlock, std::vector<float>& scratch) const
+{
+	//Rows are interleaved into the block on the way in and out, the butterflies are the ones of the columns
+	unsigned int blockFloats = size * laneCount;
+	scratch.resize(blockFloats * 4);
+	for (unsigned int block = firstBlock; block < endBlock; ++block)
+	{
+		unsigned int firstRow = block * laneCount;
+		float* buffers[4] = { scratch.data(), scratch.data() + blockFloats, scratch.data() + blockFloats * 2, scratch.data() + blockFloats * 3 };
+		for (unsigned int lane = 0; lane < laneCount; ++lane)
+		{
+			const float* re = &field.re[(firstRow + lane) * stride];
+			const float* im = &field.im[(firstRow + lane) * stride];
+			for (unsigned int column = 0; column < size; ++column)
+			{
+				buffers[0][column * laneCount + lane] = re[column];
+				buffers[1][column * laneCount + lane] = im[column];
+			}
+		}
+		runInverseFft(buffers);
+		for (unsigned int lane = 0; lane < laneCount; ++lane)
+		{
+			float* re = &field.re[(firstRow + lane) * stride];
+			float* im = &field.im[(firstRow + lane) * stride];
+			for (unsigned int column = 0; column < size; ++column)
+			{
+				re[column] = buffers[0][column * laneCount + lane];
+				im[column] = buffers[1][column * laneCount + lane];
+			}
+		}
+	}
+}
+
+void FftOcean::pack(unsigned int firstRow, unsigned int endRow)
+{
+	for (unsigned int row = firstRow; row < endRow; ++row)
+	{
+		for (unsigned int column = 0; column < size; ++column)
+		{
+			unsigned int sample = row * stride + column;
+			float height = fields[0].re[sample];
+			float slopeX = fields[0].im[sample];
+			float slopeZ = fields[1].re[sample];
+			float sidewaysX = fields[1].im[sample];
+			float sidewaysZ = fields[2].re[sample];
+			unsigned int i = row * size + column;
+			displacements[i] = glm::vec4(sidewaysX, height, sidewaysZ, 0);
+			normals[i] = glm::vec4(glm::normalize(glm::vec3(-slopeX, 1, -slopeZ)), 0);
+		}
+	}
+}
+
+void FftOcean::upload()
+{
+	if (!displacementTexture)
+	{
+		unsigned int* textures[2] = { &displacementTexture, &normalTexture };
+		for (unsigned int* texture : textures)
+		{
+			glGenTextures(1, texture);
+			glBindTexture(GL_TEXTURE_2D, *texture);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, size, size, 0, GL_RGBA, GL_FLOAT, nullptr);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		}
+	}
+	//The coarse clipmap levels read the mipmaps, so the tile does not shimmer in the distance
+	glBindTexture(GL_TEXTURE_2D, displacementTexture);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, GL_RGBA, GL_FLOAT, displacements.data());
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, normalTexture);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, GL_RGBA, GL_FLOAT, normals.data());
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
\ No newline at end of file
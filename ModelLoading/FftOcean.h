@@ -0,0 +1,98 @@
+#pragma once
+#include <vector>
+#include <complex>
+#include <glm/glm.hpp>
+
+struct OceanSettings
+{
+	//Samples per side, a power of two from 16 up
+	unsigned int resolution = 256;
+	//Side of the simulated tile in meters, the surface repeats every tile
+	float patchSize = 16.0f;
+	//Meters per second, the waves run along it
+	glm::vec2 wind = glm::vec2(4.0f, 1.5f);
+	//Scale of the Phillips spectrum, the defaults make crests of about a third of a meter
+	float amplitude = 5e-4f;
+	//How far the crests are pulled together sideways, 0 for round crests
+	float choppiness = 1.2f;
+	unsigned int seed = 1;
+};
+
+struct OceanStats
+{
+	double spectrumMs = 0;
+	double fftMs = 0;
+	double packMs = 0;
+};
+
+//Tessendorf ocean simulated on the CPU. The starting spectrum is drawn once from the Phillips
+//spectrum, and every frame it is advanced to the given time and turned into heights, slopes and
+//sideways displacements by inverse 2D FFTs. The five real outputs are packed two to a complex
+//transform, so each frame runs three. The FFT is radix 2 Stockham, 4 columns or rows per SSE or 8
+//per AVX instruction when the CPU has AVX2, with each block of them copied into a scratch buffer that stays in L1. The
+//blocks are split into bands run as JobSystem jobs. simulate needs no GL context, upload copies
+//the result into a displacement and a normal texture on the GL thread
+class FftOcean
+{
+public:
+	//0 threads uses one band per JobSystem worker
+	FftOcean(const OceanSettings& settings = OceanSettings(), unsigned int threadCount = 0);
+	~FftOcean();
+	FftOcean(const FftOcean&) = delete;
+	FftOcean& operator=(const FftOcean&) = delete;
+
+	//Seconds
+	void simulate(float time);
+	//Creates the textures on the first call, then replaces their contents and mipmaps
+	void upload();
+
+	const OceanSettings& getSettings() const { return settings; }
+	//Sideways x, height and sideways z in meters, y up, row z and column x
+	const std::vector<glm::vec4>& getDisplacements() const { return displacements; }
+	//Surface normals in the same layout
+	const std::vector<glm::vec4>& getNormals() const { return normals; }
+	//Height the waves rarely pass, four standard deviations of the spectrum
+	float getMaxHeight() const { return maxHeight; }
+	unsigned int getDisplacementTexture() const { return displacementTexture; }
+	unsigned int getNormalTexture() const { return normalTexture; }
+	const OceanStats& getStats() const { return stats; }
+private:
+	//Real and imaginary parts apart, so a SIMD register holds one part of adjacent samples
+	struct ComplexField
+	{
+		std::vector<float> re;
+		std::vector<float> im;
+	};
+	static const unsigned int fieldCount = 3;
+
+	template<typename F>
+	void runBands(unsigned int count, const F& function);
+	void fillSpectrum(unsigned int firstRow, unsigned int endRow, float time);
+	void runInverseFft(float* buffers[4]) const;
+	void fftColumns(ComplexField& field, unsigned int firstBlock, unsigned int endBlock, std::vector<float>& scratch) const;
+	void fftRows(ComplexField& field, unsigned int firstBlock, unsigned int endBlock, std::vector<float>& scratch) const;
+	void pack(unsigned int firstRow, unsigned int endRow);
+
+	OceanSettings settings;
+	unsigned int size;
+	//Row length of the FFT fields, padded past size
+	unsigned int stride;
+	//Columns or rows per block, 8 when the AVX kernel is used
+	unsigned int laneCount;
+	unsigned int threadCount;
+	//h0(k) and the conjugate of h0(-k), row z frequency and column x frequency
+	std::vector<std::complex<float>> startSpectrum;
+	std::vector<std::complex<float>> mirroredSpectrum;
+	std::vector<float> frequencies;
+	//e^(2 pi i j / size) for j below size / 2
+	std::vector<float> twiddleRe;
+	std::vector<float> twiddleIm;
+	//Height + i slope x, slope z + i sideways x, sideways z
+	ComplexField fields[fieldCount];
+	std::vector<glm::vec4> displacements;
+	std::vector<glm::vec4> normals;
+	float maxHeight = 0;
+	unsigned int displacementTexture = 0;
+	unsigned int normalTexture = 0;
+	OceanStats stats;
+};
\ No newline at end of file
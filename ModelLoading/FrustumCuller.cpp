@@ -0,0 +1,164 @@
+#include "FrustumCuller.h"
+#include "SimdAvx.h"
+#include <emmintrin.h>
+#include <cmath>
+#include <algorithm>
+
+void FrustumCuller::setViewProjection(const glm::mat4& m)
+{
+	//Rows of the matrix, glm stores columns
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; ++i)
+	{
+		rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+	}
+	planes[0] = rows[3] + rows[0];
+	planes[1] = rows[3] - rows[0];
+	planes[2] = rows[3] + rows[1];
+	planes[3] = rows[3] - rows[1];
+	planes[4] = rows[3] + rows[2];
+	planes[5] = rows[3] - rows[2];
+	//Normalized so the plane distance can be compared with a radius
+	for (auto& plane : planes)
+	{
+		plane = plane / glm::length(glm::vec3(plane));
+	}
+}
+
+void FrustumCuller::cullSpheres(const glm::vec4* spheres, size_t count, unsigned char* visible) const
+{
+	size_t i = 0;
+	if (count >= 8 && simd::hasAvx2())
+	{
+		i = simd::avx::cullSpheres(&planes[0].x, &spheres[0].x, count, visible);
+	}
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(&spheres[i][0]), y = _mm_loadu_ps(&spheres[i + 1][0]), z = _mm_loadu_ps(&spheres[i + 2][0]), r = _mm_loadu_ps(&spheres[i + 3][0]);
+		_MM_TRANSPOSE4_PS(x, y, z, r);
+		__m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), r);
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (const glm::vec4& plane : planes)
+		{
+			__m128 distance = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_set1_ps(plane.w));
+			distance = _mm_add_ps(distance, _mm_mul_ps(y, _mm_set1_ps(plane.y)));
+			distance = _mm_add_ps(distance, _mm_mul_ps(z, _mm_set1_ps(plane.z)));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+		}
+		int mask = _mm_movemask_ps(inside);
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			visible[i + lane] = (mask >> lane) & 1;
+		}
+	}
+	for (; i < count; ++i)
+	{
+		visible[i] = isVisible(spheres[i]);
+	}
+}
+
+void FrustumCuller::cullBoxes(const AABB* boxes, size_t count, unsigned char* visible) const
+{
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		const AABB* b = boxes + i;
+		__m128 minX = _mm_set_ps(b[3].min.x, b[2].min.x, b[1].min.x, b[0].min.x);
+		__m128 minY = _mm_set_ps(b[3].min.y, b[2].min.y, b[1].min.y, b[0].min.y);
+		__m128 minZ = _mm_set_ps(b[3].min.z, b[2].min.z, b[1].min.z, b[0].min.z);
+		__m128 maxX = _mm_set_ps(b[3].max.x, b[2].max.x, b[1].max.x, b[0].max.x);
+		__m128 maxY = _mm_set_ps(b[3].max.y, b[2].max.y, b[1].max.y, b[0].max.y);
+		__m128 maxZ = _mm_set_ps(b[3].max.z, b[2].max.z, b[1].max.z, b[0].max.z);
+		__m128 centerX = _mm_mul_ps(_mm_add_ps(minX, maxX), half);
+		__m128 centerY = _mm_mul_ps(_mm_add_ps(minY, maxY), half);
+		__m128 centerZ = _mm_mul_ps(_mm_add_ps(minZ, maxZ), half);
+		__m128 extentX = _mm_mul_ps(_mm_sub_ps(maxX, minX), half);
+		__m128 extentY = _mm_mul_ps(_mm_sub_ps(maxY, minY), half);
+		__m128 extentZ = _mm_mul_ps(_mm_sub_ps(maxZ, minZ), half);
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (const glm::vec4& plane : planes)
+		{
+			//The box is outside when even its corner furthest along the normal is behind the plane
+			__m128 normalX = _mm_set1_ps(plane.x), normalY = _mm_set1_ps(plane.y), normalZ = _mm_set1_ps(plane.z);
+			__m128 distance = _mm_add_ps(_mm_mul_ps(centerX, normalX), _mm_set1_ps(plane.w));
+			distance = _mm_add_ps(distance, _mm_mul_ps(centerY, normalY));
+			distance = _mm_add_ps(distance, _mm_mul_ps(centerZ, normalZ));
+			__m128 reach = _mm_mul_ps(extentX, _mm_and_ps(normalX, absMask));
+			reach = _mm_add_ps(reach, _mm_mul_ps(extentY, _mm_and_ps(normalY, absMask)));
+			reach = _mm_add_ps(reach, _mm_mul_ps(extentZ, _mm_and_ps(normalZ, absMask)));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, reach), _mm_setzero_ps()));
+		}
+		int mask = _mm_movemask_ps(inside);
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			visible[i + lane] = (mask >> lane) & 1;
+		}
+	}
+	for (; i < count; ++i)
+	{
+		visible[i] = isVisible(boxes[i]);
+	}
+}
+
+bool FrustumCuller::isVisible(const glm::vec4& sphere) const
+{
+	for (const glm::vec4& plane : planes)
+	{
+		if (glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w < -sphere.w)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool FrustumCuller::isVisible(const AABB& box) const
+{
+	glm::vec3 center = (box.min + box.max) * 0.5f;
+	glm::vec3 extent = (box.max - box.min) * 0.5f;
+	for (const glm::vec4& plane : planes)
+	{
+		float reach = extent.x * std::fabs(plane.x) + extent.y * std::fabs(plane.y) + extent.z * std::fabs(plane.z);
+		if (glm::dot(glm::vec3(plane), center) + plane.w + reach < 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+FrustumTest FrustumCuller::classify(const AABB& box) const
+{
+	glm::vec3 center = (box.min + box.max) * 0.5f;
+	glm::vec3 extent = (box.max - box.min) * 0.5f;
+	FrustumTest result = FrustumTest::Inside;
+	for (const glm::vec4& plane : planes)
+	{
+		float reach = extent.x * std::fabs(plane.x) + extent.y * std::fabs(plane.y) + extent.z * std::fabs(plane.z);
+		float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+		if (distance + reach < 0)
+		{
+			return FrustumTest::Outside;
+		}
+		if (distance - reach < 0)
+		{
+			result = FrustumTest::Intersecting;
+		}
+	}
+	return result;
+}
+
+void FrustumCuller::endFrame()
+{
+	lastFrameStats = stats;
+	stats = CullingStats();
+}
+
+glm::vec4 FrustumCuller::transformSphere(const glm::mat4& model, const glm::vec4& sphere)
+{
+	glm::vec4 center = model * glm::vec4(glm::vec3(sphere), 1.0f);
+	float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+	return glm::vec4(glm::vec3(center), sphere.w * scale);
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <glm/glm.hpp>
+#include "SimdMath.h"
+
+enum class FrustumTest
+{
+	Outside,
+	Intersecting,
+	Inside
+};
+
+struct CullingStats
+{
+	unsigned int modelsVisible = 0;
+	unsigned int modelsCulled = 0;
+	unsigned int meshesVisible = 0;
+	unsigned int meshesCulled = 0;
+	//Inside the frustum but hidden behind the occluders of the OcclusionCuller
+	unsigned int meshesOccluded = 0;
+};
+
+//Six planes taken from a view projection matrix, normals pointing inside. The batch tests run
+//on four bounds per SSE instruction, spheres on eight when the CPU has AVX2.
+//Spheres are (center, radius) in a vec4, the same layout Mesh and Model keep them in
+class FrustumCuller
+{
+public:
+	void setViewProjection(const glm::mat4& viewProjection);
+	const glm::vec4& getPlane(unsigned int index) const { return planes[index]; }
+
+	//visible[i] is 1 when spheres[i] or boxes[i] is inside or crosses the frustum, 0 otherwise
+	void cullSpheres(const glm::vec4* spheres, size_t count, unsigned char* visible) const;
+	void cullBoxes(const AABB* boxes, size_t count, unsigned char* visible) const;
+	bool isVisible(const glm::vec4& sphere) const;
+	bool isVisible(const AABB& box) const;
+	//Also tells apart boxes fully inside, whose contents then need no further tests
+	FrustumTest classify(const AABB& box) const;
+
+	void setEnabled(bool enabled) { this->enabled = enabled; }
+	bool isEnabled() const { return enabled; }
+	//Filled by the draw paths during the frame, moved to the last frame stats by endFrame
+	CullingStats& getStats() { return stats; }
+	const CullingStats& getLastFrameStats() const { return lastFrameStats; }
+	void endFrame();
+
+	//Bounds of the transformed sphere, the radius grows by the largest axis scale
+	static glm::vec4 transformSphere(const glm::mat4& model, const glm::vec4& sphere);
+private:
+	//left, right, bottom, top, near, far
+	glm::vec4 planes[6];
+	bool enabled = true;
+	CullingStats stats;
+	CullingStats lastFrameStats;
+};
\ No newline at end of file
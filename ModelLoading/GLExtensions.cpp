@@ -0,0 +1,42 @@
+#include "GLExtensions.h"
+#include <GLFW/glfw3.h>
+
+#ifndef GL_VERSION_4_3
+PFNGLMULTIDRAWELEMENTSINDIRECTPROC glad_glMultiDrawElementsIndirect = nullptr;
+#endif
+#ifndef GL_VERSION_4_4
+PFNGLBUFFERSTORAGEPROC glad_glBufferStorage = nullptr;
+#endif
+#ifndef GL_ARB_bindless_texture
+PFNGLGETTEXTUREHANDLEARBPROC glad_glGetTextureHandleARB = nullptr;
+PFNGLMAKETEXTUREHANDLERESIDENTARBPROC glad_glMakeTextureHandleResidentARB = nullptr;
+PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC glad_glMakeTextureHandleNonResidentARB = nullptr;
+#endif
+
+int GLExtensions::majorVersion = 3;
+int GLExtensions::minorVersion = 3;
+bool GLExtensions::bufferStorage = false;
+bool GLExtensions::multiDrawIndirect = false;
+bool GLExtensions::bindlessTexture = false;
+
+void GLExtensions::load()
+{
+	glGetIntegerv(GL_MAJOR_VERSION, &majorVersion);
+	glGetIntegerv(GL_MINOR_VERSION, &minorVersion);
+
+#ifndef GL_VERSION_4_3
+	glad_glMultiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)glfwGetProcAddress("glMultiDrawElementsIndirect");
+#endif
+#ifndef GL_VERSION_4_4
+	glad_glBufferStorage = (PFNGLBUFFERSTORAGEPROC)glfwGetProcAddress("glBufferStorage");
+#endif
+#ifndef GL_ARB_bindless_texture
+	glad_glGetTextureHandleARB = (PFNGLGETTEXTUREHANDLEARBPROC)glfwGetProcAddress("glGetTextureHandleARB");
+	glad_glMakeTextureHandleResidentARB = (PFNGLMAKETEXTUREHANDLERESIDENTARBPROC)glfwGetProcAddress("glMakeTextureHandleResidentARB");
+	glad_glMakeTextureHandleNonResidentARB = (PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC)glfwGetProcAddress("glMakeTextureHandleNonResidentARB");
+#endif
+	bufferStorage = (hasVersion(4, 4) || glfwExtensionSupported("GL_ARB_buffer_storage")) && glBufferStorage != nullptr;
+	//Base instance in the indirect commands needs 4.2 on top of the multi draw extension
+	multiDrawIndirect = (hasVersion(4, 3) || (hasVersion(4, 2) && glfwExtensionSupported("GL_ARB_multi_draw_indirect"))) && glMultiDrawElementsIndirect != nullptr;
+	bindlessTexture = hasVersion(4, 0) && glfwExtensionSupported("GL_ARB_bindless_texture") && glGetTextureHandleARB != nullptr && glMakeTextureHandleResidentARB != nullptr;
+}
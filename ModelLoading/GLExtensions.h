@@ -0,0 +1,60 @@
+#pragma once
+#include <glad/glad.h>
+
+//glad is generated for 3.3 core only, entry points of newer versions are declared here
+//and loaded at runtime when the driver exposes them
+
+#ifndef GL_VERSION_4_0
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+#ifndef GL_VERSION_4_3
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+extern PFNGLMULTIDRAWELEMENTSINDIRECTPROC glad_glMultiDrawElementsIndirect;
+#define glMultiDrawElementsIndirect glad_glMultiDrawElementsIndirect
+#endif
+
+#ifndef GL_VERSION_4_4
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+extern PFNGLBUFFERSTORAGEPROC glad_glBufferStorage;
+#define glBufferStorage glad_glBufferStorage
+#endif
+
+#ifndef GL_ARB_bindless_texture
+typedef GLuint64 (APIENTRYP PFNGLGETTEXTUREHANDLEARBPROC)(GLuint texture);
+typedef void (APIENTRYP PFNGLMAKETEXTUREHANDLERESIDENTARBPROC)(GLuint64 handle);
+typedef void (APIENTRYP PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC)(GLuint64 handle);
+extern PFNGLGETTEXTUREHANDLEARBPROC glad_glGetTextureHandleARB;
+extern PFNGLMAKETEXTUREHANDLERESIDENTARBPROC glad_glMakeTextureHandleResidentARB;
+extern PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC glad_glMakeTextureHandleNonResidentARB;
+#define glGetTextureHandleARB glad_glGetTextureHandleARB
+#define glMakeTextureHandleResidentARB glad_glMakeTextureHandleResidentARB
+#define glMakeTextureHandleNonResidentARB glad_glMakeTextureHandleNonResidentARB
+#endif
+
+class GLExtensions
+{
+public:
+	//Called by the window once the context is current and glad is loaded
+	static void load();
+	static int getMajorVersion() { return majorVersion; }
+	static int getMinorVersion() { return minorVersion; }
+	static bool hasVersion(int major, int minor) { return majorVersion > major || (majorVersion == major && minorVersion >= minor); }
+
+	//glBufferStorage, needed for persistently mapped buffers
+	static bool hasBufferStorage() { return bufferStorage; }
+	//glMultiDrawElementsIndirect with base instance support
+	static bool hasMultiDrawIndirect() { return multiDrawIndirect; }
+	//ARB_bindless_texture, its shaders need GLSL 4.00 so a 4.0 context as well
+	static bool hasBindlessTexture() { return bindlessTexture; }
+private:
+	static int majorVersion;
+	static int minorVersion;
+	static bool bufferStorage;
+	static bool multiDrawIndirect;
+	static bool bindlessTexture;
+};
@@ -0,0 +1,131 @@
+#include "GeometryArena.h"
+#include <glad/glad.h>
+#include <cstddef>
+
+GeometryArena& GeometryArena::get()
+{
+	static GeometryArena arena;
+	return arena;
+}
+
+GeometryArena::GeometryArena()
+{
+	vertexCapacity = sizeof(VertexData) * 65536;
+	indexCapacity = sizeof(unsigned int) * 196608;
+	skinCapacity = sizeof(SkinVertex) * 65536;
+
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &VBO);
+	glGenBuffers(1, &EBO);
+	glGenBuffers(1, &skinVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, vertexCapacity, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ARRAY_BUFFER, indexCapacity, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, skinVBO);
+	glBufferData(GL_ARRAY_BUFFER, skinCapacity, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glBindVertexArray(VAO);
+	bindVertexFormat();
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GeometryArena::bindVertexFormat() const
+{
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+
+	glBindBuffer(GL_ARRAY_BUFFER, skinVBO);
+	glVertexAttribIPointer(boneIndexLocation, 4, GL_UNSIGNED_BYTE, sizeof(SkinVertex), (void*)offsetof(SkinVertex, bones));
+	glVertexAttribPointer(boneWeightLocation, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SkinVertex), (void*)offsetof(SkinVertex, weights));
+	glEnableVertexAttribArray(boneIndexLocation);
+	glEnableVertexAttribArray(boneWeightLocation);
+}
+
+void GeometryArena::grow(unsigned int& buffer, size_t& capacity, size_t used, size_t required)
+{
+	size_t newCapacity = capacity;
+	while (newCapacity < required)
+	{
+		newCapacity *= 2;
+	}
+	unsigned int newBuffer;
+	glGenBuffers(1, &newBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, newCapacity, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glDeleteBuffers(1, &buffer);
+	buffer = newBuffer;
+	capacity = newCapacity;
+}
+
+MeshRange GeometryArena::allocate(const std::vector<VertexData>& vertices, const std::vector<unsigned int>& indices, const std::vector<SkinVertex>& skin)
+{
+	size_t vertexBytes = sizeof(VertexData) * vertices.size();
+	size_t indexBytes = sizeof(unsigned int) * indices.size();
+	size_t skinBytes = sizeof(SkinVertex) * vertices.size();
+	size_t usedVertexBytes = sizeof(VertexData) * vertexCount;
+	size_t usedIndexBytes = sizeof(unsigned int) * indexCount;
+	size_t usedSkinBytes = sizeof(SkinVertex) * vertexCount;
+
+	bool rebind = false;
+	if (usedVertexBytes + vertexBytes > vertexCapacity)
+	{
+		grow(VBO, vertexCapacity, usedVertexBytes, usedVertexBytes + vertexBytes);
+		rebind = true;
+	}
+	if (usedIndexBytes + indexBytes > indexCapacity)
+	{
+		grow(EBO, indexCapacity, usedIndexBytes, usedIndexBytes + indexBytes);
+		rebind = true;
+	}
+	if (usedSkinBytes + skinBytes > skinCapacity)
+	{
+		grow(skinVBO, skinCapacity, usedSkinBytes, usedSkinBytes + skinBytes);
+		rebind = true;
+	}
+	if (rebind)
+	{
+		glBindVertexArray(VAO);
+		bindVertexFormat();
+		glBindVertexArray(0);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferSubData(GL_ARRAY_BUFFER, usedVertexBytes, vertexBytes, vertices.data());
+	glBindBuffer(GL_ARRAY_BUFFER, EBO);
+	glBufferSubData(GL_ARRAY_BUFFER, usedIndexBytes, indexBytes, indices.data());
+	glBindBuffer(GL_ARRAY_BUFFER, skinVBO);
+	if (skin.size() == vertices.size())
+	{
+		glBufferSubData(GL_ARRAY_BUFFER, usedSkinBytes, skinBytes, skin.data());
+	}
+	else
+	{
+		std::vector<SkinVertex> unskinned(vertices.size(), SkinVertex());
+		glBufferSubData(GL_ARRAY_BUFFER, usedSkinBytes, skinBytes, unskinned.data());
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	//Indices stay relative to the mesh, the base vertex moves them into place at draw time
+	MeshRange range;
+	range.firstIndex = indexCount;
+	range.indexCount = indices.size();
+	range.baseVertex = vertexCount;
+	vertexCount += vertices.size();
+	indexCount += indices.size();
+	return range;
+}
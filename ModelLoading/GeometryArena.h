@@ -0,0 +1,51 @@
+#pragma once
+#include "Helper.h"
+#include <vector>
+#include <cstddef>
+
+//Where a mesh lives inside the shared buffers
+struct MeshRange
+{
+	unsigned int firstIndex = 0;
+	unsigned int indexCount = 0;
+	int baseVertex = 0;
+};
+
+//One vertex and one index buffer shared by every mesh, so any set of meshes can be drawn
+//from a single VAO with base vertex draws or one multi draw indirect call. Bone influences sit in
+//a second vertex buffer at the same vertex offsets, read only by the skinning shader
+class GeometryArena
+{
+public:
+	static const unsigned int boneIndexLocation = 10;
+	static const unsigned int boneWeightLocation = 11;
+
+	//Created on first use, the GL context has to exist by then
+	static GeometryArena& get();
+
+	//Without skin data the mesh gets zero weights, which the skinning shader treats as the identity
+	MeshRange allocate(const std::vector<VertexData>& vertices, const std::vector<unsigned int>& indices, const std::vector<SkinVertex>& skin = std::vector<SkinVertex>());
+	unsigned int getVertexArray() const { return VAO; }
+	unsigned int getVertexBuffer() const { return VBO; }
+	unsigned int getIndexBuffer() const { return EBO; }
+	unsigned int getSkinBuffer() const { return skinVBO; }
+	//Binds the shared buffers and sets the vertex attributes on the currently bound VAO
+	void bindVertexFormat() const;
+private:
+	GeometryArena();
+	GeometryArena(const GeometryArena&) = delete;
+	GeometryArena& operator=(const GeometryArena&) = delete;
+
+	//Doubles the buffer until the data fits, copying the used part over on the GPU
+	void grow(unsigned int& buffer, size_t& capacity, size_t used, size_t required);
+
+	unsigned int VAO;
+	unsigned int VBO;
+	unsigned int EBO;
+	unsigned int skinVBO;
+	size_t vertexCapacity;
+	size_t skinCapacity;
+	size_t indexCapacity;
+	size_t vertexCount = 0;
+	size_t indexCount = 0;
+};
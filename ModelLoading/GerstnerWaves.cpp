@@ -0,0 +1,185 @@
+#include "GerstnerWaves.h"
+#include <emmintrin.h>
+#include <algorithm>
+#include <cmath>
+#include <exception>
+
+namespace
+{
+	const float gravity = 9.81f;
+	const float pi = 3.14159265358979f;
+	const float twoPi = 6.28318530718f;
+	//Fixed point steps undoing the sideways motion, three bring the height within a fraction of a millimeter
+	const unsigned int inversionSteps = 3;
+
+	//Sine and cosine of four angles, good to about 1e-7 for angles of a few hundred radians
+	inline void sinCos(__m128 angle, __m128& sine, __m128& cosine)
+	{
+		//Whole turns come off in two parts so the small remainder keeps its precision
+		__m128 turns = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(angle, _mm_set1_ps(1.0f / twoPi))));
+		__m128 x = _mm_sub_ps(angle, _mm_mul_ps(turns, _mm_set1_ps(6.28125f)));
+		x = _mm_sub_ps(x, _mm_mul_ps(turns, _mm_set1_ps(1.9353071795864769e-3f)));
+		//Past a quarter turn either way the angle is mirrored about it, which keeps the sine and flips the cosine
+		__m128 upper = _mm_cmpgt_ps(x, _mm_set1_ps(pi / 2));
+		__m128 lower = _mm_cmplt_ps(x, _mm_set1_ps(-pi / 2));
+		__m128 folded = _mm_or_ps(upper, lower);
+		__m128 mirror = _mm_or_ps(_mm_and_ps(upper, _mm_set1_ps(pi)), _mm_and_ps(lower, _mm_set1_ps(-pi)));
+		x = _mm_or_ps(_mm_and_ps(folded, _mm_sub_ps(mirror, x)), _mm_andnot_ps(folded, x));
+		__m128 x2 = _mm_mul_ps(x, x);
+
+		__m128 s = _mm_set1_ps(-1.0f / 39916800.0f);
+		s = _mm_add_ps(_mm_mul_ps(s, x2), _mm_set1_ps(1.0f / 362880.0f));
+		s = _mm_add_ps(_mm_mul_ps(s, x2), _mm_set1_ps(-1.0f / 5040.0f));
+		s = _mm_add_ps(_mm_mul_ps(s, x2), _mm_set1_ps(1.0f / 120.0f));
+		s = _mm_add_ps(_mm_mul_ps(s, x2), _mm_set1_ps(-1.0f / 6.0f));
+		s = _mm_add_ps(_mm_mul_ps(s, x2), _mm_set1_ps(1.0f));
+		sine = _mm_mul_ps(s, x);
+
+		__m128 c = _mm_set1_ps(1.0f / 479001600.0f);
+		c = _mm_add_ps(_mm_mul_ps(c, x2), _mm_set1_ps(-1.0f / 3628800.0f));
+		c = _mm_add_ps(_mm_mul_ps(c, x2), _mm_set1_ps(1.0f / 40320.0f));
+		c = _mm_add_ps(_mm_mul_ps(c, x2), _mm_set1_ps(-1.0f / 720.0f));
+		c = _mm_add_ps(_mm_mul_ps(c, x2), _mm_set1_ps(1.0f / 24.0f));
+		c = _mm_add_ps(_mm_mul_ps(c, x2), _mm_set1_ps(-0.5f));
+		c = _mm_add_ps(_mm_mul_ps(c, x2), _mm_set1_ps(1.0f));
+		cosine = _mm_xor_ps(c, _mm_and_ps(folded, _mm_set1_ps(-0.0f)));
+	}
+}
+
+void GerstnerWaves::addWave(const GerstnerWave& wave)
+{
+	if (waves.size() == WaveData::maxWaves)
+	{
+		throw std::exception("Too many Gerstner waves");
+	}
+	waves.push_back(wave);
+	float length = glm::length(wave.direction);
+	waves.back().direction = length > 0 ? wave.direction / length : glm::vec2(1.0f, 0.0f);
+	updateData();
+}
+
+void GerstnerWaves::clear()
+{
+	waves.clear();
+	updateData();
+}
+
+float GerstnerWaves::getMaxHeight() const
+{
+	float height = 0;
+	for (const GerstnerWave& wave : waves)
+	{
+		height += wave.amplitude;
+	}
+	return height;
+}
+
+void GerstnerWaves::updateData()
+{
+	data.count = waves.size();
+	for (unsigned int i = 0; i < waves.size(); ++i)
+	{
+		float waveNumber = twoPi / waves[i].wavelength;
+		data.shape[i] = glm::vec4(waves[i].direction.x, waves[i].direction.y, waveNumber, std::sqrt(gravity * waveNumber));
+		//With every wave at full steepness the slopes of the sideways motion add up to one, where the crests turn to points
+		data.size[i] = glm::vec4(waves[i].amplitude, waves[i].steepness / (waveNumber * waves.size()), 0.0f, 0.0f);
+	}
+}
+
+void GerstnerWaves::sample(const float* x, const float* z, size_t count, float time, float* heights, glm::vec3* normals) const
+{
+	//The time part of each phase is taken off whole turns in double, so it stays small however long the game runs
+	float phases[WaveData::maxWaves];
+	for (int i = 0; i < data.count; ++i)
+	{
+		phases[i] = (float)std::fmod((double)data.shape[i].w * time, (double)twoPi);
+	}
+	for (size_t first = 0; first < count; first += 4)
+	{
+		//The last points are padded to a full register
+		unsigned int lanes = (unsigned int)std::min<size_t>(4, count - first);
+		float blockX[4] = {};
+		float blockZ[4] = {};
+		std::copy(x + first, x + first + lanes, blockX);
+		std::copy(z + first, z + first + lanes, blockZ);
+		__m128 pointX = _mm_loadu_ps(blockX);
+		__m128 pointZ = _mm_loadu_ps(blockZ);
+
+		//Finds where the water over the point started from, moved by the waves at where it is thought to be
+		__m128 restX = pointX;
+		__m128 restZ = pointZ;
+		__m128 sine;
+		__m128 cosine;
+		for (unsigned int step = 0; step < inversionSteps; ++step)
+		{
+			__m128 movedX = _mm_setzero_ps();
+			__m128 movedZ = _mm_setzero_ps();
+			for (int i = 0; i < data.count; ++i)
+			{
+				__m128 directionX = _mm_set1_ps(data.shape[i].x);
+				__m128 directionZ = _mm_set1_ps(data.shape[i].y);
+				__m128 along = _mm_add_ps(_mm_mul_ps(directionX, restX), _mm_mul_ps(directionZ, restZ));
+				sinCos(_mm_sub_ps(_mm_mul_ps(along, _mm_set1_ps(data.shape[i].z)), _mm_set1_ps(phases[i])), sine, cosine);
+				__m128 sideways = _mm_mul_ps(cosine, _mm_set1_ps(data.size[i].y));
+				movedX = _mm_add_ps(movedX, _mm_mul_ps(sideways, directionX));
+				movedZ = _mm_add_ps(movedZ, _mm_mul_ps(sideways, directionZ));
+			}
+			restX = _mm_sub_ps(pointX, movedX);
+			restZ = _mm_sub_ps(pointZ, movedZ);
+		}
+
+		//Tangents along x and z are (1 - bunchXX, slopeX, -bunchXZ) and (-bunchXZ, slopeZ, 1 - bunchZZ)
+		__m128 height = _mm_setzero_ps();
+		__m128 slopeX = _mm_setzero_ps();
+		__m128 slopeZ = _mm_setzero_ps();
+		__m128 bunchXX = _mm_setzero_ps();
+		__m128 bunchXZ = _mm_setzero_ps();
+		__m128 bunchZZ = _mm_setzero_ps();
+		for (int i = 0; i < data.count; ++i)
+		{
+			__m128 directionX = _mm_set1_ps(data.shape[i].x);
+			__m128 directionZ = _mm_set1_ps(data.shape[i].y);
+			__m128 along = _mm_add_ps(_mm_mul_ps(directionX, restX), _mm_mul_ps(directionZ, restZ));
+			sinCos(_mm_sub_ps(_mm_mul_ps(along, _mm_set1_ps(data.shape[i].z)), _mm_set1_ps(phases[i])), sine, cosine);
+			height = _mm_add_ps(height, _mm_mul_ps(sine, _mm_set1_ps(data.size[i].x)));
+			__m128 slope = _mm_mul_ps(cosine, _mm_set1_ps(data.shape[i].z * data.size[i].x));
+			slopeX = _mm_add_ps(slopeX, _mm_mul_ps(slope, directionX));
+			slopeZ = _mm_add_ps(slopeZ, _mm_mul_ps(slope, directionZ));
+			__m128 bunch = _mm_mul_ps(sine, _mm_set1_ps(data.shape[i].z * data.size[i].y));
+			bunchXX = _mm_add_ps(bunchXX, _mm_mul_ps(bunch, _mm_mul_ps(directionX, directionX)));
+			bunchXZ = _mm_add_ps(bunchXZ, _mm_mul_ps(bunch, _mm_mul_ps(directionX, directionZ)));
+			bunchZZ = _mm_add_ps(bunchZZ, _mm_mul_ps(bunch, _mm_mul_ps(directionZ, directionZ)));
+		}
+		//Cross product of the z tangent with the x tangent
+		__m128 stretchX = _mm_sub_ps(_mm_set1_ps(1.0f), bunchXX);
+		__m128 stretchZ = _mm_sub_ps(_mm_set1_ps(1.0f), bunchZZ);
+		__m128 normalX = _mm_sub_ps(_mm_setzero_ps(), _mm_add_ps(_mm_mul_ps(bunchXZ, slopeZ), _mm_mul_ps(stretchZ, slopeX)));
+		__m128 normalY = _mm_sub_ps(_mm_mul_ps(stretchX, stretchZ), _mm_mul_ps(bunchXZ, bunchXZ));
+		__m128 normalZ = _mm_sub_ps(_mm_setzero_ps(), _mm_add_ps(_mm_mul_ps(bunchXZ, slopeX), _mm_mul_ps(stretchX, slopeZ)));
+		float blockHeights[4];
+		_mm_storeu_ps(blockHeights, height);
+		std::copy(blockHeights, blockHeights + lanes, heights + first);
+		if (normals)
+		{
+			__m128 inverseLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX, normalX), _mm_mul_ps(normalY, normalY)), _mm_mul_ps(normalZ, normalZ))));
+			float blockNormals[3][4];
+			_mm_storeu_ps(blockNormals[0], _mm_mul_ps(normalX, inverseLength));
+			_mm_storeu_ps(blockNormals[1], _mm_mul_ps(normalY, inverseLength));
+			_mm_storeu_ps(blockNormals[2], _mm_mul_ps(normalZ, inverseLength));
+			for (unsigned int lane = 0; lane < lanes; ++lane)
+			{
+				normals[first + lane] = glm::vec3(blockNormals[0][lane], blockNormals[1][lane], blockNormals[2][lane]);
+			}
+		}
+	}
+}
+
+GerstnerWaves GerstnerWaves::makeDefault()
+{
+	GerstnerWaves waves;
+	waves.addWave({ glm::vec2(1.0f, 0.3f), 7.0f, 0.07f, 0.6f });
+	waves.addWave({ glm::vec2(0.7f, 1.0f), 3.3f, 0.04f, 0.6f });
+	waves.addWave({ glm::vec2(-0.4f, 1.0f), 1.7f, 0.02f, 0.5f });
+	waves.addWave({ glm::vec2(1.0f, -0.8f), 0.9f, 0.01f, 0.5f });
+	return waves;
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+#include "UniformBlocks.h"
+
+struct GerstnerWave
+{
+	//Way the crests travel, normalized when the wave is added
+	glm::vec2 direction = glm::vec2(1.0f, 0.0f);
+	//Meters from crest to crest
+	float wavelength = 4.0f;
+	//Meters from rest up to a crest
+	float amplitude = 0.05f;
+	//0 for a sine wave, 1 for the sharpest crests the whole set can have before the surface folds
+	float steepness = 0.5f;
+};
+
+//A sum of Gerstner waves, each moving the water round in circles so it bunches up under the crests.
+//Each wave travels at the deep water speed for its wavelength. The water shader sums the same
+//waves from a WaveData block, and sample sums them on the CPU so gameplay code sees the surface
+//that is drawn. sample runs four points per SSE instruction with polynomial sines, and undoes the
+//sideways motion first so the height returned is the surface over the point asked for, not the
+//height of the water that started there
+class GerstnerWaves
+{
+public:
+	//Throws when the set already has WaveData::maxWaves waves
+	void addWave(const GerstnerWave& wave);
+	void clear();
+
+	const std::vector<GerstnerWave>& getWaves() const { return waves; }
+	const WaveData& getData() const { return data; }
+	//Meters the surface can rise or fall from rest
+	float getMaxHeight() const;
+	//Heights above rest and unit normals, y up, at horizontal positions x and z in meters and time
+	//in seconds. normals may be null
+	void sample(const float* x, const float* z, size_t count, float time, float* heights, glm::vec3* normals) const;
+
+	//A long swell with shorter waves across it, crests of about 15 centimeters
+	static GerstnerWaves makeDefault();
+private:
+	//Sideways amplitudes depend on the number of waves, so they are redone whenever one is added
+	void updateData();
+
+	std::vector<GerstnerWave> waves;
+	WaveData data;
+};
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include "GpuRingBuffer.h"
+#include "GLExtensions.h"
+#include <algorithm>
+#include <stdexcept>
+
+size_t GpuRingBuffer::uniformAlignment = 0;
+
+GpuRingBuffer::GpuRingBuffer(size_t regionSize, unsigned int regionCount)
+{
+	if (uniformAlignment == 0)
+	{
+		GLint alignment = 256;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		uniformAlignment = alignment;
+	}
+	this->regionSize = regionSize;
+	this->regionCount = regionCount;
+	fences.resize(regionCount, 0);
+	persistent = GLExtensions::hasBufferStorage();
+
+	size_t size = regionSize * regionCount;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	if (persistent)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+		mapped = (char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+	}
+	else
+	{
+		glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+		staging.resize(size);
+		mapped = staging.data();
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+GpuRingBuffer::~GpuRingBuffer()
+{
+	for (GLsync fence : fences)
+	{
+		if (fence)
+		{
+			glDeleteSync(fence);
+		}
+	}
+	if (persistent)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	glDeleteBuffers(1, &buffer);
+}
+
+void GpuRingBuffer::waitRegion(unsigned int index)
+{
+	if (!fences[index])
+	{
+		return;
+	}
+	GLenum result = glClientWaitSync(fences[index], 0, 0);
+	if (result == GL_TIMEOUT_EXPIRED)
+	{
+		++stats.stalls;
+		while (result == GL_TIMEOUT_EXPIRED)
+		{
+			result = glClientWaitSync(fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		}
+	}
+	glDeleteSync(fences[index]);
+	fences[index] = 0;
+}
+
+void GpuRingBuffer::fenceRegion(unsigned int index)
+{
+	if (fences[index])
+	{
+		glDeleteSync(fences[index]);
+	}
+	fences[index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void GpuRingBuffer::beginFrame()
+{
+	region = (region + 1) % regionCount;
+	++regionChanges;
+	waitRegion(region);
+	head = 0;
+	flushed = 0;
+	stats.bytesThisFrame = 0;
+}
+
+void GpuRingBuffer::endFrame()
+{
+	flush();
+	fenceRegion(region);
+	stats.peakBytesPerFrame = std::max(stats.peakBytesPerFrame, stats.bytesThisFrame);
+}
+
+RingAllocation GpuRingBuffer::allocate(size_t size, size_t alignment)
+{
+	if (size > regionSize)
+	{
+		throw std::length_error("Ring buffer allocation larger than a region!");
+	}
+	size_t start = (head + alignment - 1) / alignment * alignment;
+	if (start + size > regionSize)
+	{
+		//The frame outgrew its region, whatever was already drawn from it is fenced and the next one is taken early
+		++stats.earlyWraps;
+		flush();
+		fenceRegion(region);
+		region = (region + 1) % regionCount;
+		++regionChanges;
+		waitRegion(region);
+		start = 0;
+		flushed = 0;
+	}
+	head = start + size;
+	stats.bytesThisFrame += size;
+
+	RingAllocation allocation;
+	allocation.offset = region * regionSize + start;
+	allocation.data = mapped + allocation.offset;
+	allocation.size = size;
+	return allocation;
+}
+
+void GpuRingBuffer::flush()
+{
+	if (persistent || flushed >= head)
+	{
+		return;
+	}
+	size_t offset = region * regionSize + flushed;
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, offset, head - flushed, staging.data() + offset);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	flushed = head;
+}
+
+void GpuRingBuffer::bindRange(GLenum target, unsigned int binding, const RingAllocation& allocation)
+{
+	flush();
+	glBindBufferRange(target, binding, buffer, allocation.offset, allocation.size);
+}
+
+void GpuRingBuffer::resetStats()
+{
+	stats = GpuRingBufferStats();
+}
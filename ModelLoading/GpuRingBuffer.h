@@ -0,0 +1,81 @@
+#pragma once
+#include <glad/glad.h>
+#include <vector>
+#include <cstddef>
+#include <cstring>
+
+struct RingAllocation
+{
+	void* data = nullptr;
+	//Offset from the start of the buffer, used when binding the range
+	size_t offset = 0;
+	size_t size = 0;
+};
+
+struct GpuRingBufferStats
+{
+	//Times the CPU waited for the GPU to finish with a region
+	unsigned int stalls = 0;
+	//Times a frame ran out of room and moved into the next region before its end
+	unsigned int earlyWraps = 0;
+	size_t bytesThisFrame = 0;
+	size_t peakBytesPerFrame = 0;
+};
+
+//Buffer split into per frame regions that the CPU fills with plain memcpy while the GPU reads the
+//previous ones. Each region is fenced at the end of its frame and waited on before it is reused.
+//With buffer storage the whole buffer stays persistently mapped, otherwise the data is staged on
+//the CPU and sent with glBufferSubData right before it is bound
+class GpuRingBuffer
+{
+public:
+	GpuRingBuffer(size_t regionSize, unsigned int regionCount = 3);
+	~GpuRingBuffer();
+	GpuRingBuffer(const GpuRingBuffer&) = delete;
+	GpuRingBuffer& operator=(const GpuRingBuffer&) = delete;
+
+	void beginFrame();
+	void endFrame();
+
+	RingAllocation allocate(size_t size, size_t alignment);
+	//Aligned to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT so the allocation can be bound as a uniform block
+	RingAllocation allocateUniform(size_t size) { return allocate(size, uniformAlignment); }
+	//Copies the value in and binds it to the uniform block binding point
+	template<typename T>
+	void bindUniform(unsigned int binding, const T& value)
+	{
+		RingAllocation allocation = allocateUniform(sizeof(T));
+		memcpy(allocation.data, &value, sizeof(T));
+		bindRange(GL_UNIFORM_BUFFER, binding, allocation);
+	}
+	void bindRange(GLenum target, unsigned int binding, const RingAllocation& allocation);
+	//Makes everything allocated so far visible to the GPU, only does work without persistent mapping
+	void flush();
+
+	//Counts every move to another region, at the start of a frame or when one ran out of room.
+	//An allocation kept across a change is in a region that is fenced and will be reused
+	unsigned int getRegionChanges() const { return regionChanges; }
+	unsigned int getBuffer() const { return buffer; }
+	bool isPersistent() const { return persistent; }
+	const GpuRingBufferStats& getStats() const { return stats; }
+	void resetStats();
+	static size_t getUniformAlignment() { return uniformAlignment; }
+private:
+	void waitRegion(unsigned int index);
+	void fenceRegion(unsigned int index);
+
+	unsigned int buffer;
+	size_t regionSize;
+	unsigned int regionCount;
+	unsigned int region = 0;
+	unsigned int regionChanges = 0;
+	size_t head = 0;
+	size_t flushed = 0;
+	bool persistent;
+	char* mapped = nullptr;
+	std::vector<char> staging;
+	std::vector<GLsync> fences;
+	GpuRingBufferStats stats;
+
+	static size_t uniformAlignment;
+};
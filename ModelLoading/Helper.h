@@ -1,5 +1,6 @@
 #pragma once
 #include <assimp/scene.h>
+#include <string>
 struct VertexData
 {
 	float vertX;
@@ -19,4 +20,13 @@ struct Texture
 	aiTextureType type;
 	int id;
 	int index;
+	std::string path;
+};
+
+//Four bone influences of a vertex, streamed next to VertexData. The weights are normalized bytes
+//summing to 255, all zero for meshes that are not skinned
+struct SkinVertex
+{
+	unsigned char bones[4];
+	unsigned char weights[4];
 };
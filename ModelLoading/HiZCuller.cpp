@@ -0,0 +1,388 @@
+#include "HiZCuller.h"
+#include "Shader.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstring>
+
+namespace
+{
+	//Full screen triangle from the vertex id, drawn without any vertex buffer
+	const char* fullScreenVertexS = R"(
+#version 330 core
+void main()
+{
+	vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+	//Each texel keeps the farthest of the two by two texels under it, an odd last row or column is
+	//read twice through the clamp so texel i of any level covers texels i << level to the next of level 0
+	const char* reduceFragmentS = R"(
+#version 330 core
+uniform sampler2D source;
+uniform ivec2 sourceSize;
+out vec4 FragColor;
+void main()
+{
+	ivec2 texel = ivec2(gl_FragCoord.xy) * 2;
+	ivec2 last = sourceSize - 1;
+	float depth = texelFetch(source, texel, 0).r;
+	depth = max(depth, texelFetch(source, min(texel + ivec2(1, 0), last), 0).r);
+	depth = max(depth, texelFetch(source, min(texel + ivec2(0, 1), last), 0).r);
+	depth = max(depth, texelFetch(source, min(texel + ivec2(1, 1), last), 0).r);
+	FragColor = vec4(depth, 0.0, 0.0, 1.0);
+}
+)";
+
+	//One point per box, written to the texel of its index in the result texture
+	const char* testVertexS = R"(
+#version 330 core
+layout (location = 0) in vec3 boxMin;
+layout (location = 1) in vec3 boxMax;
+uniform mat4 viewProjection;
+uniform sampler2D pyramid;
+//Size of the source depth texture over two, the scale of level 0
+uniform vec2 levelZeroSize;
+uniform int maxLevel;
+uniform ivec2 resultSize;
+flat out float visible;
+
+float testBox()
+{
+	vec3 rectMin = vec3(1e30);
+	vec3 rectMax = vec3(-1e30);
+	for (int i = 0; i < 8; ++i)
+	{
+		vec3 corner = mix(boxMin, boxMax, vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1));
+		vec4 clip = viewProjection * vec4(corner, 1.0);
+		if (clip.w < 0.0001)
+		{
+			return 1.0;
+		}
+		vec3 window = clip.xyz / clip.w * 0.5 + 0.5;
+		rectMin = min(rectMin, window);
+		rectMax = max(rectMax, window);
+	}
+	if (any(greaterThan(rectMin.xy, vec2(1.0))) || any(lessThan(rectMax.xy, vec2(0.0))))
+	{
+		return 1.0;
+	}
+	ivec2 last = ivec2(levelZeroSize) - 1;
+	ivec2 first = clamp(ivec2(rectMin.xy * levelZeroSize), ivec2(0), last);
+	ivec2 end = clamp(ivec2(rectMax.xy * levelZeroSize), ivec2(0), last);
+	//The smallest level where the rectangle spans at most two texels on each side
+	ivec2 span = end - first + 1;
+	int level = min(int(ceil(log2(float(max(span.x, span.y))))), maxLevel);
+	first >>= level;
+	end >>= level;
+	float depth = max(max(texelFetch(pyramid, first, level).r, texelFetch(pyramid, ivec2(end.x, first.y), level).r),
+		max(texelFetch(pyramid, ivec2(first.x, end.y), level).r, texelFetch(pyramid, end, level).r));
+	return rectMin.z <= depth ? 1.0 : 0.0;
+}
+
+void main()
+{
+	visible = testBox();
+	vec2 texel = vec2(gl_VertexID % resultSize.x, gl_VertexID / resultSize.x) + 0.5;
+	gl_Position = vec4(texel / vec2(resultSize) * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+	const char* testFragmentS = R"(
+#version 330 core
+flat in float visible;
+out vec4 FragColor;
+void main()
+{
+	FragColor = vec4(visible, 0.0, 0.0, 1.0);
+}
+)";
+}
+
+HiZCuller::HiZCuller(unsigned int width, unsigned int height)
+{
+	glm::uvec2 size((width + 1) / 2, (height + 1) / 2);
+	levelSizes.push_back(size);
+	while (size.x > 1 || size.y > 1)
+	{
+		size = glm::uvec2((size.x + 1) / 2, (size.y + 1) / 2);
+		levelSizes.push_back(size);
+	}
+	stats.pyramidLevels = levelSizes.size();
+
+	glGenTextures(1, &pyramid);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, pyramid);
+	for (unsigned int i = 0; i < levelSizes.size(); ++i)
+	{
+		glTexImage2D(GL_TEXTURE_2D, i, GL_R32F, levelSizes[i].x, levelSizes[i].y, 0, GL_RED, GL_FLOAT, 0);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelSizes.size() - 1);
+	glGenFramebuffers(1, &pyramidFbo);
+	glGenVertexArrays(1, &emptyVAO);
+	reduceShader.reset(new Shader(fullScreenVertexS, reduceFragmentS));
+
+	glGenTextures(1, &resultTexture);
+	glBindTexture(GL_TEXTURE_2D, resultTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glGenFramebuffers(1, &resultFbo);
+	testShader.reset(new Shader(testVertexS, testFragmentS));
+
+	glGenVertexArrays(1, &boxVAO);
+	glGenBuffers(1, &boxBuffer);
+	glBindVertexArray(boxVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, boxBuffer);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(AABB), (void*)offsetof(AABB, min));
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(AABB), (void*)offsetof(AABB, max));
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	for (auto& readback : readbacks)
+	{
+		glGenBuffers(1, &readback.buffer);
+	}
+}
+
+HiZCuller::~HiZCuller()
+{
+	for (auto& readback : readbacks)
+	{
+		if (readback.fence)
+		{
+			glDeleteSync(readback.fence);
+		}
+		glDeleteBuffers(1, &readback.buffer);
+	}
+	glDeleteBuffers(1, &boxBuffer);
+	glDeleteVertexArrays(1, &boxVAO);
+	glDeleteVertexArrays(1, &emptyVAO);
+	glDeleteFramebuffers(1, &resultFbo);
+	glDeleteFramebuffers(1, &pyramidFbo);
+	glDeleteTextures(1, &resultTexture);
+	glDeleteTextures(1, &pyramid);
+}
+
+void HiZCuller::beginFrame()
+{
+	++frame;
+	//Oldest first, so a newer result overwrites an older one finished at the same time
+	for (unsigned int i = 0; i < readbackCount; ++i)
+	{
+		Readback& readback = readbacks[(nextReadback + i) % readbackCount];
+		if (!readback.fence)
+		{
+			continue;
+		}
+		GLenum result = glClientWaitSync(readback.fence, 0, 0);
+		if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+		{
+			continue;
+		}
+		glDeleteSync(readback.fence);
+		readback.fence = 0;
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+		const unsigned char* results = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, readback.objects, GL_MAP_READ_BIT);
+		if (results)
+		{
+			stats.hidden = 0;
+			for (unsigned int slot = 0; slot < readback.objects; ++slot)
+			{
+				if (readback.test < firstTests[slot])
+				{
+					continue;
+				}
+				visible[slot] = results[slot] != 0;
+				testedBoxes[slot] = readback.boxes[slot];
+				stats.hidden += !visible[slot];
+			}
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			stats.latency = frame - readback.frame;
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+	stats.pendingReadbacks = 0;
+	for (auto& readback : readbacks)
+	{
+		stats.pendingReadbacks += readback.fence != 0;
+	}
+}
+
+bool HiZCuller::isVisible(const void* key, const AABB& box)
+{
+	auto found = slots.find(key);
+	if (found == slots.end())
+	{
+		unsigned int slot = boxes.size();
+		if (freeSlots.empty())
+		{
+			boxes.push_back(box);
+			visible.push_back(1);
+			testedBoxes.push_back(box);
+			firstTests.push_back(tests);
+		}
+		else
+		{
+			slot = freeSlots.back();
+			freeSlots.pop_back();
+			boxes[slot] = box;
+			visible[slot] = 1;
+			testedBoxes[slot] = box;
+			firstTests[slot] = tests;
+		}
+		slots.insert(std::make_pair(key, slot));
+		stats.objects = slots.size();
+		return true;
+	}
+	unsigned int slot = found->second;
+	boxes[slot] = box;
+	const AABB& tested = testedBoxes[slot];
+	bool moved = box.min != tested.min || box.max != tested.max;
+	return !enabled || visible[slot] || moved;
+}
+
+void HiZCuller::remove(const void* key)
+{
+	auto found = slots.find(key);
+	if (found == slots.end())
+	{
+		return;
+	}
+	//The slot's box is still tested until it is taken again, its results are ignored
+	firstTests[found->second] = UINT_MAX;
+	freeSlots.push_back(found->second);
+	slots.erase(found);
+	stats.objects = slots.size();
+}
+
+void HiZCuller::update(unsigned int depthTexture, const glm::mat4& viewProjection)
+{
+	if (!enabled || boxes.empty())
+	{
+		return;
+	}
+	//Every readback still in flight, this frame's test is dropped rather than waited on
+	if (readbacks[nextReadback].fence)
+	{
+		return;
+	}
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	GLint framebuffer;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+	GLboolean blend = glIsEnabled(GL_BLEND);
+	GLboolean cullFace = glIsEnabled(GL_CULL_FACE);
+	glDisable(GL_BLEND);
+	glDisable(GL_CULL_FACE);
+
+	buildPyramid(depthTexture);
+	testObjects(viewProjection);
+
+	glBindVertexArray(0);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	if (blend)
+	{
+		glEnable(GL_BLEND);
+	}
+	if (cullFace)
+	{
+		glEnable(GL_CULL_FACE);
+	}
+}
+
+void HiZCuller::buildPyramid(unsigned int depthTexture)
+{
+	reduceShader->use();
+	glUniform1i(glGetUniformLocation(reduceShader->getID(), "source"), 0);
+	GLint sourceSizeLocation = glGetUniformLocation(reduceShader->getID(), "sourceSize");
+	glBindFramebuffer(GL_FRAMEBUFFER, pyramidFbo);
+	glBindVertexArray(emptyVAO);
+	glActiveTexture(GL_TEXTURE0);
+
+	glm::ivec2 sourceSize;
+	glBindTexture(GL_TEXTURE_2D, depthTexture);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &sourceSize.x);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &sourceSize.y);
+	for (unsigned int level = 0; level < levelSizes.size(); ++level)
+	{
+		if (level > 0)
+		{
+			//Only the previous level is visible to the shader, so it is never read while written
+			glBindTexture(GL_TEXTURE_2D, pyramid);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+			sourceSize = glm::ivec2(levelSizes[level - 1]);
+		}
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pyramid, level);
+		glViewport(0, 0, levelSizes[level].x, levelSizes[level].y);
+		glUniform2i(sourceSizeLocation, sourceSize.x, sourceSize.y);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+	}
+	glBindTexture(GL_TEXTURE_2D, pyramid);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelSizes.size() - 1);
+}
+
+void HiZCuller::resizeResults(unsigned int objects)
+{
+	unsigned int rows = (objects + resultWidth - 1) / resultWidth;
+	if (rows <= resultRows)
+	{
+		return;
+	}
+	resultRows = std::max(rows, resultRows * 2);
+	glBindTexture(GL_TEXTURE_2D, resultTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, resultWidth, resultRows, 0, GL_RED, GL_UNSIGNED_BYTE, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, resultFbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, resultTexture, 0);
+}
+
+void HiZCuller::testObjects(const glm::mat4& viewProjection)
+{
+	unsigned int objects = boxes.size();
+	resizeResults(objects);
+	glBindBuffer(GL_ARRAY_BUFFER, boxBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(AABB) * objects, boxes.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	testShader->use();
+	unsigned int id = testShader->getID();
+	glUniformMatrix4fv(glGetUniformLocation(id, "viewProjection"), 1, GL_FALSE, glm::value_ptr(viewProjection));
+	glUniform1i(glGetUniformLocation(id, "pyramid"), 0);
+	glUniform2f(glGetUniformLocation(id, "levelZeroSize"), (float)levelSizes[0].x, (float)levelSizes[0].y);
+	glUniform1i(glGetUniformLocation(id, "maxLevel"), levelSizes.size() - 1);
+	glUniform2i(glGetUniformLocation(id, "resultSize"), resultWidth, resultRows);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, pyramid);
+	glBindFramebuffer(GL_FRAMEBUFFER, resultFbo);
+	glViewport(0, 0, resultWidth, resultRows);
+	glBindVertexArray(boxVAO);
+	glDrawArrays(GL_POINTS, 0, objects);
+
+	//Copied into the pixel buffer on the GPU, mapped in a later beginFrame once the fence passed
+	Readback& readback = readbacks[nextReadback];
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+	glBufferData(GL_PIXEL_PACK_BUFFER, resultWidth * resultRows, nullptr, GL_STREAM_READ);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glReadPixels(0, 0, resultWidth, resultRows, GL_RED, GL_UNSIGNED_BYTE, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	readback.objects = objects;
+	readback.boxes.assign(boxes.begin(), boxes.end());
+	readback.frame = frame;
+	readback.test = tests++;
+	nextReadback = (nextReadback + 1) % readbackCount;
+}
\ No newline at end of file
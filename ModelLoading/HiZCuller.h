@@ -0,0 +1,102 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "SimdMath.h"
+
+class Shader;
+
+struct HiZStats
+{
+	unsigned int objects = 0;
+	//Objects the last finished test found hidden
+	unsigned int hidden = 0;
+	//Frames between a test being issued and its result being read
+	unsigned int latency = 0;
+	unsigned int pendingReadbacks = 0;
+	unsigned int pyramidLevels = 0;
+};
+
+//Occlusion culling against a max depth pyramid built on the GPU from a depth texture. Every object
+//is kept under a key with its latest world space box. update builds the pyramid from the frame's
+//depth and tests every box against it with one point per object, the results are copied into a
+//pixel buffer and read back once their fence has passed, so the visibility used while drawing is
+//at least one frame old. Objects never tested yet, off screen or crossing the near plane are visible.
+//A hidden result only stands while the object's box is the one that was tested, anything that moved
+//since is drawn until a test of its new box comes back. The camera is not reprojected: an object
+//uncovered by a camera move can stay hidden for up to the readback latency, a few frames of pop in
+//that are accepted for never stalling on the GPU
+class HiZCuller
+{
+public:
+	//Size of the depth textures that will be passed to update
+	HiZCuller(unsigned int width, unsigned int height);
+	~HiZCuller();
+	HiZCuller(const HiZCuller&) = delete;
+	HiZCuller& operator=(const HiZCuller&) = delete;
+
+	//Reads back every test the GPU finished since the last call, never waits
+	void beginFrame();
+	//Stores the box for the next test and returns what the latest finished test found for the key
+	bool isVisible(const void* key, const AABB& box);
+	//Forgets a key whose object is gone, its slot goes to the next new key without the old results
+	void remove(const void* key);
+	//Builds the pyramid from a depth texture rendered with viewProjection and tests every box
+	//against it. Changes the framebuffer and viewport, restores both before returning
+	void update(unsigned int depthTexture, const glm::mat4& viewProjection);
+
+	void setEnabled(bool enabled) { this->enabled = enabled; }
+	bool isEnabled() const { return enabled; }
+	unsigned int getPyramid() const { return pyramid; }
+	const HiZStats& getStats() const { return stats; }
+private:
+	struct Readback
+	{
+		unsigned int buffer = 0;
+		GLsync fence = 0;
+		unsigned int objects = 0;
+		unsigned int frame = 0;
+		unsigned int test = 0;
+		//Boxes as they were tested, in slot order
+		std::vector<AABB> boxes;
+	};
+
+	void buildPyramid(unsigned int depthTexture);
+	void testObjects(const glm::mat4& viewProjection);
+	void resizeResults(unsigned int objects);
+
+	static const unsigned int resultWidth = 256;
+	static const unsigned int readbackCount = 3;
+
+	bool enabled = true;
+	unsigned int frame = 0;
+	std::vector<glm::uvec2> levelSizes;
+	unsigned int pyramid;
+	unsigned int pyramidFbo;
+	unsigned int emptyVAO;
+	std::unique_ptr<Shader> reduceShader;
+
+	unsigned int boxVAO;
+	unsigned int boxBuffer;
+	unsigned int resultTexture;
+	unsigned int resultFbo;
+	unsigned int resultRows = 0;
+	std::unique_ptr<Shader> testShader;
+	Readback readbacks[readbackCount];
+	unsigned int nextReadback = 0;
+	//Tests issued so far
+	unsigned int tests = 0;
+
+	std::unordered_map<const void*, unsigned int> slots;
+	//Min and max corners of every slot, in slot order
+	std::vector<AABB> boxes;
+	std::vector<unsigned char> visible;
+	//Box each slot's result was found with
+	std::vector<AABB> testedBoxes;
+	//First test whose result is for the key now in the slot, no result counts for a free slot
+	std::vector<unsigned int> firstTests;
+	std::vector<unsigned int> freeSlots;
+	HiZStats stats;
+};
\ No newline at end of file
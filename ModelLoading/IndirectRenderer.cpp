@@ -0,0 +1,244 @@
+#include "IndirectRenderer.h"
+#include "GLExtensions.h"
+#include "GeometryArena.h"
+#include "Mesh.h"
+#include "Window.h"
+#include "Shader.h"
+#include "MaterialLibrary.h"
+#include "SimdMath.h"
+#include <algorithm>
+#include <exception>
+#include <numeric>
+#include <cstring>
+
+namespace
+{
+	//Texture unit of the draw data buffer, the material textures use the ones below it
+	const unsigned int drawDataUnit = 7;
+
+	//The mesh shader only samples the first diffuse and specular texture
+	uint64_t getMaterialKey(const Mesh& mesh)
+	{
+		unsigned int diffuse = 0;
+		unsigned int specular = 0;
+		for (auto& texture : mesh.getTextures())
+		{
+			if (texture.type == aiTextureType_DIFFUSE && diffuse == 0)
+			{
+				diffuse = texture.id;
+			}
+			else if (texture.type == aiTextureType_SPECULAR && specular == 0)
+			{
+				specular = texture.id;
+			}
+		}
+		return ((uint64_t)diffuse << 32) | specular;
+	}
+}
+
+IndirectRenderer::IndirectRenderer()
+{
+	indirect = GLExtensions::hasMultiDrawIndirect();
+	glGenBuffers(1, &drawIdBuffer);
+	glGenBuffers(1, &drawDataBuffer);
+	glGenTextures(1, &drawDataTexture);
+	glBindBuffer(GL_TEXTURE_BUFFER, drawDataBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(DrawData), nullptr, GL_STREAM_DRAW);
+	glBindTexture(GL_TEXTURE_BUFFER, drawDataTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, drawDataBuffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	reserveDrawIds(1024);
+}
+
+IndirectRenderer::~IndirectRenderer()
+{
+	if (VAO)
+	{
+		glDeleteVertexArrays(1, &VAO);
+	}
+	glDeleteBuffers(1, &drawIdBuffer);
+	glDeleteBuffers(1, &drawDataBuffer);
+	glDeleteTextures(1, &drawDataTexture);
+}
+
+void IndirectRenderer::setIndirect(bool indirect)
+{
+	this->indirect = indirect && GLExtensions::hasMultiDrawIndirect();
+}
+
+void IndirectRenderer::reserveDrawIds(unsigned int count)
+{
+	if (count <= drawIdCapacity)
+	{
+		return;
+	}
+	drawIdCapacity = std::max(count, drawIdCapacity * 2);
+	std::vector<unsigned int> ids(drawIdCapacity);
+	std::iota(ids.begin(), ids.end(), 0u);
+	glBindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(unsigned int) * ids.size(), ids.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void IndirectRenderer::createVertexArray()
+{
+	GeometryArena& arena = GeometryArena::get();
+	if (VAO && arenaVertexBuffer == arena.getVertexBuffer() && arenaIndexBuffer == arena.getIndexBuffer())
+	{
+		return;
+	}
+	//The arena replaces its buffers when it grows, so the VAO is rebuilt against the new ones
+	if (!VAO)
+	{
+		glGenVertexArrays(1, &VAO);
+	}
+	glBindVertexArray(VAO);
+	arena.bindVertexFormat();
+	//With divisor 1 the attribute is fetched at the base instance, which is the draw index
+	glBindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+	glVertexAttribIPointer(drawIdLocation, 1, GL_UNSIGNED_INT, sizeof(unsigned int), (void*)0);
+	glEnableVertexAttribArray(drawIdLocation);
+	glVertexAttribDivisor(drawIdLocation, 1);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	arenaVertexBuffer = arena.getVertexBuffer();
+	arenaIndexBuffer = arena.getIndexBuffer();
+}
+
+void IndirectRenderer::begin()
+{
+	draws.clear();
+	stats = IndirectRendererStats();
+}
+
+void IndirectRenderer::add(Mesh& mesh, const glm::mat4& model, unsigned int paletteOffset)
+{
+	Draw draw;
+	draw.mesh = &mesh;
+	float materialIndex = 0;
+	if (materials && materials->isBuilt())
+	{
+		//The shader looks the textures up itself, so nothing splits the batch
+		draw.materialKey = 0;
+		if (mesh.getMaterialIndex() < 0)
+		{
+			throw std::exception("Mesh drawn with a material library it was not registered with!");
+		}
+		materialIndex = mesh.getMaterialIndex();
+	}
+	else
+	{
+		draw.materialKey = getMaterialKey(mesh);
+	}
+	draw.data.model = model;
+	glm::mat4 normalMatrix = simd::normalMatrix(model);
+	for (int i = 0; i < 3; ++i)
+	{
+		draw.data.normalMatrix[i] = normalMatrix[i];
+	}
+	draw.data.params = glm::vec4(materialIndex, paletteOffset, 0, 0);
+	draws.push_back(draw);
+}
+
+void IndirectRenderer::end(Window& window, Shader& shader)
+{
+	stats.draws = draws.size();
+	if (draws.empty())
+	{
+		return;
+	}
+
+	order.resize(draws.size());
+	std::iota(order.begin(), order.end(), 0u);
+	std::stable_sort(order.begin(), order.end(), [this](unsigned int a, unsigned int b) { return draws[a].materialKey < draws[b].materialKey; });
+
+	drawData.resize(draws.size());
+	commands.resize(draws.size());
+	for (unsigned int i = 0; i < order.size(); ++i)
+	{
+		const Draw& draw = draws[order[i]];
+		const MeshRange& range = draw.mesh->getRange();
+		drawData[i] = draw.data;
+		commands[i].count = range.indexCount;
+		commands[i].instanceCount = 1;
+		commands[i].firstIndex = range.firstIndex;
+		commands[i].baseVertex = range.baseVertex;
+		commands[i].baseInstance = i;
+	}
+
+	glBindBuffer(GL_TEXTURE_BUFFER, drawDataBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(DrawData) * drawData.size(), drawData.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	shader.use();
+	window.bindFrameData();
+	Mesh::bindSceneLight(window);
+	glUniform1i(glGetUniformLocation(shader.getID(), "drawData"), drawDataUnit);
+	glActiveTexture(GL_TEXTURE0 + drawDataUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, drawDataTexture);
+	glActiveTexture(GL_TEXTURE0);
+	bool useLibrary = materials && materials->isBuilt();
+	if (useLibrary)
+	{
+		materials->bind(shader);
+	}
+
+	size_t commandOffset = 0;
+	if (indirect)
+	{
+		reserveDrawIds(draws.size());
+		createVertexArray();
+		glBindVertexArray(VAO);
+		//Commands are written into the per frame ring, the draw offsets below are relative to the allocation
+		GpuRingBuffer& ring = window.getUniformRing();
+		RingAllocation allocation = ring.allocate(sizeof(DrawElementsIndirectCommand) * commands.size(), sizeof(DrawElementsIndirectCommand));
+		memcpy(allocation.data, commands.data(), allocation.size);
+		ring.flush();
+		commandOffset = allocation.offset;
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, ring.getBuffer());
+	}
+	else
+	{
+		glBindVertexArray(GeometryArena::get().getVertexArray());
+	}
+
+	unsigned int runStart = 0;
+	while (runStart < order.size())
+	{
+		uint64_t key = draws[order[runStart]].materialKey;
+		unsigned int runEnd = runStart + 1;
+		while (runEnd < order.size() && draws[order[runEnd]].materialKey == key)
+		{
+			++runEnd;
+		}
+		if (!useLibrary)
+		{
+			draws[order[runStart]].mesh->bindMaterial(shader);
+		}
+		++stats.materialBatches;
+
+		if (indirect)
+		{
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(commandOffset + sizeof(DrawElementsIndirectCommand) * runStart), runEnd - runStart, 0);
+			++stats.submitCalls;
+		}
+		else
+		{
+			//The arena VAO has no draw id array, so the constant attribute value is used instead
+			for (unsigned int i = runStart; i < runEnd; ++i)
+			{
+				glVertexAttribI1ui(drawIdLocation, i);
+				glDrawElementsBaseVertex(GL_TRIANGLES, commands[i].count, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int) * commands[i].firstIndex), commands[i].baseVertex);
+				++stats.submitCalls;
+			}
+		}
+		runStart = runEnd;
+	}
+
+	if (indirect)
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+	glBindVertexArray(0);
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+class Window;
+class Shader;
+class Mesh;
+class MaterialLibrary;
+
+//Layout consumed by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+	unsigned int count;
+	unsigned int instanceCount;
+	unsigned int firstIndex;
+	int baseVertex;
+	unsigned int baseInstance;
+};
+
+//Per draw record fetched by the shader from a texture buffer, eight texels per draw
+struct DrawData
+{
+	glm::mat4 model;
+	//Columns of the inverse transpose of the upper 3x3, w unused
+	glm::vec4 normalMatrix[3];
+	//x is the material index, y the first bone of the draw in the SkinPalette
+	glm::vec4 params;
+};
+
+struct IndirectRendererStats
+{
+	unsigned int draws = 0;
+	//glMultiDrawElementsIndirect calls, or single draws on the fallback path
+	unsigned int submitCalls = 0;
+	unsigned int materialBatches = 0;
+};
+
+//Collects the meshes of every model for a frame and submits them from the shared GeometryArena.
+//On GL 4.3 each material batch is one glMultiDrawElementsIndirect and the draw is identified in the
+//shader by its base instance, on the 3.3 context the same data is drawn with one call per mesh.
+//With a built MaterialLibrary the shader fetches the textures itself and the batches collapse into one
+class IndirectRenderer
+{
+public:
+	static const unsigned int drawIdLocation = 9;
+
+	IndirectRenderer();
+	~IndirectRenderer();
+	IndirectRenderer(const IndirectRenderer&) = delete;
+	IndirectRenderer& operator=(const IndirectRenderer&) = delete;
+
+	void begin();
+	//The material is the mesh's own library index. Skinned meshes pass the offset SkinPalette::add
+	//returned for their instance
+	void add(Mesh& mesh, const glm::mat4& model, unsigned int paletteOffset = 0);
+	void end(Window& window, Shader& shader);
+
+	bool isIndirect() const { return indirect; }
+	void setIndirect(bool indirect);
+	//Once the library is built every mesh is drawn with its material index instead of binding its
+	//textures, add throws for a mesh that was never registered with it
+	void setMaterialLibrary(MaterialLibrary* library) { materials = library; }
+	const IndirectRendererStats& getStats() const { return stats; }
+private:
+	struct Draw
+	{
+		Mesh* mesh;
+		uint64_t materialKey;
+		DrawData data;
+	};
+
+	void createVertexArray();
+	void reserveDrawIds(unsigned int count);
+
+	bool indirect;
+	MaterialLibrary* materials = nullptr;
+	unsigned int VAO = 0;
+	unsigned int arenaVertexBuffer = 0;
+	unsigned int arenaIndexBuffer = 0;
+	unsigned int drawIdBuffer;
+	unsigned int drawIdCapacity = 0;
+	unsigned int drawDataBuffer;
+	unsigned int drawDataTexture;
+
+	std::vector<Draw> draws;
+	std::vector<unsigned int> order;
+	std::vector<DrawData> drawData;
+	std::vector<DrawElementsIndirectCommand> commands;
+	IndirectRendererStats stats;
+};
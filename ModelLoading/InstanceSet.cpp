@@ -0,0 +1,162 @@
+#include "InstanceSet.h"
+#include "Mesh.h"
+#include "Model.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstddef>
+
+InstanceSet::InstanceSet(unsigned int capacity)
+{
+	this->capacity = std::max(capacity, 1u);
+	dirtyBegin = 0;
+	dirtyEnd = 0;
+	instances.reserve(this->capacity);
+	glGenBuffers(1, &VBO);
+}
+
+InstanceSet::~InstanceSet()
+{
+	glDeleteVertexArrays(1, &meshVAO);
+	glDeleteVertexArrays(1, &spriteVAO);
+	glDeleteBuffers(1, &VBO);
+}
+
+unsigned int InstanceSet::add(const InstanceData& instance)
+{
+	instances.push_back(instance);
+	if (instances.size() > capacity)
+	{
+		while (capacity < instances.size())
+		{
+			capacity *= 2;
+		}
+		reallocate = true;
+	}
+	markDirty(instances.size() - 1);
+	return instances.size() - 1;
+}
+
+void InstanceSet::set(unsigned int index, const InstanceData& instance)
+{
+	instances[index] = instance;
+	markDirty(index);
+}
+
+void InstanceSet::setTransform(unsigned int index, const glm::mat4& model)
+{
+	instances[index].model = model;
+	markDirty(index);
+}
+
+void InstanceSet::remove(unsigned int index)
+{
+	if (index >= instances.size())
+	{
+		return;
+	}
+	instances[index] = instances.back();
+	instances.pop_back();
+	if (index < instances.size())
+	{
+		markDirty(index);
+	}
+}
+
+void InstanceSet::clear()
+{
+	instances.clear();
+	dirtyBegin = 0;
+	dirtyEnd = 0;
+}
+
+void InstanceSet::markDirty(unsigned int index)
+{
+	if (dirtyBegin == dirtyEnd)
+	{
+		dirtyBegin = index;
+		dirtyEnd = index + 1;
+		return;
+	}
+	dirtyBegin = std::min(dirtyBegin, index);
+	dirtyEnd = std::max(dirtyEnd, index + 1);
+}
+
+void InstanceSet::upload()
+{
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	if (reallocate)
+	{
+		//Growing the buffer re-sends everything, the old storage is orphaned
+		glBufferData(GL_ARRAY_BUFFER, sizeof(InstanceData) * capacity, nullptr, GL_DYNAMIC_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(InstanceData) * instances.size(), instances.data());
+		reallocate = false;
+	}
+	else
+	{
+		//Removals can leave the range past the end of the set
+		dirtyEnd = std::min(dirtyEnd, (unsigned int)instances.size());
+		dirtyBegin = std::min(dirtyBegin, dirtyEnd);
+		if (dirtyBegin < dirtyEnd)
+		{
+			glBufferSubData(GL_ARRAY_BUFFER, sizeof(InstanceData) * dirtyBegin, sizeof(InstanceData) * (dirtyEnd - dirtyBegin), instances.data() + dirtyBegin);
+		}
+	}
+	dirtyBegin = 0;
+	dirtyEnd = 0;
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceSet::setupInstanceAttributes() const
+{
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	//A mat4 attribute takes four consecutive locations, one per column
+	for (unsigned int i = 0; i < 4; ++i)
+	{
+		glVertexAttribPointer(modelLocation + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offsetof(InstanceData, model) + sizeof(glm::vec4) * i));
+		glEnableVertexAttribArray(modelLocation + i);
+		glVertexAttribDivisor(modelLocation + i, 1);
+	}
+	glVertexAttribPointer(tintLocation, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)offsetof(InstanceData, tint));
+	glEnableVertexAttribArray(tintLocation);
+	glVertexAttribDivisor(tintLocation, 1);
+	glVertexAttribPointer(materialLocation, 1, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)offsetof(InstanceData, materialIndex));
+	glEnableVertexAttribArray(materialLocation);
+	glVertexAttribDivisor(materialLocation, 1);
+}
+
+unsigned int InstanceSet::getVertexArray(const Mesh& mesh)
+{
+	if (meshVAO && meshVertexBuffer == mesh.getVertexBuffer() && meshIndexBuffer == mesh.getIndexBuffer())
+	{
+		return meshVAO;
+	}
+	if (!meshVAO)
+	{
+		glGenVertexArrays(1, &meshVAO);
+	}
+	glBindVertexArray(meshVAO);
+	mesh.bindVertexFormat();
+	setupInstanceAttributes();
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	meshVertexBuffer = mesh.getVertexBuffer();
+	meshIndexBuffer = mesh.getIndexBuffer();
+	return meshVAO;
+}
+
+unsigned int InstanceSet::getSpriteVertexArray()
+{
+	if (spriteVAO)
+	{
+		return spriteVAO;
+	}
+	glGenVertexArrays(1, &spriteVAO);
+	glBindVertexArray(spriteVAO);
+	Sprite::bindVertexFormat();
+	setupInstanceAttributes();
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	return spriteVAO;
+}
\ No newline at end of file
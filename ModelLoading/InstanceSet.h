@@ -0,0 +1,60 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+class Mesh;
+
+//Per instance attributes, laid out exactly as they are streamed to the GPU
+struct InstanceData
+{
+	glm::mat4 model = glm::mat4(1.0f);
+	glm::vec4 tint = glm::vec4(1, 1, 1, 1);
+	float materialIndex = 0;
+};
+
+//Holds the transforms of every copy of a model or sprite in one buffer so all of them
+//can be drawn with a single glDrawElementsInstanced per mesh
+class InstanceSet
+{
+public:
+	//Attribute locations used by the instanced shaders, after the ones used by the vertex data
+	static const unsigned int modelLocation = 3;
+	static const unsigned int tintLocation = 7;
+	static const unsigned int materialLocation = 8;
+
+	InstanceSet(unsigned int capacity = 64);
+	~InstanceSet();
+	InstanceSet(const InstanceSet&) = delete;
+	InstanceSet& operator=(const InstanceSet&) = delete;
+
+	unsigned int add(const InstanceData& instance);
+	void set(unsigned int index, const InstanceData& instance);
+	void setTransform(unsigned int index, const glm::mat4& model);
+	const InstanceData& get(unsigned int index) const { return instances[index]; }
+	//Swaps the last instance into the removed slot, so indices past the removed one are not stable
+	void remove(unsigned int index);
+	void clear();
+	unsigned int size() const { return instances.size(); }
+
+	//Sends the modified range to the GPU, called by the draw functions
+	void upload();
+	//VAO that combines the vertex buffers of the given mesh with the instance buffer
+	unsigned int getVertexArray(const Mesh& mesh);
+	unsigned int getSpriteVertexArray();
+private:
+	void markDirty(unsigned int index);
+	void setupInstanceAttributes() const;
+
+	unsigned int VBO;
+	unsigned int capacity;
+	unsigned int dirtyBegin;
+	unsigned int dirtyEnd;
+	bool reallocate = true;
+	std::vector<InstanceData> instances;
+	//Every mesh is in the GeometryArena, so one VAO serves them all. It is set up again when the
+	//arena grows and replaces either of its buffers
+	unsigned int meshVAO = 0;
+	unsigned int meshVertexBuffer = 0;
+	unsigned int meshIndexBuffer = 0;
+	unsigned int spriteVAO = 0;
+};
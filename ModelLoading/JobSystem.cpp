@@ -0,0 +1,247 @@
+#include "JobSystem.h"
+#include <algorithm>
+
+namespace
+{
+	//Index of the worker the current thread is, 0 for every thread the system did not start
+	thread_local unsigned int currentWorker = 0;
+}
+
+JobSystem& JobSystem::get()
+{
+	static JobSystem jobSystem;
+	return jobSystem;
+}
+
+JobSystem::JobSystem()
+{
+	unsigned int count = std::max(std::thread::hardware_concurrency(), 1u);
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		workers.emplace_back(new Worker());
+	}
+	statsStart = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 1; i < count; ++i)
+	{
+		workers[i]->thread = std::thread(&JobSystem::workerLoop, this, i);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		running = false;
+	}
+	wake.notify_all();
+	for (unsigned int i = 1; i < workers.size(); ++i)
+	{
+		workers[i]->thread.join();
+	}
+}
+
+void JobSystem::push(Job job)
+{
+	Worker& worker = *workers[currentWorker];
+	{
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		worker.jobs.push_back(std::move(job));
+	}
+	queued.fetch_add(1, std::memory_order_release);
+	wake.notify_one();
+}
+
+void JobSystem::run(std::function<void()> job, JobCounter* counter)
+{
+	if (counter)
+	{
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+	}
+	Job queuedJob;
+	queuedJob.function = std::move(job);
+	queuedJob.counter = counter;
+	push(std::move(queuedJob));
+}
+
+void JobSystem::runAfter(JobCounter& dependency, std::function<void()> job, JobCounter* counter)
+{
+	//Counted right away, so waiting on counter also waits for the dependency
+	if (counter)
+	{
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+	}
+	{
+		std::lock_guard<std::mutex> lock(dependency.mutex);
+		if (!dependency.isDone())
+		{
+			dependency.continuations.push_back(std::move(job));
+			dependency.continuationCounters.push_back(counter);
+			return;
+		}
+	}
+	Job queuedJob;
+	queuedJob.function = std::move(job);
+	queuedJob.counter = counter;
+	push(std::move(queuedJob));
+}
+
+bool JobSystem::pop(unsigned int worker, Job& job)
+{
+	Worker& own = *workers[worker];
+	std::lock_guard<std::mutex> lock(own.mutex);
+	if (own.jobs.empty())
+	{
+		return false;
+	}
+	job = std::move(own.jobs.back());
+	own.jobs.pop_back();
+	queued.fetch_sub(1, std::memory_order_relaxed);
+	return true;
+}
+
+bool JobSystem::steal(unsigned int worker, Job& job)
+{
+	for (unsigned int i = 1; i < workers.size(); ++i)
+	{
+		Worker& victim = *workers[(worker + i) % workers.size()];
+		std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+		if (!lock.owns_lock() || victim.jobs.empty())
+		{
+			continue;
+		}
+		job = std::move(victim.jobs.front());
+		victim.jobs.pop_front();
+		queued.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+	return false;
+}
+
+void JobSystem::execute(unsigned int worker, Job& job, bool wasStolen)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	job.function();
+	auto end = std::chrono::high_resolution_clock::now();
+	Worker& stats = *workers[worker];
+	stats.busyNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(), std::memory_order_relaxed);
+	stats.jobsRun.fetch_add(1, std::memory_order_relaxed);
+	if (wasStolen)
+	{
+		stats.stolen.fetch_add(1, std::memory_order_relaxed);
+	}
+	finish(job.counter);
+}
+
+void JobSystem::finish(JobCounter* counter)
+{
+	if (!counter)
+	{
+		return;
+	}
+	std::vector<std::function<void()>> continuations;
+	std::vector<JobCounter*> continuationCounters;
+	{
+		//Taken before the decrement so runAfter never sees a finished counter with work still to hand over
+		std::lock_guard<std::mutex> lock(counter->mutex);
+		if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		{
+			return;
+		}
+		continuations.swap(counter->continuations);
+		continuationCounters.swap(counter->continuationCounters);
+	}
+	//The counter may be gone once it reads zero, only the moved out continuations are touched
+	for (unsigned int i = 0; i < continuations.size(); ++i)
+	{
+		Job job;
+		job.function = std::move(continuations[i]);
+		job.counter = continuationCounters[i];
+		push(std::move(job));
+	}
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+	unsigned int worker = currentWorker;
+	while (!counter.isDone())
+	{
+		Job job;
+		if (pop(worker, job))
+		{
+			execute(worker, job, false);
+		}
+		else if (steal(worker, job))
+		{
+			execute(worker, job, true);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+	//The finishing job may still hold the counter's lock, it has to be released before the counter goes away
+	std::lock_guard<std::mutex> lock(counter.mutex);
+}
+
+bool JobSystem::runOne()
+{
+	unsigned int worker = currentWorker;
+	Job job;
+	if (pop(worker, job))
+	{
+		execute(worker, job, false);
+		return true;
+	}
+	if (steal(worker, job))
+	{
+		execute(worker, job, true);
+		return true;
+	}
+	return false;
+}
+
+void JobSystem::workerLoop(unsigned int worker)
+{
+	currentWorker = worker;
+	while (running)
+	{
+		Job job;
+		if (pop(worker, job))
+		{
+			execute(worker, job, false);
+			continue;
+		}
+		if (steal(worker, job))
+		{
+			execute(worker, job, true);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wake.wait_for(lock, std::chrono::milliseconds(1), [this]() { return !running || queued.load(std::memory_order_acquire) > 0; });
+	}
+}
+
+std::vector<WorkerStats> JobSystem::getStats() const
+{
+	double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - statsStart).count();
+	std::vector<WorkerStats> stats(workers.size());
+	for (unsigned int i = 0; i < workers.size(); ++i)
+	{
+		stats[i].jobs = workers[i]->jobsRun.load(std::memory_order_relaxed);
+		stats[i].stolen = workers[i]->stolen.load(std::memory_order_relaxed);
+		stats[i].busyMs = workers[i]->busyNs.load(std::memory_order_relaxed) / 1000000.0;
+		stats[i].utilization = elapsedMs > 0 ? stats[i].busyMs / elapsedMs : 0;
+	}
+	return stats;
+}
+
+void JobSystem::resetStats()
+{
+	for (auto& worker : workers)
+	{
+		worker->jobsRun = 0;
+		worker->stolen = 0;
+		worker->busyNs = 0;
+	}
+	statsStart = std::chrono::high_resolution_clock::now();
+}
\ No newline at end of file
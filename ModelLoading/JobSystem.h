@@ -0,0 +1,122 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+
+//Counts the jobs started with it that have not finished yet. Jobs queued with runAfter are
+//released by the job that brings the count to zero
+class JobCounter
+{
+public:
+	JobCounter() {}
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+private:
+	friend class JobSystem;
+	std::atomic<int> pending{ 0 };
+	std::mutex mutex;
+	std::vector<std::function<void()>> continuations;
+	std::vector<JobCounter*> continuationCounters;
+};
+
+struct WorkerStats
+{
+	unsigned int jobs = 0;
+	//Jobs taken from the queue of another worker
+	unsigned int stolen = 0;
+	double busyMs = 0;
+	//Busy time over the time since the last resetStats
+	double utilization = 0;
+};
+
+//One worker thread per core besides the main thread, each with its own deque. A worker pushes and
+//pops at the back of its own deque and steals from the front of the others when it runs dry, so
+//related jobs tend to stay on one core. Threads that wait on a counter run jobs until it reaches
+//zero instead of blocking, the main thread included, so waiting never leaves a core idle.
+//Worker 0 is the main thread and any other thread that is not a worker
+class JobSystem
+{
+public:
+	static JobSystem& get();
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	void run(std::function<void()> job, JobCounter* counter = nullptr);
+	//Queued once every job counted by dependency has finished, right away when none is pending
+	void runAfter(JobCounter& dependency, std::function<void()> job, JobCounter* counter = nullptr);
+	//Runs queued jobs on the calling thread until the counter reaches zero
+	void wait(JobCounter& counter);
+	//Runs one queued job on the calling thread, false when every deque was empty
+	bool runOne();
+
+	//Calls function(begin, end) over ranges of at most grain items and waits for all of them.
+	//Small counts run in place
+	template<typename F>
+	void parallelFor(unsigned int count, unsigned int grain, const F& function)
+	{
+		if (count <= grain || workers.size() == 1)
+		{
+			if (count > 0)
+			{
+				function(0u, count);
+			}
+			return;
+		}
+		JobCounter counter;
+		//The caller takes the first range itself
+		for (unsigned int begin = grain; begin < count; begin += grain)
+		{
+			unsigned int end = std::min(begin + grain, count);
+			run([&function, begin, end]() { function(begin, end); }, &counter);
+		}
+		function(0u, grain);
+		wait(counter);
+	}
+
+	//Threads that run jobs, the main thread included
+	unsigned int getWorkerCount() const { return workers.size(); }
+	std::vector<WorkerStats> getStats() const;
+	void resetStats();
+private:
+	struct Job
+	{
+		std::function<void()> function;
+		JobCounter* counter = nullptr;
+	};
+
+	struct Worker
+	{
+		std::mutex mutex;
+		std::deque<Job> jobs;
+		std::thread thread;
+		std::atomic<unsigned int> jobsRun{ 0 };
+		std::atomic<unsigned int> stolen{ 0 };
+		std::atomic<long long> busyNs{ 0 };
+	};
+
+	JobSystem();
+	void push(Job job);
+	bool pop(unsigned int worker, Job& job);
+	bool steal(unsigned int worker, Job& job);
+	void execute(unsigned int worker, Job& job, bool wasStolen);
+	void finish(JobCounter* counter);
+	void workerLoop(unsigned int worker);
+
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::atomic<bool> running{ true };
+	//Jobs sitting in any deque, idle workers sleep while it is zero
+	std::atomic<int> queued{ 0 };
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::chrono::high_resolution_clock::time_point statsStart;
+};
\ No newline at end of file
@@ -0,0 +1,236 @@
+#include "MaterialLibrary.h"
+#include "GLExtensions.h"
+#include "UniformBlocks.h"
+#include "Shader.h"
+#include "stb_image.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <exception>
+#include <iostream>
+
+MaterialLibrary::MaterialLibrary(bool allowBindless)
+{
+	mode = allowBindless && GLExtensions::hasBindlessTexture() ? MaterialMode::Bindless : MaterialMode::TextureArrays;
+	glGenBuffers(1, &materialBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, materialBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(glm::uvec4) * MaterialData::maxMaterials, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+MaterialLibrary::~MaterialLibrary()
+{
+	for (GLuint64 handle : handles)
+	{
+		glMakeTextureHandleNonResidentARB(handle);
+	}
+	if (!arrays.empty())
+	{
+		glDeleteTextures(arrays.size(), arrays.data());
+	}
+	glDeleteBuffers(1, &materialBuffer);
+}
+
+int MaterialLibrary::addTexture(const Texture& texture)
+{
+	auto found = textureIndices.find(texture.path);
+	if (found != textureIndices.end())
+	{
+		return found->second;
+	}
+	TextureRef ref;
+	ref.path = texture.path;
+	ref.id = texture.id;
+	textures.push_back(ref);
+	textureIndices.insert(std::make_pair(texture.path, (int)textures.size() - 1));
+	built = false;
+	return textures.size() - 1;
+}
+
+int MaterialLibrary::registerMaterial(const std::vector<Texture>& meshTextures)
+{
+	//Same textures the mesh shader samples, the first diffuse and the first specular one
+	Material material;
+	for (auto& texture : meshTextures)
+	{
+		if (texture.type == aiTextureType_DIFFUSE && material.diffuse < 0)
+		{
+			material.diffuse = addTexture(texture);
+		}
+		else if (texture.type == aiTextureType_SPECULAR && material.specular < 0)
+		{
+			material.specular = addTexture(texture);
+		}
+	}
+	auto key = std::make_pair(material.diffuse, material.specular);
+	auto found = materialIndices.find(key);
+	if (found != materialIndices.end())
+	{
+		return found->second;
+	}
+	if (materials.size() >= MaterialData::maxMaterials)
+	{
+		throw std::exception("Material library is full!");
+	}
+	materials.push_back(material);
+	materialIndices.insert(std::make_pair(key, (int)materials.size() - 1));
+	built = false;
+	return materials.size() - 1;
+}
+
+void MaterialLibrary::buildArrays(std::vector<glm::uvec4>& entries)
+{
+	if (!arrays.empty())
+	{
+		glDeleteTextures(arrays.size(), arrays.data());
+		arrays.clear();
+	}
+
+	//Group the textures by size without decoding them, every size becomes one array
+	std::vector<std::pair<int, int>> sizes;
+	std::vector<unsigned int> layerCounts;
+	std::vector<glm::uvec4> placement(textures.size(), glm::uvec4(noTexture, noTexture, 0, 0));
+	for (unsigned int i = 0; i < textures.size(); ++i)
+	{
+		int width, height, channels;
+		if (!stbi_info(textures[i].path.c_str(), &width, &height, &channels))
+		{
+			continue;
+		}
+		unsigned int slot = 0;
+		while (slot < sizes.size() && sizes[slot] != std::make_pair(width, height))
+		{
+			++slot;
+		}
+		if (slot == sizes.size())
+		{
+			if (sizes.size() == maxArrays)
+			{
+				std::cout << "Too many texture sizes for the texture arrays, skipping " << textures[i].path << std::endl;
+				continue;
+			}
+			sizes.push_back(std::make_pair(width, height));
+			layerCounts.push_back(0);
+		}
+		placement[i] = glm::uvec4(slot, layerCounts[slot]++, 0, 0);
+	}
+
+	arrays.resize(sizes.size());
+	if (!arrays.empty())
+	{
+		glGenTextures(arrays.size(), arrays.data());
+	}
+	glActiveTexture(GL_TEXTURE0);
+	for (unsigned int slot = 0; slot < arrays.size(); ++slot)
+	{
+		glBindTexture(GL_TEXTURE_2D_ARRAY, arrays[slot]);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, sizes[slot].first, sizes[slot].second, layerCounts[slot], 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	}
+	//Decoded as jobs, one image per worker at a time so memory stays bounded, and uploaded here on the GL thread
+	std::vector<unsigned int> pending;
+	for (unsigned int i = 0; i < textures.size(); ++i)
+	{
+		if (placement[i].x != noTexture)
+		{
+			pending.push_back(i);
+		}
+	}
+	JobSystem& jobs = JobSystem::get();
+	unsigned int batch = jobs.getWorkerCount();
+	std::vector<unsigned char*> images(batch);
+	std::vector<glm::ivec2> imageSizes(batch);
+	for (unsigned int first = 0; first < pending.size(); first += batch)
+	{
+		unsigned int count = std::min(batch, (unsigned int)pending.size() - first);
+		jobs.parallelFor(count, 1, [&](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int j = begin; j < end; ++j)
+			{
+				int channels;
+				images[j] = stbi_load(textures[pending[first + j]].path.c_str(), &imageSizes[j].x, &imageSizes[j].y, &channels, 4);
+			}
+		});
+		for (unsigned int j = 0; j < count; ++j)
+		{
+			unsigned int i = pending[first + j];
+			glBindTexture(GL_TEXTURE_2D_ARRAY, arrays[placement[i].x]);
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, placement[i].y, imageSizes[j].x, imageSizes[j].y, 1, GL_RGBA, GL_UNSIGNED_BYTE, images[j]);
+			stbi_image_free(images[j]);
+		}
+	}
+	for (unsigned int slot = 0; slot < arrays.size(); ++slot)
+	{
+		glBindTexture(GL_TEXTURE_2D_ARRAY, arrays[slot]);
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	for (unsigned int i = 0; i < materials.size(); ++i)
+	{
+		glm::uvec4& entry = entries[i];
+		entry = glm::uvec4(noTexture, 0, noTexture, 0);
+		if (materials[i].diffuse >= 0)
+		{
+			entry.x = placement[materials[i].diffuse].x;
+			entry.y = placement[materials[i].diffuse].y;
+		}
+		if (materials[i].specular >= 0)
+		{
+			entry.z = placement[materials[i].specular].x;
+			entry.w = placement[materials[i].specular].y;
+		}
+	}
+}
+
+void MaterialLibrary::buildHandles(std::vector<glm::uvec4>& entries)
+{
+	//Handles stay valid once resident, only textures added since the last build need one
+	for (unsigned int i = handles.size(); i < textures.size(); ++i)
+	{
+		GLuint64 handle = glGetTextureHandleARB(textures[i].id);
+		glMakeTextureHandleResidentARB(handle);
+		handles.push_back(handle);
+	}
+	for (unsigned int i = 0; i < materials.size(); ++i)
+	{
+		GLuint64 diffuse = materials[i].diffuse >= 0 ? handles[materials[i].diffuse] : 0;
+		GLuint64 specular = materials[i].specular >= 0 ? handles[materials[i].specular] : 0;
+		entries[i] = glm::uvec4((unsigned int)diffuse, (unsigned int)(diffuse >> 32), (unsigned int)specular, (unsigned int)(specular >> 32));
+	}
+}
+
+void MaterialLibrary::build()
+{
+	std::vector<glm::uvec4> entries(materials.size());
+	if (mode == MaterialMode::Bindless)
+	{
+		buildHandles(entries);
+	}
+	else
+	{
+		buildArrays(entries);
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, materialBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::uvec4) * entries.size(), entries.data());
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	built = true;
+}
+
+void MaterialLibrary::bind(Shader& shader)
+{
+	glBindBufferBase(GL_UNIFORM_BUFFER, MaterialData::binding, materialBuffer);
+	if (mode != MaterialMode::TextureArrays)
+	{
+		return;
+	}
+	int units[maxArrays];
+	for (unsigned int i = 0; i < maxArrays; ++i)
+	{
+		units[i] = firstArrayUnit + i;
+		glActiveTexture(GL_TEXTURE0 + firstArrayUnit + i);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, i < arrays.size() ? arrays[i] : 0);
+	}
+	glActiveTexture(GL_TEXTURE0);
+	glUniform1iv(glGetUniformLocation(shader.getID(), "textureArrays"), maxArrays, units);
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "Helper.h"
+#include <glad/glad.h>
+#include <vector>
+#include <string>
+#include <map>
+#include <utility>
+#include <glm/glm.hpp>
+
+class Shader;
+
+enum class MaterialMode
+{
+	//Every texture is a layer of one of a few texture arrays, grouped by size
+	TextureArrays,
+	//ARB_bindless_texture handles are stored in the material buffer
+	Bindless
+};
+
+//Gathers the materials of every registered mesh into one uniform buffer so meshes with different
+//textures can be drawn back to back, or in one multi draw, without binding anything between them
+class MaterialLibrary
+{
+public:
+	static const unsigned int maxArrays = 8;
+	//Texture units of the arrays, after the ones used by the mesh textures and the draw data buffer
+	static const unsigned int firstArrayUnit = 8;
+	//Marks a missing texture in the material buffer
+	static const unsigned int noTexture = 0xFFFFFFFF;
+
+	MaterialLibrary(bool allowBindless = true);
+	~MaterialLibrary();
+	MaterialLibrary(const MaterialLibrary&) = delete;
+	MaterialLibrary& operator=(const MaterialLibrary&) = delete;
+
+	//Returns the index of the material using the first diffuse and specular texture of the list.
+	//Throws when the library already holds MaterialData::maxMaterials materials
+	int registerMaterial(const std::vector<Texture>& textures);
+	//Creates the arrays or texture handles and uploads the material buffer, called after loading
+	void build();
+	//Binds the material buffer and the arrays for the given shader, once per frame
+	void bind(Shader& shader);
+
+	MaterialMode getMode() const { return mode; }
+	bool isBuilt() const { return built; }
+	unsigned int getMaterialCount() const { return materials.size(); }
+private:
+	struct TextureRef
+	{
+		std::string path;
+		unsigned int id;
+	};
+	struct Material
+	{
+		int diffuse = -1;
+		int specular = -1;
+	};
+
+	int addTexture(const Texture& texture);
+	void buildArrays(std::vector<glm::uvec4>& entries);
+	void buildHandles(std::vector<glm::uvec4>& entries);
+
+	MaterialMode mode;
+	bool built = false;
+	unsigned int materialBuffer;
+	std::vector<TextureRef> textures;
+	std::vector<Material> materials;
+	std::map<std::string, int> textureIndices;
+	std::map<std::pair<int, int>, int> materialIndices;
+
+	std::vector<unsigned int> arrays;
+	std::vector<GLuint64> handles;
+};
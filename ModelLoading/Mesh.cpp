@@ -4,15 +4,31 @@
 #include <assimp/scene.h>
 #include "Shader.h"
 #include "Helper.h"
+#include "InstanceSet.h"
+#include "Window.h"
 #include <GLFW/glfw3.h>
+#include <algorithm>
 
-void Mesh::draw(Window& window, Shader& shader)
+void Mesh::draw(Window&, Shader& shader)
 {
 	//Shader is used in the model, uniforms are set there
 
-	glBindVertexArray(VAO);
+	glBindVertexArray(GeometryArena::get().getVertexArray());
+	bindMaterial(shader);
+	glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int) * range.firstIndex), range.baseVertex);
 
+}
+
+void Mesh::drawInstanced(Window&, Shader& shader, InstanceSet& instances)
+{
+	//Instance buffer is uploaded in the model, one draw covers every copy
+	glBindVertexArray(instances.getVertexArray(*this));
+	bindMaterial(shader);
+	glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int) * range.firstIndex), instances.size(), range.baseVertex);
+}
 
+void Mesh::bindMaterial(Shader& shader) const
+{
 	unsigned int diffuseNr = 1;
 	unsigned int specularNr = 1;
 
@@ -34,41 +50,59 @@ void Mesh::draw(Window& window, Shader& shader)
 
 	glUniform1i(glGetUniformLocation(shader.getID(), "shininess"), 32);
 
-
-	//setting a static directional light for now
-
-	glUniform3f(glGetUniformLocation(shader.getID(), "directionalLight.direction"), sin(glfwGetTime() * 1.5f), -2 , cos(glfwGetTime() * 1.5f));
-	glUniform3f(glGetUniformLocation(shader.getID(), "directionalLight.ambient"), 0.2f, 0.2f, 0.2f);
-	glUniform3f(glGetUniformLocation(shader.getID(), "directionalLight.diffuse"), 0.5f, 0.5f, 0.5f);
-	glUniform3f(glGetUniformLocation(shader.getID(), "directionalLight.specular"), 1, 1, 1);
-
 	glActiveTexture(GL_TEXTURE0);
+}
 
-	glDrawElements(GL_TRIANGLES, facesSize, GL_UNSIGNED_INT, 0);
-
+void Mesh::bindSceneLight(Window& window)
+{
+	//setting a static directional light for now
+	float time = window.getFrameTime();
+	window.getUniformRing().bindUniform(LightData::binding, LightData(glm::vec3(sin(time * 1.5f), -2, cos(time * 1.5f))));
 }
 
-void Mesh::loadToGPU(const std::vector<unsigned int>& indices, const std::vector<VertexData>& vertices, const std::vector<Texture>& textures)
+void Mesh::bindVertexFormat() const
 {
-	facesSize = indices.size();
-	glGenVertexArrays(1, &VAO);
-	glBindVertexArray(VAO);
-	glGenBuffers(1, &VBO);
-	glGenBuffers(1, &EBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(VertexData) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), indices.data(), GL_STATIC_DRAW);
+	GeometryArena::get().bindVertexFormat();
+}
 
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+void Mesh::loadToGPU(const std::vector<unsigned int>& indices, const std::vector<VertexData>& vertices, const std::vector<SkinVertex>& skin)
+{
+	range = GeometryArena::get().allocate(vertices, indices, skin);
+}
 
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glEnableVertexAttribArray(2);
+void Mesh::keepPositions(const std::vector<unsigned int>& indices, const std::vector<VertexData>& vertices)
+{
+	this->indices = indices;
+	positions.reserve(vertices.size());
+	for (auto& vertex : vertices)
+	{
+		positions.push_back(glm::vec3(vertex.vertX, vertex.vertY, vertex.vertZ));
+	}
+}
 
-	glBindVertexArray(0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+void Mesh::computeBounds(const std::vector<VertexData>& vertices)
+{
+	bounds.min = glm::vec3(0, 0, 0);
+	bounds.max = glm::vec3(0, 0, 0);
+	if (vertices.empty())
+	{
+		boundingSphere = glm::vec4(0, 0, 0, 0);
+		return;
+	}
+	bounds.min = glm::vec3(vertices[0].vertX, vertices[0].vertY, vertices[0].vertZ);
+	bounds.max = bounds.min;
+	for (auto& vertex : vertices)
+	{
+		glm::vec3 position(vertex.vertX, vertex.vertY, vertex.vertZ);
+		bounds.min = glm::min(bounds.min, position);
+		bounds.max = glm::max(bounds.max, position);
+	}
+	//Centered on the box, the radius reaches the furthest vertex rather than the box corner
+	glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+	float radius = 0;
+	for (auto& vertex : vertices)
+	{
+		radius = std::max(radius, glm::length(glm::vec3(vertex.vertX, vertex.vertY, vertex.vertZ) - center));
+	}
+	boundingSphere = glm::vec4(center, radius);
 }
\ No newline at end of file
@@ -1,22 +1,58 @@
 #pragma once
 #include "Drawable.h"
 #include "Helper.h"
+#include "GeometryArena.h"
+#include "SimdMath.h"
 #include <vector>
 
+class InstanceSet;
+
 class Mesh : public Drawable
 {
 public:
-	Mesh(const std::vector<unsigned int>& indices, const std::vector<VertexData>& vertices, const std::vector<Texture>& textures)
+	Mesh(const std::vector<unsigned int>& indices, const std::vector<VertexData>& vertices, const std::vector<Texture>& textures, const std::vector<SkinVertex>& skin = std::vector<SkinVertex>())
 	{
 		this->textures = textures;
-		loadToGPU(indices, vertices, textures);
+		skinned = !skin.empty();
+		computeBounds(vertices);
+		keepPositions(indices, vertices);
+		loadToGPU(indices, vertices, skin);
 	}
 
 	void draw(Window& window, Shader& shader) override;
+	void drawInstanced(Window& window, Shader& shader, InstanceSet& instances);
+	//Binds the buffers and sets the vertex attributes on the currently bound VAO
+	void bindVertexFormat() const;
+	unsigned int getVertexBuffer() const { return GeometryArena::get().getVertexBuffer(); }
+	unsigned int getIndexBuffer() const { return GeometryArena::get().getIndexBuffer(); }
+	const MeshRange& getRange() const { return range; }
+	//Bound to the bones of its model's skeleton, the bounds are those of the bind pose
+	bool isSkinned() const { return skinned; }
+	const std::vector<Texture>& getTextures() const { return textures; }
+	//Model space bounds, the sphere is (center, radius)
+	const AABB& getBounds() const { return bounds; }
+	const glm::vec4& getBoundingSphere() const { return boundingSphere; }
+	//CPU copy of the geometry for the OcclusionCuller, positions only
+	const std::vector<glm::vec3>& getPositions() const { return positions; }
+	const std::vector<unsigned int>& getIndices() const { return indices; }
+	//Index in the MaterialLibrary the mesh was registered with, -1 when it was not
+	int getMaterialIndex() const { return materialIndex; }
+	void setMaterialIndex(int index) { materialIndex = index; }
+	void bindMaterial(Shader& shader) const;
+	//Light shared by every mesh, bound once per model rather than per mesh
+	static void bindSceneLight(Window& window);
 private:
-	void loadToGPU(const std::vector<unsigned int>& indices, const std::vector<VertexData>& vertices, const std::vector<Texture>& textures);
-	unsigned int VAO, VBO, EBO;
-	unsigned int facesSize;
+	void loadToGPU(const std::vector<unsigned int>& indices, const std::vector<VertexData>& vertices, const std::vector<SkinVertex>& skin);
+	void computeBounds(const std::vector<VertexData>& vertices);
+	void keepPositions(const std::vector<unsigned int>& indices, const std::vector<VertexData>& vertices);
+	//Vertices and indices live in the shared GeometryArena
+	MeshRange range;
+	int materialIndex = -1;
+	bool skinned;
+	AABB bounds;
+	glm::vec4 boundingSphere;
+	std::vector<glm::vec3> positions;
+	std::vector<unsigned int> indices;
 
 	std::vector<Texture> textures;
 };
\ No newline at end of file
@@ -10,41 +10,326 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/quaternion.hpp>
 #include "Window.h"
+#include "InstanceSet.h"
+#include "IndirectRenderer.h"
+#include "MaterialLibrary.h"
+#include "CommandList.h"
+#include "FrustumCuller.h"
+#include "OcclusionCuller.h"
+#include "HiZCuller.h"
+#include "EntityStore.h"
+#include "SkinPalette.h"
+#include <algorithm>
 
 std::unordered_map<std::string, int> Model::textureCache = std::unordered_map<std::string, int>();
 
+namespace
+{
+	//Assimp matrices are row major
+	glm::mat4 toGlm(const aiMatrix4x4& m)
+	{
+		return glm::mat4(m.a1, m.b1, m.c1, m.d1, m.a2, m.b2, m.c2, m.d2, m.a3, m.b3, m.c3, m.d3, m.a4, m.b4, m.c4, m.d4);
+	}
+
+	void addJoints(Skeleton& skeleton, const aiNode* node, int parent)
+	{
+		aiVector3D scale;
+		aiQuaternion rotation;
+		aiVector3D position;
+		node->mTransformation.Decompose(scale, rotation, position);
+		int joint = skeleton.addJoint(node->mName.C_Str(), parent, glm::vec3(position.x, position.y, position.z), glm::fquat(rotation.w, rotation.x, rotation.y, rotation.z), glm::vec3(scale.x, scale.y, scale.z));
+		for (unsigned int i = 0; i < node->mNumChildren; ++i)
+		{
+			addJoints(skeleton, node->mChildren[i], joint);
+		}
+	}
+
+	//Keeps the four heaviest influences of every vertex, rescaled to bytes summing to 255
+	std::vector<SkinVertex> readSkin(const aiMesh* mesh, Skeleton& skeleton)
+	{
+		std::vector<unsigned int> bones(mesh->mNumVertices * 4, 0);
+		std::vector<float> weights(mesh->mNumVertices * 4, 0.0f);
+		for (unsigned int i = 0; i < mesh->mNumBones; ++i)
+		{
+			const aiBone* bone = mesh->mBones[i];
+			unsigned int index = skeleton.addBone(bone->mName.C_Str(), toGlm(bone->mOffsetMatrix));
+			for (unsigned int j = 0; j < bone->mNumWeights; ++j)
+			{
+				const aiVertexWeight& weight = bone->mWeights[j];
+				unsigned int* vertexBones = &bones[weight.mVertexId * 4];
+				float* vertexWeights = &weights[weight.mVertexId * 4];
+				unsigned int lightest = 0;
+				for (unsigned int k = 1; k < 4; ++k)
+				{
+					if (vertexWeights[k] < vertexWeights[lightest])
+					{
+						lightest = k;
+					}
+				}
+				if (weight.mWeight > vertexWeights[lightest])
+				{
+					vertexBones[lightest] = index;
+					vertexWeights[lightest] = weight.mWeight;
+				}
+			}
+		}
+
+		std::vector<SkinVertex> skin(mesh->mNumVertices);
+		for (unsigned int i = 0; i < mesh->mNumVertices; ++i)
+		{
+			const float* vertexWeights = &weights[i * 4];
+			float total = vertexWeights[0] + vertexWeights[1] + vertexWeights[2] + vertexWeights[3];
+			SkinVertex& out = skin[i];
+			int sum = 0;
+			unsigned int heaviest = 0;
+			for (unsigned int k = 0; k < 4; ++k)
+			{
+				out.bones[k] = bones[i * 4 + k];
+				out.weights[k] = total > 0 ? (unsigned char)(vertexWeights[k] / total * 255.0f + 0.5f) : 0;
+				sum += out.weights[k];
+				if (vertexWeights[k] > vertexWeights[heaviest])
+				{
+					heaviest = k;
+				}
+			}
+			//Rounding leaves the sum a little off, the heaviest influence takes the difference
+			if (total > 0)
+			{
+				out.weights[heaviest] = out.weights[heaviest] + 255 - sum;
+			}
+		}
+		return skin;
+	}
+
+	//Imports every animation and compresses it, the imported keys are dropped right after
+	void readAnimations(const aiScene* scene, const Skeleton& skeleton, std::vector<CompressedClip>& clips)
+	{
+		for (unsigned int i = 0; i < scene->mNumAnimations; ++i)
+		{
+			const aiAnimation* animation = scene->mAnimations[i];
+			//Times are in ticks, files that leave the rate out are usually authored at 25
+			double ticksPerSecond = animation->mTicksPerSecond > 0 ? animation->mTicksPerSecond : 25.0;
+			AnimationClip clip;
+			clip.name = animation->mName.C_Str();
+			clip.duration = animation->mDuration / ticksPerSecond;
+			for (unsigned int j = 0; j < animation->mNumChannels; ++j)
+			{
+				const aiNodeAnim* nodeAnim = animation->mChannels[j];
+				int joint = skeleton.findJoint(nodeAnim->mNodeName.C_Str());
+				if (joint < 0)
+				{
+					continue;
+				}
+				JointChannel channel;
+				channel.joint = joint;
+				for (unsigned int k = 0; k < nodeAnim->mNumPositionKeys; ++k)
+				{
+					const aiVectorKey& key = nodeAnim->mPositionKeys[k];
+					channel.positions.push_back({ (float)(key.mTime / ticksPerSecond), glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z) });
+				}
+				for (unsigned int k = 0; k < nodeAnim->mNumRotationKeys; ++k)
+				{
+					const aiQuatKey& key = nodeAnim->mRotationKeys[k];
+					channel.rotations.push_back({ (float)(key.mTime / ticksPerSecond), glm::fquat(key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z) });
+				}
+				for (unsigned int k = 0; k < nodeAnim->mNumScalingKeys; ++k)
+				{
+					const aiVectorKey& key = nodeAnim->mScalingKeys[k];
+					channel.scales.push_back({ (float)(key.mTime / ticksPerSecond), glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z) });
+				}
+				clip.joints.push_back(joint);
+				clip.channels.push_back(std::move(channel));
+			}
+			clips.push_back(CompressedClip(clip));
+		}
+	}
+}
+
 void Model::draw(Window& window, Shader& shader)
 {
+	glm::mat4 transform = getTransform();
+	FrustumCuller& culler = window.getCuller();
+	bool culling = culler.isEnabled();
+	if (culling && !cull(culler, window.getOcclusionCuller(), window.getHiZCuller(), transform))
+	{
+		return;
+	}
 	shader.use();
 
-	glUniformMatrix4fv(glGetUniformLocation(shader.getID(), "view"), 1, GL_FALSE, glm::value_ptr(window.getView()));
-	glUniformMatrix4fv(glGetUniformLocation(shader.getID(), "projection"), 1, GL_FALSE, glm::value_ptr(window.getProjection()));
+	window.bindFrameData();
+	window.getUniformRing().bindUniform(ObjectData::binding, ObjectData(transform, getNormalMatrix()));
+	Mesh::bindSceneLight(window);
 
-	glm::mat4 rotationMatrix = glm::toMat4(rotation);
+	for (unsigned int i = 0; i < meshes.size(); ++i)
+	{
+		if (!culling || meshVisible[i])
+		{
+			meshes[i].draw(window, shader);
+		}
+	}
+}
 
-	glm::mat4 translationMatrix = glm::translate(glm::mat4(1.0f), position);
-	glm::mat4 scaleMatrix = glm::scale(glm::mat4(1.0f), scale);
+bool Model::cull(FrustumCuller& culler, OcclusionCuller* occlusion, HiZCuller* hiZ, const glm::mat4& transform)
+{
+	CullingStats& stats = culler.getStats();
+	if (!culler.isVisible(FrustumCuller::transformSphere(transform, boundingSphere)))
+	{
+		++stats.modelsCulled;
+		stats.meshesCulled += meshes.size();
+		return false;
+	}
+	++stats.modelsVisible;
 
-	glm::mat4 combined = translationMatrix * rotationMatrix * scaleMatrix;
+	meshBounds.resize(meshes.size());
+	meshVisible.resize(meshes.size());
+	for (unsigned int i = 0; i < meshes.size(); ++i)
+	{
+		meshBounds[i] = meshes[i].getBounds();
+	}
+	simd::transformAABBs(transform, meshBounds.data(), meshBounds.data(), meshBounds.size());
+	culler.cullBoxes(meshBounds.data(), meshBounds.size(), meshVisible.data());
+	bool occlusionCulling = occlusion && occlusion->isEnabled();
+	for (unsigned int i = 0; i < meshes.size(); ++i)
+	{
+		//Every box goes to the Hi-Z culler, outside the frustum or not, so none of its results go stale
+		bool hiZVisible = !hiZ || hiZ->isVisible(&meshes[i], meshBounds[i]);
+		if (meshVisible[i] && ((occlusionCulling && !occlusion->isVisible(meshBounds[i])) || !hiZVisible))
+		{
+			meshVisible[i] = 0;
+			++stats.meshesOccluded;
+		}
+		else if (meshVisible[i])
+		{
+			++stats.meshesVisible;
+		}
+		else
+		{
+			++stats.meshesCulled;
+		}
+	}
+	return true;
+}
 
-	glUniformMatrix4fv(glGetUniformLocation(shader.getID(), "model"), 1, GL_FALSE, glm::value_ptr(combined));
-	glUniform3f(glGetUniformLocation(shader.getID(), "viewPos"), window.getCameraPosition().x, window.getCameraPosition().y, window.getCameraPosition().z);
+void Model::computeBounds()
+{
+	bounds.min = glm::vec3(0, 0, 0);
+	bounds.max = glm::vec3(0, 0, 0);
+	boundingSphere = glm::vec4(0, 0, 0, 0);
+	if (meshes.empty())
+	{
+		return;
+	}
+	bounds = meshes[0].getBounds();
+	for (auto& mesh : meshes)
+	{
+		bounds.min = glm::min(bounds.min, mesh.getBounds().min);
+		bounds.max = glm::max(bounds.max, mesh.getBounds().max);
+	}
+	//Encloses every mesh sphere around the center of the combined box
+	glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+	float radius = 0;
+	for (auto& mesh : meshes)
+	{
+		const glm::vec4& sphere = mesh.getBoundingSphere();
+		radius = std::max(radius, glm::length(glm::vec3(sphere) - center) + sphere.w);
+	}
+	boundingSphere = glm::vec4(center, radius);
+}
+
+void Model::submit(IndirectRenderer& renderer, FrustumCuller* culler, OcclusionCuller* occlusion, HiZCuller* hiZ)
+{
+	glm::mat4 transform = getTransform();
+	bool culling = culler && culler->isEnabled();
+	if (culling && !cull(*culler, occlusion, hiZ, transform))
+	{
+		return;
+	}
+	for (unsigned int i = 0; i < meshes.size(); ++i)
+	{
+		if (!culling || meshVisible[i])
+		{
+			renderer.add(meshes[i], transform);
+		}
+	}
+}
 
+void Model::submitSkinned(IndirectRenderer& renderer, SkinPalette& palette, const glm::mat4& transform, const Animator& animator)
+{
+	unsigned int offset = palette.add(animator.getPalette().data(), animator.getPalette().size());
 	for (auto& mesh : meshes)
 	{
-		mesh.draw(window, shader);
+		renderer.add(mesh, transform, offset);
 	}
 }
 
-unsigned int Model::loadTexture(const std::string& filename)
+void Model::submitOccluder(OcclusionCuller& occlusion) const
 {
-	if (textureCache.find(filename) != textureCache.end())
+	glm::mat4 transform = getTransform();
+	for (auto& mesh : meshes)
 	{
-		return textureCache[filename];
+		occlusion.addOccluder(mesh.getPositions().data(), mesh.getIndices().data(), mesh.getIndices().size(), transform);
 	}
-	int width, height, channels;
-	unsigned char* data = stbi_load(filename.c_str(), &width, &height, &channels, 0);
+}
+
+void Model::record(CommandList& list, const glm::mat4& transform) const
+{
+	list.setDrawData(transform);
+	for (auto& mesh : meshes)
+	{
+		list.bindMaterial(mesh);
+		list.drawRange(mesh.getRange());
+	}
+}
+
+std::vector<Entity> Model::spawn(EntityStore& store)
+{
+	std::vector<Entity> entities;
+	for (auto& mesh : meshes)
+	{
+		entities.push_back(store.createMesh(node, mesh));
+	}
+	return entities;
+}
+
+void Model::registerMaterials(MaterialLibrary& library)
+{
+	for (auto& mesh : meshes)
+	{
+		mesh.setMaterialIndex(library.registerMaterial(mesh.getTextures()));
+	}
+}
+
+void Model::drawInstanced(Window& window, Shader& shader, InstanceSet& instances)
+{
+	if (instances.size() == 0)
+	{
+		return;
+	}
+	shader.use();
+
+	window.bindFrameData();
+	Mesh::bindSceneLight(window);
 
+	instances.upload();
+	for (auto& mesh : meshes)
+	{
+		mesh.drawInstanced(window, shader, instances);
+	}
+}
+
+bool Model::findCachedTexture(const std::string& filename, unsigned int& id)
+{
+	auto found = textureCache.find(filename);
+	if (found == textureCache.end())
+	{
+		return false;
+	}
+	id = found->second;
+	return true;
+}
+
+unsigned int Model::uploadTexture(const std::string& filename, const unsigned char* data, int width, int height)
+{
 	unsigned int texID;
 	glGenTextures(1, &texID);
 
@@ -52,35 +337,62 @@ unsigned int Model::loadTexture(const std::string& filename)
 	glBindTexture(GL_TEXTURE_2D, texID);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
 	glGenerateMipmap(GL_TEXTURE_2D);
-	stbi_image_free(data);
 	textureCache.insert(std::make_pair(filename, texID));
 	return texID;
 }
 
-Model::Model(const std::string& filename)
+unsigned int Model::loadTexture(const std::string& filename)
+{
+	unsigned int texID;
+	if (findCachedTexture(filename, texID))
+	{
+		return texID;
+	}
+	int width, height, channels;
+	unsigned char* data = stbi_load(filename.c_str(), &width, &height, &channels, 0);
+	texID = uploadTexture(filename, data, width, height);
+	stbi_image_free(data);
+	return texID;
+}
+
+ModelData Model::parse(const std::string& filename)
 {
+	ModelData result;
 	Assimp::Importer importer;
 	const aiScene* scene = importer.ReadFile(filename.c_str(), aiProcess_Triangulate);
-	directory = directory.substr(0, filename.find_last_of('/'));
+	result.directory = result.directory.substr(0, filename.find_last_of('/'));
 
-	for (int i = 0; i < scene->mNumMeshes; ++i)
+	//The whole node tree becomes the skeleton as soon as one mesh is rigged
+	bool rigged = false;
+	for (unsigned int i = 0; i < scene->mNumMeshes; ++i)
 	{
+		rigged = rigged || scene->mMeshes[i]->HasBones();
+	}
+	if (rigged)
+	{
+		addJoints(result.skeleton, scene->mRootNode, -1);
+		result.skeleton.setGlobalInverse(glm::inverse(toGlm(scene->mRootNode->mTransformation)));
+		readAnimations(scene, result.skeleton, result.animations);
+	}
 
-		std::vector<Texture> texturesToInsert;
-		std::vector<VertexData> vertices;
-		std::vector<unsigned int> indices;
+	for (int i = 0; i < scene->mNumMeshes; ++i)
+	{
+		MeshData meshData;
+		std::vector<Texture>& texturesToInsert = meshData.textures;
+		std::vector<VertexData>& vertices = meshData.vertices;
+		std::vector<unsigned int>& indices = meshData.indices;
 
 		aiMesh* mesh = scene->mMeshes[i];
 		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
 		aiString fileName;
 		Texture textureToInsert;
+		textureToInsert.id = 0;
 		for (int j = 0; j < material->GetTextureCount(aiTextureType_DIFFUSE); ++j)
 		{
 			textureToInsert.type = aiTextureType_DIFFUSE;
 			textureToInsert.index = j;
 			material->GetTexture(aiTextureType_DIFFUSE, j, &fileName);
-			unsigned int id = loadTexture(std::string(fileName.C_Str()));
-			textureToInsert.id = id;
+			textureToInsert.path = fileName.C_Str();
 			texturesToInsert.push_back(textureToInsert);
 		}
 		for (int j = 0; j < material->GetTextureCount(aiTextureType_SPECULAR); ++j)
@@ -88,12 +400,12 @@ Model::Model(const std::string& filename)
 			textureToInsert.type = aiTextureType_SPECULAR;
 			textureToInsert.index = j;
 			material->GetTexture(aiTextureType_SPECULAR, j, &fileName);
-			unsigned int id = loadTexture(std::string(fileName.C_Str()));
-			textureToInsert.id = id;
+			textureToInsert.path = fileName.C_Str();
 			texturesToInsert.push_back(textureToInsert);
 		}
 
 		VertexData data;
+		vertices.reserve(mesh->mNumVertices);
 		for (int j = 0; j < mesh->mNumVertices; ++j)
 		{
 			data.vertX = mesh->mVertices[j].x;
@@ -116,14 +428,46 @@ Model::Model(const std::string& filename)
 			for (unsigned int j = 0; j < face.mNumIndices; j++)
 				indices.push_back(face.mIndices[j]);
 		}
+		if (mesh->HasBones())
+		{
+			meshData.skin = readSkin(mesh, result.skeleton);
+		}
+
+		result.meshes.push_back(std::move(meshData));
+	}
+	return result;
+}
+
+Model::Model(const std::string& filename)
+	: Model(parse(filename))
+{
+}
 
-		meshes.push_back(Mesh(indices, vertices, texturesToInsert));
+Model::Model(ModelData&& data)
+{
+	directory = data.directory;
+	meshes.reserve(data.meshes.size());
+	for (auto& mesh : data.meshes)
+	{
+		for (auto& texture : mesh.textures)
+		{
+			if (texture.id == 0)
+			{
+				texture.id = loadTexture(texture.path);
+			}
+		}
+		meshes.push_back(Mesh(mesh.indices, mesh.vertices, mesh.textures, mesh.skin));
 	}
+	skeleton = std::move(data.skeleton);
+	animations = std::move(data.animations);
+	computeBounds();
+	SceneGraph::get().setBounds(node, bounds);
 }
 
 unsigned int Sprite::VBO = 0;
 unsigned int Sprite::VAO = 0;
 unsigned int Sprite::EBO = 0;
+const AABB Sprite::quadBounds = { glm::vec3(-0.5f, -0.5f, 0), glm::vec3(0.5f, 0.5f, 0) };
 
 std::unordered_map<std::string, unsigned int> Sprite::textureCache = std::unordered_map<std::string, unsigned int>();
 
@@ -139,18 +483,45 @@ void Sprite::draw(Window& window, Shader& shader)
 	glBindTexture(GL_TEXTURE_2D, textureID);
 
 	glUniform1i(glGetUniformLocation(shader.getID(), "textureApply"), 0);
-	glUniformMatrix4fv(glGetUniformLocation(shader.getID(), "view"), 1, GL_FALSE, glm::value_ptr(window.getView()));
-	glUniformMatrix4fv(glGetUniformLocation(shader.getID(), "projection"), 1, GL_FALSE, glm::value_ptr(window.getProjection()));
-
-	glm::mat4 translationn = glm::translate(glm::mat4(1.0f), position);
-	glm::mat4 scalee = glm::scale(glm::mat4(1.0f), scale);
-	glm::mat4 rotationn = glm::toMat4(rotation);
-
-	glUniformMatrix4fv(glGetUniformLocation(shader.getID(), "model"), 1, GL_FALSE, glm::value_ptr(translationn * scalee * rotationn));
+	window.bindFrameData();
+	window.getUniformRing().bindUniform(ObjectData::binding, ObjectData(getTransform(), getNormalMatrix()));
 	glBindVertexArray(VAO);
 	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
 }
+
+Entity Sprite::spawn(EntityStore& store) const
+{
+	return store.createSprite(node, textureID);
+}
+
+void Sprite::drawInstanced(Window& window, Shader& shader, InstanceSet& instances)
+{
+	if (instances.size() == 0)
+	{
+		return;
+	}
+	shader.use();
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+
+	glUniform1i(glGetUniformLocation(shader.getID(), "textureApply"), 0);
+	window.bindFrameData();
+
+	instances.upload();
+	glBindVertexArray(instances.getSpriteVertexArray());
+	glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, instances.size());
+}
+
+void Sprite::bindVertexFormat()
+{
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+}
 float Sprite::verticesData[] = {
 	 0.5f,  0.5f, 0.0f, 1.0f, 1.0f,   // top right
 	 0.5f, -0.5f, 0.0f, 1.0f, 0.0f,   // bottom right
@@ -158,7 +529,7 @@ float Sprite::verticesData[] = {
 	-0.5f,  0.5f, 0.0f, 0.0f, 1.0f    // top left 
 };
 
-Sprite::Sprite(unsigned int texture)
+void Sprite::createQuad()
 {
 	if (VAO == 0)
 	{
@@ -170,60 +541,59 @@ Sprite::Sprite(unsigned int texture)
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(verticesData), verticesData, GL_STATIC_DRAW);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-		glEnableVertexAttribArray(0);
-		glEnableVertexAttribArray(1);
+		bindVertexFormat();
 
 		glBindVertexArray(0);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	}
+}
+
+Sprite::Sprite(unsigned int texture)
+{
+	createQuad();
 	textureID = texture;
+	SceneGraph::get().setBounds(node, quadBounds);
 }
 
 Sprite::Sprite(const std::string& filename)
 {
-	if (VAO == 0)
+	createQuad();
+	if (!findCachedTexture(filename, textureID))
 	{
-		glGenVertexArrays(1, &VAO);
-		glBindVertexArray(VAO);
-		glGenBuffers(1, &VBO);
-		glGenBuffers(1, &EBO);
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(verticesData), verticesData, GL_STATIC_DRAW);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-		glEnableVertexAttribArray(0);
-		glEnableVertexAttribArray(1);
-
-		glBindVertexArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		int width, height, channels;
+		unsigned char* data = stbi_load(filename.c_str(), &width, &height, &channels, 0);
+		textureID = uploadTexture(filename, data, width, height);
+		stbi_image_free(data);
 	}
-	if (textureCache.find(filename) != textureCache.end())
+	SceneGraph::get().setBounds(node, quadBounds);
+}
+
+bool Sprite::findCachedTexture(const std::string& filename, unsigned int& id)
+{
+	auto found = textureCache.find(filename);
+	if (found == textureCache.end())
 	{
-		textureID = textureCache[filename];
+		return false;
 	}
-	else
-	{
-		glGenTextures(1, &textureID);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, textureID);
+	id = found->second;
+	return true;
+}
 
-		int width, height, channels;
-		unsigned char* data = stbi_load(filename.c_str(), &width, &height, &channels, 0);
+unsigned int Sprite::uploadTexture(const std::string& filename, const unsigned char* data, int width, int height)
+{
+	unsigned int texID;
+	glGenTextures(1, &texID);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, texID);
 
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-		stbi_image_free(data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+	glGenerateMipmap(GL_TEXTURE_2D);
 
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		textureCache.insert(std::make_pair(filename, textureID));
-	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	textureCache.insert(std::make_pair(filename, texID));
+	return texID;
 }
\ No newline at end of file
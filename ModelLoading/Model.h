@@ -1,46 +1,124 @@
 #pragma once
 #include "Mesh.h"
+#include "SceneGraph.h"
+#include "EntityStore.h"
+#include "Skeleton.h"
 #include <unordered_map>
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 
-class Model : public Drawable
+class InstanceSet;
+class IndirectRenderer;
+class MaterialLibrary;
+class CommandList;
+class FrustumCuller;
+class OcclusionCuller;
+class HiZCuller;
+class SkinPalette;
+
+//A mesh as read from the file, texture ids are 0 until the textures are uploaded
+struct MeshData
+{
+	std::vector<VertexData> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<Texture> textures;
+	//Empty when the mesh has no bones
+	std::vector<SkinVertex> skin;
+};
+
+//Everything Model::parse reads on the CPU, it touches no GL state so any thread can build it
+struct ModelData
+{
+	std::vector<MeshData> meshes;
+	std::string directory;
+	//Only filled when a mesh has bones
+	Skeleton skeleton;
+	std::vector<CompressedClip> animations;
+};
+
+class Model : public Drawable, public SceneObject
 {
 public:
 	Model(const std::string& filename);
+	//Uploads the parsed meshes, textures without an id are loaded from the cache or the disk
+	Model(ModelData&& data);
+
+	static ModelData parse(const std::string& filename);
+	//Texture cache shared by every model, only used from the GL thread
+	static bool findCachedTexture(const std::string& filename, unsigned int& id);
+	//Uploads decoded pixels and caches them under the filename
+	static unsigned int uploadTexture(const std::string& filename, const unsigned char* data, int width, int height);
 
 	void draw(Window& window, Shader& shader) override;
-	void setRotation(const glm::fquat& rot) { rotation = rot; }
-	void setScale(const glm::vec3& scale) { this->scale = scale; }
-	void setPosition(glm::vec3 position) { this->position = position; }
+	//Draws every instance in the set, their transforms replace the model's own
+	void drawInstanced(Window& window, Shader& shader, InstanceSet& instances);
+	//Queues every mesh with the model's transform, drawn when the renderer ends the frame.
+	//With a culler only the meshes inside its frustum are queued, with an occlusion or Hi-Z culler only the ones not hidden
+	void submit(IndirectRenderer& renderer, FrustumCuller* culler = nullptr, OcclusionCuller* occlusion = nullptr, HiZCuller* hiZ = nullptr);
+	//Queues every mesh posed by the animator, its palette goes into the shared SkinPalette. Meshes without
+	//bones follow the transform unchanged, so the whole model can go through the skinning shader
+	void submitSkinned(IndirectRenderer& renderer, SkinPalette& palette, const glm::mat4& transform, const Animator& animator);
+	//Adds every mesh as an occluder with the model's transform
+	void submitOccluder(OcclusionCuller& occlusion) const;
+	//Registers the textures of every mesh, the library still has to be built before drawing
+	void registerMaterials(MaterialLibrary& library);
+	//Records every mesh into the list, safe to call from any thread. The pipeline is bound by the caller
+	void record(CommandList& list) const { record(list, getTransform()); }
+	void record(CommandList& list, const glm::mat4& transform) const;
+	//Adds a mesh entity per mesh, all following the model's node
+	std::vector<Entity> spawn(EntityStore& store);
+
+	//Model space bounds of every mesh together
+	const AABB& getBounds() const { return bounds; }
+	const glm::vec4& getBoundingSphere() const { return boundingSphere; }
+	bool isSkinned() const { return skeleton.getBoneCount() > 0; }
+	const Skeleton& getSkeleton() const { return skeleton; }
+	const std::vector<CompressedClip>& getAnimations() const { return animations; }
 private:
+	//Tests the whole model's sphere first, then the mesh boxes four at a time into meshVisible,
+	//then the boxes left against the occlusion depth and the Hi-Z results. Returns false when the whole model is outside
+	bool cull(FrustumCuller& culler, OcclusionCuller* occlusion, HiZCuller* hiZ, const glm::mat4& transform);
+	void computeBounds();
 
 	unsigned int loadTexture(const std::string& filename);
 	std::vector<Mesh> meshes;
 	std::unordered_map<std::string, unsigned int> textures;
+	AABB bounds;
+	glm::vec4 boundingSphere;
+	//Scratch space of cull, kept to avoid allocating every frame
+	std::vector<AABB> meshBounds;
+	std::vector<unsigned char> meshVisible;
+	Skeleton skeleton;
+	std::vector<CompressedClip> animations;
 
 	std::string directory;
-	glm::vec3 position;
-	glm::vec3 scale = glm::vec3(1,1,1);
-	glm::fquat rotation = glm::fquat(1,0,0,0);
 	//Cache
 	static std::unordered_map<std::string, int> textureCache;
 };
 
-class Sprite : public Drawable
+class Sprite : public Drawable, public SceneObject
 {
 public:
 	Sprite(const std::string& filename);
 	Sprite(unsigned int texture);
 
 	void draw(Window& window, Shader& shader) override;
-	void setRotation(const glm::fquat& rot) { rotation = rot; }
-	void setScale(const glm::vec3& scale) { this->scale = scale; }
-	void setPosition(glm::vec3 position) { this->position = position; }
+	void drawInstanced(Window& window, Shader& shader, InstanceSet& instances);
+
+	unsigned int getTexture() const { return textureID; }
+	//For a sprite showing a render target, whose texture can change when the target is made again
+	void setTexture(unsigned int texture) { textureID = texture; }
+	//Adds a sprite entity following the sprite's node
+	Entity spawn(EntityStore& store) const;
+	static const AABB& getQuadBounds() { return quadBounds; }
+
+	static void bindVertexFormat();
+	static unsigned int getVertexBuffer() { return VBO; }
+	static bool findCachedTexture(const std::string& filename, unsigned int& id);
+	static unsigned int uploadTexture(const std::string& filename, const unsigned char* data, int width, int height);
 private:
-	glm::vec3 position = glm::vec3(0,0,0);
-	glm::vec3 scale = glm::vec3(1, 1, 1);
-	glm::fquat rotation = glm::fquat(1, 0, 0, 0);
+	static void createQuad();
+
 	unsigned int textureID;
 
 
@@ -48,6 +126,8 @@ private:
 	static unsigned int VAO;
 	static unsigned int EBO;
 	static std::unordered_map<std::string, unsigned int> textureCache;
+	//Model space box of the quad in verticesData
+	static const AABB quadBounds;
 
 	static float verticesData[20];
 	static unsigned int indices[6];
@@ -4,6 +4,18 @@
 #include <glad/glad.h>
 #include "Window.h"
 #include "Model.h"
+#include "Benchmark.h"
+#include "IndirectRenderer.h"
+#include "MaterialLibrary.h"
+#include "EntityStore.h"
+#include "SpriteBatch.h"
+#include "AssetLoader.h"
+#include "SkinPalette.h"
+#include "WaterClipmap.h"
+#include "FftOcean.h"
+#include "RippleField.h"
+#include "GerstnerWaves.h"
+#include "RenderGraph.h"
 
 class Window;
 
@@ -13,9 +25,18 @@ const char* vertexShaderS = R"(
 	layout (location = 1) in vec3 normal;
 	layout (location = 2) in vec2 uvCord;
 
-	uniform mat4 model;
-	uniform mat4 view;
-	uniform mat4 projection;
+	layout (std140) uniform FrameData
+	{
+		mat4 view;
+		mat4 projection;
+		vec4 viewPos;
+		float time;
+	};
+	layout (std140) uniform ObjectData
+	{
+		mat4 model;
+		mat4 normalMatrix;
+	};
 
 	out vec3 normala;
 	out vec2 uv;
@@ -25,8 +46,138 @@ const char* vertexShaderS = R"(
 	{
 		posOut = pos;
 		gl_Position = projection * view * model * vec4(pos, 1.0f);
-		normala = normalize(mat3(transpose(inverse(model))) * normal);
+		normala = normalize(mat3(normalMatrix) * normal);
+		uv = uvCord;
+	}
+)";
+
+const char* instancedVertexShaderS = R"(
+	#version 330 core
+	layout (location = 0) in vec3 pos;
+	layout (location = 1) in vec3 normal;
+	layout (location = 2) in vec2 uvCord;
+	layout (location = 3) in mat4 instanceModel;
+	layout (location = 7) in vec4 instanceTint;
+	layout (location = 8) in float instanceMaterial;
+
+	layout (std140) uniform FrameData
+	{
+		mat4 view;
+		mat4 projection;
+		vec4 viewPos;
+		float time;
+	};
+
+	out vec3 normala;
+	out vec2 uv;
+	out vec3 worldPos;
+	out vec4 tint;
+	
+	void main()
+	{
+		vec4 world = instanceModel * vec4(pos, 1.0f);
+		worldPos = world.xyz;
+		gl_Position = projection * view * world;
+		normala = normalize(mat3(transpose(inverse(instanceModel))) * normal);
+		uv = uvCord;
+		tint = instanceTint;
+	}
+)";
+
+const char* indirectVertexShaderS = R"(
+	#version 330 core
+	layout (location = 0) in vec3 pos;
+	layout (location = 1) in vec3 normal;
+	layout (location = 2) in vec2 uvCord;
+	layout (location = 9) in uint drawId;
+
+	uniform samplerBuffer drawData;
+	layout (std140) uniform FrameData
+	{
+		mat4 view;
+		mat4 projection;
+		vec4 viewPos;
+		float time;
+	};
+
+	out vec3 normala;
+	out vec2 uv;
+	out vec3 worldPos;
+	out vec4 tint;
+	flat out uint material;
+	
+	void main()
+	{
+		int base = int(drawId) * 8;
+		mat4 model = mat4(texelFetch(drawData, base), texelFetch(drawData, base + 1), texelFetch(drawData, base + 2), texelFetch(drawData, base + 3));
+		mat3 normalMatrix = mat3(texelFetch(drawData, base + 4).xyz, texelFetch(drawData, base + 5).xyz, texelFetch(drawData, base + 6).xyz);
+		vec4 world = model * vec4(pos, 1.0f);
+		worldPos = world.xyz;
+		gl_Position = projection * view * world;
+		normala = normalize(normalMatrix * normal);
 		uv = uvCord;
+		tint = vec4(1.0f);
+		material = uint(texelFetch(drawData, base + 7).x);
+	}
+)";
+
+//Same as the indirect shader with the position and normal blended from up to four bones of the SkinPalette
+const char* skinnedVertexShaderS = R"(
+	#version 330 core
+	layout (location = 0) in vec3 pos;
+	layout (location = 1) in vec3 normal;
+	layout (location = 2) in vec2 uvCord;
+	layout (location = 9) in uint drawId;
+	layout (location = 10) in uvec4 boneIds;
+	layout (location = 11) in vec4 boneWeights;
+
+	uniform samplerBuffer drawData;
+	uniform samplerBuffer bonePalette;
+	layout (std140) uniform FrameData
+	{
+		mat4 view;
+		mat4 projection;
+		vec4 viewPos;
+		float time;
+	};
+
+	out vec3 normala;
+	out vec2 uv;
+	out vec3 worldPos;
+	out vec4 tint;
+	flat out uint material;
+	
+	void main()
+	{
+		int base = int(drawId) * 8;
+		mat4 model = mat4(texelFetch(drawData, base), texelFetch(drawData, base + 1), texelFetch(drawData, base + 2), texelFetch(drawData, base + 3));
+		mat3 normalMatrix = mat3(texelFetch(drawData, base + 4).xyz, texelFetch(drawData, base + 5).xyz, texelFetch(drawData, base + 6).xyz);
+		vec4 params = texelFetch(drawData, base + 7);
+
+		//Bones are three rows each, whatever weight is missing from one keeps the identity so meshes without bones pass through
+		int palette = int(params.y);
+		float rest = 1.0f - (boneWeights.x + boneWeights.y + boneWeights.z + boneWeights.w);
+		vec4 row0 = vec4(rest, 0.0f, 0.0f, 0.0f);
+		vec4 row1 = vec4(0.0f, rest, 0.0f, 0.0f);
+		vec4 row2 = vec4(0.0f, 0.0f, rest, 0.0f);
+		for (int i = 0; i < 4; ++i)
+		{
+			int bone = (palette + int(boneIds[i])) * 3;
+			row0 += boneWeights[i] * texelFetch(bonePalette, bone);
+			row1 += boneWeights[i] * texelFetch(bonePalette, bone + 1);
+			row2 += boneWeights[i] * texelFetch(bonePalette, bone + 2);
+		}
+		vec4 local = vec4(pos, 1.0f);
+		vec3 skinnedPos = vec3(dot(row0, local), dot(row1, local), dot(row2, local));
+		vec3 skinnedNormal = vec3(dot(row0.xyz, normal), dot(row1.xyz, normal), dot(row2.xyz, normal));
+
+		vec4 world = model * vec4(skinnedPos, 1.0f);
+		worldPos = world.xyz;
+		gl_Position = projection * view * world;
+		normala = normalize(normalMatrix * skinnedNormal);
+		uv = uvCord;
+		tint = vec4(1.0f);
+		material = uint(params.x);
 	}
 )";
 
@@ -36,9 +187,18 @@ const char* outlineShaderSVert = R"(
 	layout (location = 1) in vec3 normal;
 	layout (location = 2) in vec2 uvCord;
 
-	uniform mat4 model;
-	uniform mat4 view;
-	uniform mat4 projection;
+	layout (std140) uniform FrameData
+	{
+		mat4 view;
+		mat4 projection;
+		vec4 viewPos;
+		float time;
+	};
+	layout (std140) uniform ObjectData
+	{
+		mat4 model;
+		mat4 normalMatrix;
+	};
 
 	void main()
 	{
@@ -64,6 +224,18 @@ const char* fragmentShaderS = R"(
 		float shininess;
 	};
 
+	layout (std140) uniform FrameData
+	{
+		mat4 view;
+		mat4 projection;
+		vec4 viewPos;
+		float time;
+	};
+	layout (std140) uniform ObjectData
+	{
+		mat4 model;
+		mat4 normalMatrix;
+	};
 	struct DirectionalLight
 	{
 		vec3 direction;
@@ -71,10 +243,11 @@ const char* fragmentShaderS = R"(
 		vec3 diffuse;
 		vec3 specular;
 	};
-	uniform mat4 model;
-	uniform vec3 viewPos;
+	layout (std140) uniform LightData
+	{
+		DirectionalLight directionalLight;
+	};
 	uniform Material material;
-	uniform DirectionalLight directionalLight;
 
 	out vec4 finalColor;
 
@@ -83,12 +256,189 @@ const char* fragmentShaderS = R"(
 		vec4 ambient = vec4(texture(material.texture_diffuse1, uv) * vec4(directionalLight.ambient, 1.0));
 		vec4 diffuse = vec4(max(dot(normala, -normalize(directionalLight.direction)),0.0) * texture(material.texture_diffuse1, uv));
 		vec3 reflected = normalize(reflect(-directionalLight.direction, normala));
-		vec4 specular = vec4(pow(max(dot(reflected, normalize(viewPos - vec3((model * vec4(posOut, 1.0)).xyz))), 0.0), 256) * texture(material.texture_specular1, uv));
+		vec4 specular = vec4(pow(max(dot(reflected, normalize(viewPos.xyz - vec3((model * vec4(posOut, 1.0)).xyz))), 0.0), 256) * texture(material.texture_specular1, uv));
 		
 		finalColor = ambient + diffuse + specular;
 	}
 )";
 
+const char* instancedFragmentShaderS = R"(
+	#version 330 core
+	in vec3 normala;
+	in vec2 uv;
+	in vec3 worldPos;
+	in vec4 tint;
+	struct Material
+	{
+		sampler2D texture_diffuse1;
+		sampler2D texture_diffuse2;
+		sampler2D texture_diffuse3;
+
+		sampler2D texture_specular1;
+		sampler2D texture_specular2;
+		sampler2D texture_specular3;
+		
+		float shininess;
+	};
+
+	layout (std140) uniform FrameData
+	{
+		mat4 view;
+		mat4 projection;
+		vec4 viewPos;
+		float time;
+	};
+	struct DirectionalLight
+	{
+		vec3 direction;
+		vec3 ambient;
+		vec3 diffuse;
+		vec3 specular;
+	};
+	layout (std140) uniform LightData
+	{
+		DirectionalLight directionalLight;
+	};
+	uniform Material material;
+
+	out vec4 finalColor;
+
+	void main()
+	{
+		vec4 ambient = vec4(texture(material.texture_diffuse1, uv) * vec4(directionalLight.ambient, 1.0));
+		vec4 diffuse = vec4(max(dot(normala, -normalize(directionalLight.direction)),0.0) * texture(material.texture_diffuse1, uv));
+		vec3 reflected = normalize(reflect(-directionalLight.direction, normala));
+		vec4 specular = vec4(pow(max(dot(reflected, normalize(viewPos.xyz - worldPos)), 0.0), 256) * texture(material.texture_specular1, uv));
+		
+		finalColor = (ambient + diffuse + specular) * tint;
+	}
+)";
+
+const char* indirectArrayFragmentShaderS = R"(
+	#version 330 core
+	in vec3 normala;
+	in vec2 uv;
+	in vec3 worldPos;
+	in vec4 tint;
+	flat in uint material;
+
+	layout (std140) uniform FrameData
+	{
+		mat4 view;
+		mat4 projection;
+		vec4 viewPos;
+		float time;
+	};
+	struct DirectionalLight
+	{
+		vec3 direction;
+		vec3 ambient;
+		vec3 diffuse;
+		vec3 specular;
+	};
+	layout (std140) uniform LightData
+	{
+		DirectionalLight directionalLight;
+	};
+	layout (std140) uniform MaterialData
+	{
+		uvec4 materials[256];
+	};
+	//Material entries are (diffuse array, diffuse layer, specular array, specular layer)
+	uniform sampler2DArray textureArrays[8];
+
+	vec4 sampleArray(uint array, uint layer)
+	{
+		//Sampler arrays can only be indexed with constants before 4.00
+		vec3 coord = vec3(uv, float(layer));
+		switch (array)
+		{
+			case 0u: return texture(textureArrays[0], coord);
+			case 1u: return texture(textureArrays[1], coord);
+			case 2u: return texture(textureArrays[2], coord);
+			case 3u: return texture(textureArrays[3], coord);
+			case 4u: return texture(textureArrays[4], coord);
+			case 5u: return texture(textureArrays[5], coord);
+			case 6u: return texture(textureArrays[6], coord);
+			case 7u: return texture(textureArrays[7], coord);
+		}
+		return vec4(0.0);
+	}
+
+	out vec4 finalColor;
+
+	void main()
+	{
+		uvec4 entry = materials[material];
+		vec4 diffuseColor = sampleArray(entry.x, entry.y);
+		vec4 specularColor = sampleArray(entry.z, entry.w);
+		vec4 ambient = vec4(diffuseColor * vec4(directionalLight.ambient, 1.0));
+		vec4 diffuse = vec4(max(dot(normala, -normalize(directionalLight.direction)),0.0) * diffuseColor);
+		vec3 reflected = normalize(reflect(-directionalLight.direction, normala));
+		vec4 specular = vec4(pow(max(dot(reflected, normalize(viewPos.xyz - worldPos)), 0.0), 256) * specularColor);
+		
+		finalColor = (ambient + diffuse + specular) * tint;
+	}
+)";
+
+const char* indirectBindlessFragmentShaderS = R"(
+	#version 400 core
+	#extension GL_ARB_bindless_texture : require
+	in vec3 normala;
+	in vec2 uv;
+	in vec3 worldPos;
+	in vec4 tint;
+	flat in uint material;
+
+	layout (std140) uniform FrameData
+	{
+		mat4 view;
+		mat4 projection;
+		vec4 viewPos;
+		float time;
+	};
+	struct DirectionalLight
+	{
+		vec3 direction;
+		vec3 ambient;
+		vec3 diffuse;
+		vec3 specular;
+	};
+	layout (std140) uniform LightData
+	{
+		DirectionalLight directionalLight;
+	};
+	layout (std140) uniform MaterialData
+	{
+		uvec4 materials[256];
+	};
+	//Material entries are the diffuse and specular handles split in two uints each, zero when missing
+
+	vec4 sampleHandle(uvec2 handle)
+	{
+		if (handle == uvec2(0u))
+		{
+			return vec4(0.0);
+		}
+		return texture(sampler2D(handle), uv);
+	}
+
+	out vec4 finalColor;
+
+	void main()
+	{
+		uvec4 entry = materials[material];
+		vec4 diffuseColor = sampleHandle(entry.xy);
+		vec4 specularColor = sampleHandle(entry.zw);
+		vec4 ambient = vec4(diffuseColor * vec4(directionalLight.ambient, 1.0));
+		vec4 diffuse = vec4(max(dot(normala, -normalize(directionalLight.direction)),0.0) * diffuseColor);
+		vec3 reflected = normalize(reflect(-directionalLight.direction, normala));
+		vec4 specular = vec4(pow(max(dot(reflected, normalize(viewPos.xyz - worldPos)), 0.0), 256) * specularColor);
+		
+		finalColor = (ambient + diffuse + specular) * tint;
+	}
+)";
+
 const char* outlineShader = R"(
 	#version 330 core
 	out vec4 col;
@@ -103,9 +453,18 @@ const char* spriteShader = R"(
 	layout (location = 0) in vec3 pos;
 	layout (location = 1) in vec2 texCoord;
 	
-	uniform mat4 view;
-	uniform mat4 projection;
-	uniform mat4 model;
+	layout (std140) uniform FrameData
+	{
+		mat4 view;
+		mat4 projection;
+		vec4 viewPos;
+		float time;
+	};
+	layout (std140) uniform ObjectData
+	{
+		mat4 model;
+		mat4 normalMatrix;
+	};
 
 	out vec2 tex;
 
@@ -132,12 +491,84 @@ const char* spriteFragShader = R"(
 	}
 )";
 
+const char* instancedSpriteShader = R"(
+	#version 330 core
+	layout (location = 0) in vec3 pos;
+	layout (location = 1) in vec2 texCoord;
+	layout (location = 3) in mat4 instanceModel;
+	layout (location = 7) in vec4 instanceTint;
+	
+	layout (std140) uniform FrameData
+	{
+		mat4 view;
+		mat4 projection;
+		vec4 viewPos;
+		float time;
+	};
+
+	out vec2 tex;
+	out vec4 tint;
+
+	void main()
+	{
+		gl_Position = projection * view * instanceModel * vec4(pos, 1.0f);
+		tex = texCoord;
+		tint = instanceTint;
+	}
+)";
+
+const char* instancedSpriteFragShader = R"(
+	#version 330 core
+	in vec2 tex;
+	in vec4 tint;
+	uniform sampler2D textureApply;
+
+	out vec4 col;
+	void main()
+	{
+		col = texture(textureApply, tex) * tint;
+		if (col.a < 0.05f)
+		{
+			discard;
+		}
+	}
+)";
+
+const char* spriteBatchShader = R"(
+	#version 330 core
+	layout (location = 0) in vec3 pos;
+	layout (location = 1) in vec2 texCoord;
+	layout (location = 2) in vec4 vertexTint;
+	
+	layout (std140) uniform FrameData
+	{
+		mat4 view;
+		mat4 projection;
+		vec4 viewPos;
+		float time;
+	};
+
+	out vec2 tex;
+	out vec4 tint;
+
+	void main()
+	{
+		gl_Position = projection * view * vec4(pos, 1.0f);
+		tex = texCoord;
+		tint = vertexTint;
+	}
+)";
+
 const char* fogShaderS = R"(
 	#version 330 core
 	in vec2 tex;
 	uniform sampler2D textureApply;
 	uniform sampler2D depthTexture;
-	uniform sampler2D skyTexture;
+	uniform samplerCube skyBox;
+	//Takes a point on the screen back to a direction from the camera, the view has no translation
+	uniform mat4 inverseViewProjection;
+	uniform float nearPlane;
+	uniform float farPlane;
 	
 	out vec4 col;
 
@@ -148,8 +579,10 @@ const char* fogShaderS = R"(
 	}
 	void main()
 	{
+		vec4 direction = inverseViewProjection * vec4(tex * 2.0f - 1.0f, 1.0f, 1.0f);
+		vec4 sky = texture(skyBox, direction.xyz / direction.w);
 		float depth = texture(depthTexture, tex).r;
-		float linearized = LinearizeDepth(depth, 0.1f, 20.0f) / 20.0f;
+		float linearized = LinearizeDepth(depth, nearPlane, farPlane) / farPlane;
 		float x = (tex.x - 0.5f) * 1.2f;
 		float y = (tex.y - 0.5f) * 1.2;
 		float alpha = 1;
@@ -164,15 +597,15 @@ const char* fogShaderS = R"(
 		}
 		if (depth == 1)
 		{
-			col = texture(skyTexture, tex);
+			col = sky;
 		}
 		else if (alpha < 0)
 		{
-			col = texture(skyTexture, tex);
+			col = sky;
 		}
 		else
 		{
-			col = mix(texture(skyTexture, tex),texture(textureApply, tex), alpha);
+			col = mix(sky,texture(textureApply, tex), alpha);
 		}
 	}
 )";
@@ -225,25 +658,86 @@ const char* GaussianBlurShader = R"(
 
 const char* waterShaderVert = R"(
 	#version 330 core
-	layout (location = 0) in vec2 thisPos;
-	layout (location = 1) in vec2 one;
-	layout (location = 2) in vec2 two;
+	layout (location = 0) in vec2 gridPos;
 
 	out vec3 normala;
 	out vec3 posOut;
-	uniform float time;
-	uniform mat4 model;
-	uniform mat4 view;
-	uniform mat4 projection;
+	out vec2 oceanUV;
+	layout (std140) uniform FrameData
+	{
+		mat4 view;
+		mat4 projection;
+		vec4 viewPos;
+		float time;
+	};
+	layout (std140) uniform ObjectData
+	{
+		mat4 model;
+		mat4 normalMatrix;
+	};
+	//Origin and spacing of the clipmap level, and half the size of the whole surface
+	uniform vec3 clipLevel;
+	uniform vec2 halfExtent;
+	//FFT ocean tile in place of the sine wave, patch is its size in world units
+	uniform bool useOcean;
+	uniform sampler2D oceanDisplacement;
+	uniform float oceanPatch;
+	//Gerstner waves otherwise, the same ones GerstnerWaves samples on the CPU
+	layout (std140) uniform WaveData
+	{
+		vec4 waveShape[8];
+		vec4 waveSize[8];
+		int waveCount;
+	};
 
 	void main()
 	{
-		float z = sin(3 * time * ((thisPos.x + thisPos.y))) / 3.0f;
-		float zOne = sin(3 * time * ((one.x + one.y))) / 3.0f;
-		float zTwo = sin(3 * time * ((two.x + two.y))) / 3.0f;
-		vec3 position = vec3(thisPos.x, thisPos.y, z);
-		vec3 crossed = cross(vec3(one - thisPos,zOne - z), vec3(two - thisPos,zTwo - z));
-		normala = normalize(mat3(transpose(inverse(model))) * -crossed);
+		//Over the last cells before the edge of the 63 vertex lattice the odd vertices slide onto the
+		//coarser level's, so at the edge both levels have the same vertices
+		vec2 fromCentre = abs(gridPos - 31.0f);
+		float morph = clamp((max(fromCentre.x, fromCentre.y) - 25.0f) / 6.0f, 0.0f, 1.0f);
+		vec2 grid = gridPos - mod(gridPos, 2.0f) * morph;
+		vec2 thisPos = clamp(clipLevel.xy + grid * clipLevel.z, -halfExtent, halfExtent);
+
+		vec3 position;
+		//The waves are in world units while the model scales the grid, their y is up which is -z here
+		vec3 worldPerObject = vec3(length(model[0].xyz), length(model[1].xyz), length(model[2].xyz));
+		if (useOcean)
+		{
+			oceanUV = thisPos * worldPerObject.xy / oceanPatch;
+			//Coarser levels read coarser mipmaps, a level further at the morphed edge so both sides agree
+			float texel = oceanPatch / textureSize(oceanDisplacement, 0).x;
+			float lod = max(0.0f, log2(clipLevel.z * worldPerObject.x / texel) + morph);
+			vec3 displacement = textureLod(oceanDisplacement, oceanUV, lod).xyz;
+			position = vec3(thisPos + displacement.xz / worldPerObject.xy, -displacement.y / worldPerObject.z);
+			//The fragment shader reads the normal map
+			normala = vec3(0.0f);
+		}
+		else
+		{
+			//Wave x and z run along object x and y. The normal crosses the tangents along z and x, which are
+			//(-bunch.y, slope.y, 1 - bunch.z) and (1 - bunch.x, slope.x, -bunch.y)
+			vec2 rest = thisPos * worldPerObject.xy;
+			vec2 moved = vec2(0.0f);
+			float height = 0.0f;
+			vec2 slope = vec2(0.0f);
+			vec3 bunch = vec3(0.0f);
+			for (int i = 0; i < waveCount; ++i)
+			{
+				vec2 direction = waveShape[i].xy;
+				float phase = waveShape[i].z * dot(direction, rest) - waveShape[i].w * time;
+				float sine = sin(phase);
+				float cosine = cos(phase);
+				moved += direction * waveSize[i].y * cosine;
+				height += waveSize[i].x * sine;
+				slope += direction * waveShape[i].z * waveSize[i].x * cosine;
+				bunch += vec3(direction.x * direction.x, direction.x * direction.y, direction.y * direction.y) * waveShape[i].z * waveSize[i].y * sine;
+			}
+			position = vec3(thisPos + moved / worldPerObject.xy, -height / worldPerObject.z);
+			vec3 waveNormal = vec3(-(bunch.y * slope.y + (1.0f - bunch.z) * slope.x), (1.0f - bunch.x) * (1.0f - bunch.z) - bunch.y * bunch.y, -(bunch.y * slope.x + (1.0f - bunch.x) * slope.y));
+			normala = normalize(mat3(normalMatrix) * (worldPerObject * vec3(waveNormal.x, waveNormal.z, -waveNormal.y)));
+			oceanUV = vec2(0.0f);
+		}
 		posOut = position;
 		gl_Position = projection * view * model * vec4(position,1.0f);
 	}
@@ -254,6 +748,19 @@ const char* waterShaderFrag = R"(
 	out vec4 col;
 	in vec3 normala;
 	in vec3 posOut;
+	in vec2 oceanUV;
+	layout (std140) uniform FrameData
+	{
+		mat4 view;
+		mat4 projection;
+		vec4 viewPos;
+		float time;
+	};
+	layout (std140) uniform ObjectData
+	{
+		mat4 model;
+		mat4 normalMatrix;
+	};
 	struct DirectionalLight
 	{
 		vec3 direction;
@@ -261,67 +768,53 @@ const char* waterShaderFrag = R"(
 		vec3 diffuse;
 		vec3 specular;
 	};
-
-	uniform DirectionalLight directionalLight;
-	uniform mat4 model;
+	layout (std140) uniform LightData
+	{
+		DirectionalLight directionalLight;
+	};
 	uniform samplerCube cubeMap;
-	uniform vec3 viewPos;
+	uniform bool useOcean;
+	uniform sampler2D oceanNormals;
+	//Local ripples over part of the surface, heights in world units, area is origin and size in object space
+	uniform bool useRipples;
+	uniform sampler2D rippleHeights;
+	uniform vec4 rippleArea;
 
 	void main()
 	{
-		col = mix(vec4(0.1,0.5,0.5,1.0f),texture(cubeMap, reflect(normalize(viewPos - vec3(model * vec4(posOut, 1.0))), normalize(normala))), 0.7f);
+		vec3 normal = normalize(normala);
+		vec3 worldPerObject = vec3(length(model[0].xyz), length(model[1].xyz), length(model[2].xyz));
+		if (useOcean)
+		{
+			//World space slopes, scaled into object space so the normal matrix undoes the scale again
+			vec3 oceanNormal = texture(oceanNormals, oceanUV).xyz;
+			normal = normalize(mat3(normalMatrix) * (worldPerObject * vec3(oceanNormal.x, oceanNormal.z, -oceanNormal.y)));
+		}
+		vec2 rippleUV = (posOut.xy - rippleArea.xy) / rippleArea.zw;
+		if (useRipples && all(greaterThanEqual(rippleUV, vec2(0.0f))) && all(lessThanEqual(rippleUV, vec2(1.0f))))
+		{
+			//The ripples are finer than the grid under them, so they only tilt the normal, by their
+			//central difference slopes along the world directions of object x and y
+			vec2 texel = 1.0f / vec2(textureSize(rippleHeights, 0));
+			vec2 spacing = 2.0f * rippleArea.zw * texel * worldPerObject.xy;
+			float slopeX = (texture(rippleHeights, rippleUV + vec2(texel.x, 0.0f)).r - texture(rippleHeights, rippleUV - vec2(texel.x, 0.0f)).r) / spacing.x;
+			float slopeY = (texture(rippleHeights, rippleUV + vec2(0.0f, texel.y)).r - texture(rippleHeights, rippleUV - vec2(0.0f, texel.y)).r) / spacing.y;
+			normal = normalize(normal - slopeX * normalize(mat3(model)[0]) - slopeY * normalize(mat3(model)[1]));
+		}
+		col = mix(vec4(0.1,0.5,0.5,1.0f),texture(cubeMap, reflect(normalize(viewPos.xyz - vec3(model * vec4(posOut, 1.0))), normal)), 0.7f);
 		vec4 ambient = col * vec4(directionalLight.ambient, 1.0f);
-		vec4 diffuse = vec4(max(dot(normala, -normalize(directionalLight.direction)),0.0) * col);
-		vec3 reflected = normalize(reflect(-directionalLight.direction, normala));
-		vec4 specular = vec4(pow(max(dot(reflected, normalize(viewPos - vec3((model * vec4(posOut, 1.0)).xyz))), 0.0), 32) * col);
+		vec4 diffuse = vec4(max(dot(normal, -normalize(directionalLight.direction)),0.0) * col);
+		vec3 reflected = normalize(reflect(-directionalLight.direction, normal));
+		vec4 specular = vec4(pow(max(dot(reflected, normalize(viewPos.xyz - vec3((model * vec4(posOut, 1.0)).xyz))), 0.0), 32) * col);
 		col = ambient + diffuse + specular;
 	}
 )";
 
-const char* cubemapVertS = R"(
-	#version 330 core
-	layout (location = 0) in vec3 pos;
-	uniform mat4 projection;
-	uniform mat4 view;
-	
-	out vec3 TexCoord;
-	void main()
-	{
-		TexCoord = pos;
-		vec4 ayy = projection * mat4(mat3(view)) * vec4(pos,1.0f);
-		gl_Position = vec4(ayy.xyww);
-	}
-)";
-
-const char* cubemapFragS = R"(
-	#version 330 core
-	in vec3 TexCoord;
-	uniform samplerCube skybox;
-	out vec4 col;
-	void main()
-	{
-		col = texture(skybox, TexCoord);
-	}
-)";
-
-
-
-struct WaterTriData
-{
-	float thisX;
-	float thisY;
-
-	float oneX;
-	float oneY;
-
-	float twoX;
-	float twoY;
-};
-
 class SkyBox : public Drawable
 {
 public:
-	SkyBox(const std::vector<std::string>& faces);
+	//Takes a cube map such as the one AssetLoader::loadCubeMap makes
+	SkyBox(unsigned int cubeMap);
 	void draw(Window& window, Shader& shader) override;
 	int getTexture() const { return texture; }
 private:
@@ -332,26 +825,32 @@ private:
 	static float vertices[];
 };
 
-class WaterBody : public Drawable
+class WaterBody : public Drawable, public SceneObject
 {
 public:
-	WaterBody(float width, float height, int nrPerAxis, SkyBox& box);
+	//cellSize is the spacing of the finest clipmap level around the camera
+	WaterBody(float width, float height, float cellSize, SkyBox& box);
 	void draw(Window& win, Shader& shader) override;
-	void setRotation(const glm::fquat& rot) { rotation = rot; }
-	void setScale(const glm::vec3& scale) { this->scale = scale; }
-	void setPosition(glm::vec3 position) { this->position = position; }
-	glm::fquat getRotation() const { return rotation; }
+	//Adds a water entity following the body's node, drawing the same surface
+	Entity spawn(EntityStore& store) const { return store.createWater(node, water, bounds); }
+	//Replaces the Gerstner waves with the ocean's tile repeated over the surface, call before spawn.
+	//The ocean is in world units and the body's height is taken to be unscaled
+	void setOcean(const FftOcean* ocean);
+	//Replaces the default waves, call before spawn. The waves are in world units like the ocean
+	void setWaves(const GerstnerWaves& waves);
+	//World height of the surface over each world position and, if normals is not null, its world
+	//normal, at time seconds, the shader's frame time. Only the Gerstner waves are sampled, not the
+	//ocean or the ripples, and the surface is taken to be level
+	void sampleSurface(const glm::vec3* positions, size_t count, float time, float* heights, glm::vec3* normals) const;
+	//Adds the field's ripples to the surface's shading, call before spawn
+	void setRipples(const RippleField* ripples) { water.ripples = ripples; }
 private:
-	std::vector<WaterTriData> getVertices(float width, float height, int nrPerAxis = 10);
-	unsigned int VAO;
-	unsigned int VBO;
-	unsigned int skyboxTexture;
-
-	glm::vec3 position = glm::vec3(0, 0, 0);
-	glm::vec3 scale = glm::vec3(1, 1, 1);
-	glm::fquat rotation = glm::fquat(1, 0, 0, 0);
+	void updateBounds();
 
-	int verticesNum = 0;
+	WaterClipmap clipmap;
+	GerstnerWaves waves;
+	WaterComponent water;
+	AABB bounds;
 };
 
 #include <glm/gtx/quaternion.hpp>
@@ -359,202 +858,74 @@ private:
 
 void WaterBody::draw(Window& window, Shader& shader)
 {
-	shader.use();
-
-	glm::mat4 projection = window.getProjection();
-	glm::mat4 view = window.getView();
-
-	glm::mat4 translationn = glm::translate(glm::mat4(1.0f), position);
-	glm::mat4 scalee = glm::scale(glm::mat4(1.0f), scale);
-	glm::mat4 rotationn = glm::toMat4(rotation);
-
-	glUniformMatrix4fv(glGetUniformLocation(shader.getID(), "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-	glUniformMatrix4fv(glGetUniformLocation(shader.getID(), "view"), 1, GL_FALSE, glm::value_ptr(view));
-	glUniformMatrix4fv(glGetUniformLocation(shader.getID(), "model"), 1, GL_FALSE, glm::value_ptr(translationn * rotationn * scalee));
-	glUniform3f(glGetUniformLocation(shader.getID(), "viewPos"), window.getCameraPosition().x, window.getCameraPosition().y, window.getCameraPosition().z);
-
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxTexture);
-	//setting a static directional light for now
-
-	glUniform1i(glGetUniformLocation(shader.getID(), "cubeMap"), 1);
-
-	glUniform3f(glGetUniformLocation(shader.getID(), "directionalLight.direction"), sin(1.5f), -2, cos(1.5f));
-	glUniform3f(glGetUniformLocation(shader.getID(), "directionalLight.ambient"), 0.2f, 0.2f, 0.2f);
-	glUniform3f(glGetUniformLocation(shader.getID(), "directionalLight.diffuse"), 0.5f, 0.5f, 0.5f);
-	glUniform3f(glGetUniformLocation(shader.getID(), "directionalLight.specular"), 1, 1, 1);
-
-	glUniform1f(glGetUniformLocation(shader.getID(), "time"), glfwGetTime());
-	glBindVertexArray(VAO);
-	glDrawArrays(GL_TRIANGLES, 0, verticesNum);
+	EntityStore::drawWater(window, shader, water, getTransform(), getNormalMatrix());
 }
 
-WaterBody::WaterBody(float width, float height, int nrPerAxis, SkyBox& skyboxTexture)
+WaterBody::WaterBody(float width, float height, float cellSize, SkyBox& skyboxTexture) : clipmap(width, height, cellSize), waves(GerstnerWaves::makeDefault())
 {
-	this->skyboxTexture = skyboxTexture.getTexture();
-	std::vector<WaterTriData> vertices = getVertices(width, height, nrPerAxis);
-	verticesNum = vertices.size();
-
-	glGenVertexArrays(1, &VAO);
-	glBindVertexArray(VAO);
-	glGenBuffers(1, &VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(VertexData) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
-	
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(WaterTriData), (void*)0);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(WaterTriData), (void*)(sizeof(float) * 2));
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(WaterTriData), (void*)(sizeof(float) * 4));
-
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glEnableVertexAttribArray(2);
+	water.clipmap = &clipmap;
+	water.cubeMap = skyboxTexture.getTexture();
+	water.waves = &waves;
+	bounds.min = glm::vec3(-width / 2, -height / 2, 0.0f);
+	bounds.max = glm::vec3(width / 2, height / 2, 0.0f);
+	updateBounds();
 }
 
-std::vector<WaterTriData> WaterBody::getVertices(float width, float height, int nrPerAxis)
+void WaterBody::setOcean(const FftOcean* ocean)
 {
-	std::vector<WaterTriData> vertices;
-	float xStep = width / nrPerAxis;
-	float yStep = height / nrPerAxis;
-	for (int i = 0; i < nrPerAxis; ++i)
-		for (int j = 0; j < nrPerAxis; ++j)
-		{
-			WaterTriData vertex1;
-			vertex1.thisX = -width / 2 + i * xStep;
-			vertex1.thisY = -height / 2 + j * yStep;
-
-			vertex1.oneX = -width / 2 + i * xStep + xStep;
-			vertex1.oneY = -height / 2 + j * yStep;
-
-			vertex1.twoX = -width / 2 + i * xStep + xStep;
-			vertex1.twoY = -height / 2 + j * yStep + yStep;
-
-			WaterTriData vertex2;
-			vertex2.twoX = -width / 2 + i * xStep;
-			vertex2.twoY = -height / 2 + j * yStep;
-
-			vertex2.thisX = -width / 2 + i * xStep + xStep;
-			vertex2.thisY = -height / 2 + j * yStep;
-
-			vertex2.oneX = -width / 2 + i * xStep + xStep;
-			vertex2.oneY = -height / 2 + j * yStep + yStep;
-
-			WaterTriData vertex3;
-			vertex3.oneX = -width / 2 + i * xStep;
-			vertex3.oneY = -height / 2 + j * yStep;
-
-			vertex3.twoX = -width / 2 + i * xStep + xStep;
-			vertex3.twoY = -height / 2 + j * yStep;
-
-			vertex3.thisX = -width / 2 + i * xStep + xStep;
-			vertex3.thisY = -height / 2 + j * yStep + yStep;
-
-			WaterTriData vertex21;
-			vertex21.thisX = -width / 2 + i * xStep;
-			vertex21.thisY = -height / 2 + j * yStep;
-
-			vertex21.oneX = -width / 2 + i * xStep + xStep;
-			vertex21.oneY = -height / 2 + j * yStep + yStep;
-
-			vertex21.twoX = -width / 2 + i * xStep;
-			vertex21.twoY = -height / 2 + j * yStep + yStep;
-
-			WaterTriData vertex22;
-			vertex22.twoX = -width / 2 + i * xStep;
-			vertex22.twoY = -height / 2 + j * yStep;
-
-			vertex22.thisX = -width / 2 + i * xStep + xStep;
-			vertex22.thisY = -height / 2 + j * yStep + yStep;
-
-			vertex22.oneX = -width / 2 + i * xStep;
-			vertex22.oneY = -height / 2 + j * yStep + yStep;
-
-			WaterTriData vertex23;
-			vertex23.oneX = -width / 2 + i * xStep;
-			vertex23.oneY = -height / 2 + j * yStep;
-
-			vertex23.twoX = -width / 2 + i * xStep + xStep;
-			vertex23.twoY = -height / 2 + j * yStep + yStep;
-
-			vertex23.thisX = -width / 2 + i * xStep;
-			vertex23.thisY = -height / 2 + j * yStep + yStep;
-
-			vertices.push_back(vertex1);
-			vertices.push_back(vertex2);
-			vertices.push_back(vertex3);
-			vertices.push_back(vertex21);
-			vertices.push_back(vertex22);
-			vertices.push_back(vertex23);
-		}
-	return vertices;
+	water.ocean = ocean;
+	updateBounds();
 }
 
-class FrameBuffer
+void WaterBody::setWaves(const GerstnerWaves& waves)
 {
-public:
-	FrameBuffer(int x, int y, int width, int height, bool depthstencil);
-	void use() const;
-	void reset(int width, int height) const;
-	unsigned int getTexture() const { return texture; }
-	unsigned int getDepthTexture() const { return depthTexture; }
-private:
-	unsigned int x;
-	unsigned int y;
-	unsigned int width;
-	unsigned int height;
-	unsigned int fbo;
-	unsigned int texture;
-	unsigned int depthTexture;
-};
-
-FrameBuffer::FrameBuffer(int x, int y, int width, int height, bool depthStencil)
-{
-	this->x = x;
-	this->y = y;
-	this->width = width;
-	this->height = height;
-	glGenFramebuffers(1, &fbo);
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-	glGenTextures(1, &texture);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, texture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
-
-	if (depthStencil)
-	{
-		glGenTextures(1, &depthTexture);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, depthTexture);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0,GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, 0);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
-	}
-	unsigned int a = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-	{
-		throw std::exception("Framebuffer incomplete!");
-	}
-	
-	glBindRenderbuffer(GL_RENDERBUFFER, 0);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
+	this->waves = waves;
+	updateBounds();
 }
 
-void FrameBuffer::use() const
+void WaterBody::updateBounds()
 {
-	glViewport(x, y, width, height);
-	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	//The vertex shader moves the surface up and down by this much at most
+	float height = water.ocean ? water.ocean->getMaxHeight() : waves.getMaxHeight();
+	bounds.min.z = -height;
+	bounds.max.z = height;
+	SceneGraph::get().setBounds(node, bounds);
 }
 
-void FrameBuffer::reset(int width, int height) const
+void WaterBody::sampleSurface(const glm::vec3* positions, size_t count, float time, float* heights, glm::vec3* normals) const
 {
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glViewport(0, 0, width, height);
+	//The waves are in world units across the surface, the model scales the grid and turns its -z up
+	glm::mat4 model = getTransform();
+	glm::mat4 toObject = glm::inverse(model);
+	glm::mat3 normalMatrix = glm::mat3(getNormalMatrix());
+	glm::vec3 worldPerObject(glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2])));
+	//Blocks small enough for the stack
+	const size_t blockSize = 256;
+	float blockX[blockSize];
+	float blockZ[blockSize];
+	float blockHeights[blockSize];
+	glm::vec3 blockNormals[blockSize];
+	for (size_t first = 0; first < count; first += blockSize)
+	{
+		size_t size = std::min(blockSize, count - first);
+		for (size_t i = 0; i < size; ++i)
+		{
+			glm::vec4 position = toObject * glm::vec4(positions[first + i], 1.0f);
+			blockX[i] = position.x * worldPerObject.x;
+			blockZ[i] = position.y * worldPerObject.y;
+		}
+		waves.sample(blockX, blockZ, size, time, blockHeights, normals ? blockNormals : nullptr);
+		for (size_t i = 0; i < size; ++i)
+		{
+			glm::vec3 surface(blockX[i] / worldPerObject.x, blockZ[i] / worldPerObject.y, -blockHeights[i] / worldPerObject.z);
+			heights[first + i] = (model * glm::vec4(surface, 1.0f)).y;
+			if (normals)
+			{
+				glm::vec3 normal = blockNormals[i];
+				normals[first + i] = glm::normalize(normalMatrix * (worldPerObject * glm::vec3(normal.x, normal.z, -normal.y)));
+			}
+		}
+	}
 }
 
 #include "stb_image.h"
@@ -608,32 +979,13 @@ void SkyBox::draw(Window& window, Shader& shader)
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
 	glBindVertexArray(VAO);
-	glUniformMatrix4fv(glGetUniformLocation(shader.getID(), "projection"), 1, GL_FALSE, glm::value_ptr(window.getProjection()));
-	glUniformMatrix4fv(glGetUniformLocation(shader.getID(), "view"), 1, GL_FALSE, glm::value_ptr(window.getView()));
+	window.bindFrameData();
 
 	glDrawArrays(GL_TRIANGLES, 0, sizeof(vertices) / sizeof(float));
 }
 
-SkyBox::SkyBox(const std::vector<std::string>& faces)
+SkyBox::SkyBox(unsigned int cubeMap) : texture(cubeMap)
 {
-	glGenTextures(1, &texture);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
-
-	for (int i = 0; i < faces.size(); ++i)
-	{
-		int width, height, channels;
-		unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &channels, 0);
-
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-		stbi_image_free(data);
-	}
-
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
 	glGenVertexArrays(1, &VAO);
 	glBindVertexArray(VAO);
 	glGenBuffers(1, &VBO);
@@ -643,78 +995,331 @@ SkyBox::SkyBox(const std::vector<std::string>& faces)
 	glEnableVertexAttribArray(0);
 }
 
-int main()
+bool hasArgument(int argc, char** argv, const std::string& argument)
 {
+	for (int i = 1; i < argc; ++i)
+	{
+		if (argument == argv[i])
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+int main(int argc, char** argv)
+{
+	if (hasArgument(argc, argv, "--bench-math"))
+	{
+		runMathBenchmark();
+		return 0;
+	}
+	if (hasArgument(argc, argv, "--bench-bvh"))
+	{
+		runBvhBenchmark();
+		return 0;
+	}
+	if (hasArgument(argc, argv, "--bench-occlusion"))
+	{
+		runOcclusionBenchmark();
+		return 0;
+	}
+	if (hasArgument(argc, argv, "--bench-animation"))
+	{
+		runAnimationBenchmark();
+		return 0;
+	}
+	if (hasArgument(argc, argv, "--bench-ocean"))
+	{
+		runOceanBenchmark();
+		return 0;
+	}
+	if (hasArgument(argc, argv, "--bench-waves"))
+	{
+		runWaveBenchmark();
+		return 0;
+	}
 	Window window(1980, 1080, "OPENGL", true, true);
+	//The model, the sprite textures and the sky box faces decode on the job system while the shaders are
+	//set up, each upload runs on this thread the next time the loader is pumped
+	AssetLoader& loader = AssetLoader::get();
+	Task<std::unique_ptr<Model>> modelLoad = loader.loadModel("backpack.obj");
+	Task<unsigned int> windowLoad = loader.loadTexture("window.png", TextureUsage::Sprite);
+	Task<unsigned int> shipLoad = loader.loadTexture("ship.png", TextureUsage::Sprite, true);
+	Task<unsigned int> skyLoad = loader.loadCubeMap({ "right.png", "left.png", "top.png", "bottom.png", "front.png", "back.png" });
+	//A grid of animated copies of a rigged model, skinned on the GPU, with --skinned
+	bool useSkinning = hasArgument(argc, argv, "--skinned");
+	Task<std::unique_ptr<Model>> skinnedLoad;
+	if (useSkinning)
+	{
+		skinnedLoad = loader.loadModel("cube.fbx");
+	}
 	Shader shader(vertexShaderS, fragmentShaderS);
 	Shader shader2(outlineShaderSVert, outlineShader);
 	Shader spriteShaderProg(spriteShader, spriteFragShader);
 	Shader postProcess(spriteShader, GaussianBlurShader);
 	Shader waterShader(waterShaderVert, waterShaderFrag);
-	Shader skyboxShader(cubemapVertS, cubemapFragS);
 	Shader fogShader(spriteShader, fogShaderS);
-	SkyBox skay(std::vector<std::string>{"right.png", "left.png", "top.png", "bottom.png", "front.png", "back.png"});
-	Model model("backpack.obj");
-	Sprite sprite("window.png");
-	WaterBody water(2, 2, 30, skay);
-	water.setPosition(glm::vec3(0, -0.5f, 0));
+	SkyBox skay(loader.wait(skyLoad));
+	std::unique_ptr<Model> loadedModel = loader.wait(modelLoad);
+	Model& model = *loadedModel;
+	Sprite sprite(loader.wait(windowLoad));
+	//The water and the ship floating on it hang off one unscaled node, moving it moves both
+	SceneObject sea;
+	sea.setPosition(glm::vec3(0, -0.5f, 0));
+	//The clipmap keeps the cells around the camera the size the old 2 by 2 patch of 30 cells had, however far the sea goes
+	WaterBody water(40, 40, 2.0f / 30, skay);
+	water.setParent(sea);
 	water.setRotation(glm::angleAxis(glm::radians(90.0f), glm::vec3(1, 0, 0)) * water.getRotation());
-	FrameBuffer frameBuffer(0, 0, 1980, 1080, true);
-	Sprite renderedToScreen(frameBuffer.getTexture());
-	FrameBuffer skyBoxBuffer(0, 0, 1980, 1080, false);
-	stbi_set_flip_vertically_on_load(true);
-	Sprite ship("ship.png");
-	stbi_set_flip_vertically_on_load(false);
+	//The sea is a simulated FFT ocean with --fft-ocean, stepped on the CPU every frame
+	std::unique_ptr<FftOcean> ocean;
+	if (hasArgument(argc, argv, "--fft-ocean"))
+	{
+		ocean = std::make_unique<FftOcean>();
+		water.setOcean(ocean.get());
+	}
+	//With --ripples the ship sails in a circle and leaves a wake on a patch of the sea around it
+	std::unique_ptr<RippleField> ripples;
+	if (hasArgument(argc, argv, "--ripples"))
+	{
+		//12 by 12 of the sea's units, in the water's object space
+		ripples = std::make_unique<RippleField>(glm::vec2(-6.0f / 30), glm::vec2(12.0f / 30));
+		water.setRipples(ripples.get());
+	}
+	Sprite ship(loader.wait(shipLoad));
 	model.setScale(glm::vec3(0.2f, 0.2f, 0.2f));
 	model.setPosition(glm::vec3(0, 0, -1));
 	water.setScale(glm::vec3(30, 30, 1));
-	ship.setPosition(glm::vec3(1, 0, 1));
+	ship.setParent(sea);
+	ship.setPosition(glm::vec3(1, 0.5f, 1));
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	if (hasArgument(argc, argv, "--bench-instancing"))
+	{
+		Shader instancedShader(instancedVertexShaderS, instancedFragmentShaderS);
+		Shader instancedSpriteShaderProg(instancedSpriteShader, instancedSpriteFragShader);
+		runInstancingBenchmark(window, model, ship, shader, instancedShader, spriteShaderProg, instancedSpriteShaderProg);
+		return 0;
+	}
+	if (hasArgument(argc, argv, "--bench-sprite-batch"))
+	{
+		Shader spriteBatchShaderProg(spriteBatchShader, instancedSpriteFragShader);
+		runSpriteBatchBenchmark(window, ship, sprite, spriteShaderProg, spriteBatchShaderProg);
+		return 0;
+	}
+	if (hasArgument(argc, argv, "--bench-command-lists"))
+	{
+		runCommandListBenchmark(window, model, shader);
+		return 0;
+	}
+	//Opaque meshes are submitted with multi draw indirect with --indirect, one draw per mesh otherwise or on a 3.3 context
+	bool useIndirect = hasArgument(argc, argv, "--indirect");
+	//The model hides its own back meshes from itself, rasterized on the CPU each frame with --occlusion
+	bool useOcclusion = hasArgument(argc, argv, "--occlusion");
+	OcclusionCuller occlusion;
+	//Meshes found behind the depth of an earlier frame are skipped with --hiz, tested on the GPU and read back a frame or more later
+	bool useHiZ = hasArgument(argc, argv, "--hiz");
+	//Its pyramid matches the depth target, so it is made again when the window is resized
+	glm::uvec2 hiZSize(window.getWidth(), window.getHeight());
+	std::unique_ptr<HiZCuller> hiZ = std::make_unique<HiZCuller>(hiZSize.x, hiZSize.y);
+	//Every material of the model goes into one library, so the multi draw is a single call
+	MaterialLibrary materialLibrary;
+	model.registerMaterials(materialLibrary);
+	std::unique_ptr<Model> skinnedModel;
+	if (useSkinning)
+	{
+		skinnedModel = loader.wait(skinnedLoad);
+		skinnedModel->registerMaterials(materialLibrary);
+	}
+	materialLibrary.build();
+	const char* indirectFragmentShaderS = materialLibrary.getMode() == MaterialMode::Bindless ? indirectBindlessFragmentShaderS : indirectArrayFragmentShaderS;
+	Shader indirectShader(indirectVertexShaderS, indirectFragmentShaderS);
+	IndirectRenderer indirectRenderer;
+	indirectRenderer.setIndirect(useIndirect);
+	indirectRenderer.setMaterialLibrary(&materialLibrary);
+	//Every copy has its own animator, all their palettes go up in one buffer and all their meshes in one multi draw
+	Shader skinnedShader(skinnedVertexShaderS, indirectFragmentShaderS);
+	IndirectRenderer skinnedRenderer;
+	skinnedRenderer.setIndirect(useIndirect);
+	skinnedRenderer.setMaterialLibrary(&materialLibrary);
+	SkinPalette skinPalette;
+	std::vector<Animator> animators;
+	std::vector<glm::mat4> skinnedTransforms;
+	if (skinnedModel)
+	{
+		for (int i = 0; i < 64; ++i)
+		{
+			animators.push_back(Animator(skinnedModel->getSkeleton(), skinnedModel->getAnimations()));
+			animators.back().play(0);
+			animators.back().setTime(i * 0.1f);
+			glm::vec3 position(i % 8 - 3.5f, 0, -3 - i / 8);
+			skinnedTransforms.push_back(glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.2f, 0.2f, 0.2f)));
+		}
+	}
+	//The frame is driven from the packed entity arrays, only the outline pass and the screen quads still draw through Drawable
+	EntityStore entities;
+	model.spawn(entities);
+	water.spawn(entities);
+	ship.spawn(entities);
+	sprite.spawn(entities);
+	SpriteBatch spriteBatch;
+	Shader spriteBatchShaderProg(spriteBatchShader, instancedSpriteFragShader);
 	float elapsedTime = 0;
-	float time = glfwGetTime();
-	while (!window.shouldClose())
+	//The frame as a render graph. The passes are declared once and run in the order their targets
+	//need, the scene goes into targets the size of the window and is fogged onto it, with the sky looked
+	//up straight from the cube map wherever the scene is far away. The targets come from the pool,
+	//which drops the textures of old window sizes a few frames after a resize
+	RenderTargetPool targetPool;
+	RenderGraph frameGraph(targetPool);
+	RenderResource sceneColor;
+	RenderResource sceneDepth;
+	const float nearPlane = 0.1f;
+	const float farPlane = 20.0f;
+	frameGraph.addPass("scene", [&](RenderPassBuilder& builder)
+	{
+		sceneColor = builder.create("scene color", { TargetFormat::RGB8 });
+		sceneDepth = builder.create("scene depth", { TargetFormat::Depth24Stencil8 });
+	}, [&]()
 	{
-		float currentFrame = glfwGetTime();
-		elapsedTime = currentFrame - time;
-		window.processEvents(elapsedTime);
-		frameBuffer.use();
 		window.enableFaceCulling();
 		window.clear();
 		glStencilMask(0xFF);
 		glStencilFunc(GL_ALWAYS, 1, 0xFF);
 		glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
-		window.setProjection(glm::perspective(45.0f, (float)1980 / 1080, 0.1f, 20.0f));
-		window.draw(model, shader);
+		window.setProjection(glm::perspective(45.0f, (float)window.getWidth() / window.getHeight(), nearPlane, farPlane));
+		if (useOcclusion)
+		{
+			occlusion.begin(window.getProjection() * window.getView());
+			model.submitOccluder(occlusion);
+			occlusion.rasterize();
+			window.setOcclusionCuller(&occlusion);
+		}
+		entities.cull(window.getCuller(), window.getOcclusionCuller(), window.getHiZCuller());
+		indirectRenderer.begin();
+		entities.submitMeshes(indirectRenderer);
+		indirectRenderer.end(window, indirectShader);
+		if (skinnedModel)
+		{
+			skinPalette.begin();
+			skinnedRenderer.begin();
+			Animator::updateAll(animators.data(), animators.size(), elapsedTime);
+			for (unsigned int i = 0; i < animators.size(); ++i)
+			{
+				skinnedModel->submitSkinned(skinnedRenderer, skinPalette, skinnedTransforms[i], animators[i]);
+			}
+			skinPalette.upload();
+			skinPalette.bind(skinnedShader);
+			skinnedRenderer.end(window, skinnedShader);
+		}
 		glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
 		glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
-		window.draw(model, shader2);
+		//The outline goes over the rows the cull above kept, drawing the model again would cull it twice
+		entities.drawMeshes(window, shader2);
 		glStencilFunc(GL_ALWAYS, 1, 0xFF);
 
 		window.disableFaceCulling();
-		window.draw(ship, spriteShaderProg);
-		window.draw(water, waterShader);
-
-		window.draw(sprite, spriteShaderProg);
-		frameBuffer.reset(1980, 1080);
-
-		glDepthMask(GL_FALSE);
-		skyBoxBuffer.use();
-		window.draw(skay, skyboxShader);
-		skyBoxBuffer.reset(1980, 1080);
-		glDepthMask(GL_TRUE);
+		entities.drawWater(window, waterShader);
+		//The ship and the window share one batch, drawn over the water
+		spriteBatch.begin();
+		entities.submitSprites(spriteBatch);
+		spriteBatch.end(window, spriteBatchShaderProg);
+	});
+	if (useHiZ)
+	{
+		//The pyramid the next frames cull against, from this frame's depth and camera
+		frameGraph.addPass("hi-z", [&](RenderPassBuilder& builder)
+		{
+			builder.read(sceneDepth);
+			builder.sideEffect();
+		}, [&]()
+		{
+			hiZ->update(frameGraph.getTexture(sceneDepth), window.getProjection() * window.getView());
+		});
+	}
+	Sprite renderedToScreen(0);
+	frameGraph.addPass("fog composite", [&](RenderPassBuilder& builder)
+	{
+		builder.read(sceneColor);
+		builder.read(sceneDepth);
+		builder.sideEffect();
+	}, [&]()
+	{
+		glm::mat4 inverseViewProjection = glm::inverse(window.getProjection() * glm::mat4(glm::mat3(window.getView())));
 		window.setProjection(glm::ortho(-0.5f,0.5f,-0.5f,0.5f,0.01f,100.0f));
 		glm::mat4 oldView = window.getView();
 		window.setView(glm::lookAt(glm::vec3(0, 0, 6), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0)));
 		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, frameBuffer.getDepthTexture());
+		glBindTexture(GL_TEXTURE_2D, frameGraph.getTexture(sceneDepth));
 		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, skyBoxBuffer.getTexture());
+		glBindTexture(GL_TEXTURE_CUBE_MAP, skay.getTexture());
 		fogShader.use();
 		glUniform1i(glGetUniformLocation(fogShader.getID(), "depthTexture"), 1);
-		glUniform1i(glGetUniformLocation(fogShader.getID(), "skyTexture"), 2);
+		glUniform1i(glGetUniformLocation(fogShader.getID(), "skyBox"), 2);
+		glUniformMatrix4fv(glGetUniformLocation(fogShader.getID(), "inverseViewProjection"), 1, GL_FALSE, glm::value_ptr(inverseViewProjection));
+		glUniform1f(glGetUniformLocation(fogShader.getID(), "nearPlane"), nearPlane);
+		glUniform1f(glGetUniformLocation(fogShader.getID(), "farPlane"), farPlane);
+		renderedToScreen.setTexture(frameGraph.getTexture(sceneColor));
 		window.draw(renderedToScreen, fogShader);
 		window.setView(oldView);
+	});
+	float time = glfwGetTime();
+	while (!window.shouldClose())
+	{
+		float currentFrame = glfwGetTime();
+		elapsedTime = currentFrame - time;
+		window.processEvents(elapsedTime);
+		//Loads started during the frame upload here, a few milliseconds at a time
+		loader.pump();
+		//The ship sails in a circle with --ripples, and rides the waves unless they are the FFT ocean's
+		glm::vec3 shipPosition = ripples ? glm::vec3(3 * std::cos(0.3f * currentFrame), 0.5f, 3 * std::sin(0.3f * currentFrame)) : glm::vec3(1, 0.5f, 1);
+		if (!ocean)
+		{
+			glm::vec3 worldPosition = glm::vec3(sea.getTransform() * glm::vec4(shipPosition, 1.0f));
+			float surface;
+			water.sampleSurface(&worldPosition, 1, window.getFrameTime(), &surface, nullptr);
+			shipPosition.y += surface - sea.getTransform()[3].y;
+		}
+		ship.setPosition(shipPosition);
+		SceneGraph::get().update();
+		if (ripples)
+		{
+			//The wake is pushed in under wherever the ship is now
+			glm::vec4 shipPosition = glm::inverse(water.getTransform()) * ship.getTransform()[3];
+			ripples->disturb(glm::vec2(shipPosition.x, shipPosition.y), 0.25f / 30, 1.2f * elapsedTime);
+			ripples->update(elapsedTime);
+		}
+		entities.update();
+		if (useHiZ)
+		{
+			if (hiZSize != glm::uvec2(window.getWidth(), window.getHeight()))
+			{
+				hiZSize = glm::uvec2(window.getWidth(), window.getHeight());
+				hiZ = std::make_unique<HiZCuller>(hiZSize.x, hiZSize.y);
+			}
+			hiZ->beginFrame();
+			window.setHiZCuller(hiZ.get());
+		}
+		//The waves are simulated and uploaded before any pass runs
+		if (ocean)
+		{
+			ocean->simulate(currentFrame);
+			ocean->upload();
+		}
+		if (ripples)
+		{
+			ripples->upload();
+		}
+		frameGraph.setBackbufferSize(window.getWidth(), window.getHeight());
+		frameGraph.execute();
+		targetPool.endFrame();
 		window.swapBuffers();
 		time = currentFrame;
 	}
+	//--graph-stats prints the passes of the last frame and the pool on exit
+	if (hasArgument(argc, argv, "--graph-stats"))
+	{
+		frameGraph.printStats(std::cout);
+		const RenderTargetPoolStats& poolStats = targetPool.getStats();
+		std::cout << "Target pool: " << poolStats.textures << " textures, " << poolStats.bytes / (1024.0 * 1024.0) << " MB, ";
+		std::cout << poolStats.created << " made and " << poolStats.deleted << " deleted" << std::endl;
+	}
 }
\ No newline at end of file
@@ -0,0 +1,228 @@
+#include "OcclusionCuller.h"
+#include "JobSystem.h"
+#include <emmintrin.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+	//Clip w below this counts as behind the near plane
+	const float minW = 1e-4f;
+}
+
+OcclusionCuller::OcclusionCuller(unsigned int width, unsigned int height, unsigned int threadCount)
+{
+	this->width = (std::max(width, 4u) + 3) & ~3u;
+	this->height = std::max(height, 1u);
+	if (threadCount == 0)
+	{
+		threadCount = JobSystem::get().getWorkerCount();
+	}
+	this->threadCount = std::min(threadCount, this->height);
+	depth.resize(this->width * this->height, 1.0f);
+}
+
+void OcclusionCuller::begin(const glm::mat4& viewProjection)
+{
+	this->viewProjection = viewProjection;
+	std::fill(depth.begin(), depth.end(), 1.0f);
+	triangles.clear();
+	stats = OcclusionStats();
+}
+
+void OcclusionCuller::addOccluder(const glm::vec3* positions, const unsigned int* indices, size_t indexCount, const glm::mat4& model)
+{
+	glm::mat4 transform;
+	simd::multiply(viewProjection, model, transform);
+
+	//Every vertex is transformed once, the triangles index into the result
+	unsigned int vertexCount = 0;
+	for (size_t i = 0; i < indexCount; ++i)
+	{
+		vertexCount = std::max(vertexCount, indices[i] + 1);
+	}
+	clipPositions.resize(vertexCount);
+	for (unsigned int i = 0; i < vertexCount; ++i)
+	{
+		clipPositions[i] = transform * glm::vec4(positions[i], 1.0f);
+	}
+
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		++stats.occluderTriangles;
+		const glm::vec4* corners[3] = { &clipPositions[indices[i]], &clipPositions[indices[i + 1]], &clipPositions[indices[i + 2]] };
+		if (corners[0]->w < minW || corners[1]->w < minW || corners[2]->w < minW)
+		{
+			++stats.trianglesSkipped;
+			continue;
+		}
+		Triangle triangle;
+		float z[3];
+		for (int j = 0; j < 3; ++j)
+		{
+			float inverseW = 1.0f / corners[j]->w;
+			triangle.x[j] = (corners[j]->x * inverseW * 0.5f + 0.5f) * width;
+			triangle.y[j] = (corners[j]->y * inverseW * 0.5f + 0.5f) * height;
+			z[j] = corners[j]->z * inverseW * 0.5f + 0.5f;
+		}
+		//Counter clockwise on screen is front facing, the same as the GL default
+		float area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) - (triangle.x[2] - triangle.x[0]) * (triangle.y[1] - triangle.y[0]);
+		if (area <= 0)
+		{
+			++stats.trianglesSkipped;
+			continue;
+		}
+		float minY = std::min(triangle.y[0], std::min(triangle.y[1], triangle.y[2]));
+		float maxY = std::max(triangle.y[0], std::max(triangle.y[1], triangle.y[2]));
+		float minX = std::min(triangle.x[0], std::min(triangle.x[1], triangle.x[2]));
+		float maxX = std::max(triangle.x[0], std::max(triangle.x[1], triangle.x[2]));
+		if (maxY < 0 || minY >= height || maxX < 0 || minX >= width || std::max(z[0], std::max(z[1], z[2])) < 0 || std::min(z[0], std::min(z[1], z[2])) > 1)
+		{
+			++stats.trianglesSkipped;
+			continue;
+		}
+		triangle.minY = std::max(0, (int)std::floor(minY));
+		triangle.maxY = std::min((int)height - 1, (int)std::ceil(maxY));
+
+		float inverseArea = 1.0f / area;
+		triangle.zx = ((z[1] - z[0]) * (triangle.y[2] - triangle.y[0]) - (z[2] - z[0]) * (triangle.y[1] - triangle.y[0])) * inverseArea;
+		triangle.zy = ((z[2] - z[0]) * (triangle.x[1] - triangle.x[0]) - (z[1] - z[0]) * (triangle.x[2] - triangle.x[0])) * inverseArea;
+		triangle.z0 = z[0] - triangle.zx * triangle.x[0] - triangle.zy * triangle.y[0];
+		triangles.push_back(triangle);
+	}
+}
+
+void OcclusionCuller::rasterize()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	//Bands share nothing, every job writes its own rows
+	JobSystem& jobs = JobSystem::get();
+	JobCounter counter;
+	for (unsigned int i = 1; i < threadCount; ++i)
+	{
+		unsigned int firstRow = height * i / threadCount;
+		unsigned int endRow = height * (i + 1) / threadCount;
+		jobs.run([this, firstRow, endRow]() { rasterizeBand(firstRow, endRow); }, &counter);
+	}
+	rasterizeBand(0, height / threadCount);
+	jobs.wait(counter);
+	stats.rasterMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void OcclusionCuller::rasterizeBand(unsigned int firstRow, unsigned int endRow)
+{
+	const __m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+	const __m128 zero = _mm_setzero_ps();
+	for (const Triangle& triangle : triangles)
+	{
+		int rowStart = std::max(triangle.minY, (int)firstRow);
+		int rowEnd = std::min(triangle.maxY, (int)endRow - 1);
+		if (rowStart > rowEnd)
+		{
+			continue;
+		}
+		float minX = std::min(triangle.x[0], std::min(triangle.x[1], triangle.x[2]));
+		float maxX = std::max(triangle.x[0], std::max(triangle.x[1], triangle.x[2]));
+		int columnStart = std::max(0, (int)std::floor(minX)) & ~3;
+		int columnEnd = std::min((int)width - 1, (int)std::ceil(maxX));
+
+		//Edge functions are positive inside a counter clockwise triangle, e = a * x + b * y + c
+		__m128 edgeA[3];
+		__m128 edgeB[3];
+		__m128 edgeC[3];
+		for (int i = 0; i < 3; ++i)
+		{
+			int j = (i + 1) % 3;
+			float a = triangle.y[i] - triangle.y[j];
+			float b = triangle.x[j] - triangle.x[i];
+			float c = triangle.x[i] * triangle.y[j] - triangle.x[j] * triangle.y[i];
+			edgeA[i] = _mm_set1_ps(a);
+			edgeB[i] = _mm_set1_ps(b);
+			edgeC[i] = _mm_set1_ps(c);
+		}
+		__m128 zx = _mm_set1_ps(triangle.zx);
+		__m128 zy = _mm_set1_ps(triangle.zy);
+		__m128 z0 = _mm_set1_ps(triangle.z0);
+
+		for (int row = rowStart; row <= rowEnd; ++row)
+		{
+			__m128 y = _mm_set1_ps(row + 0.5f);
+			float* line = depth.data() + row * width;
+			for (int column = columnStart; column <= columnEnd; column += 4)
+			{
+				__m128 x = _mm_add_ps(_mm_set1_ps((float)column), laneOffsets);
+				__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(edgeA[0], x), _mm_mul_ps(edgeB[0], y)), edgeC[0]), zero);
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(edgeA[1], x), _mm_mul_ps(edgeB[1], y)), edgeC[1]), zero));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(edgeA[2], x), _mm_mul_ps(edgeB[2], y)), edgeC[2]), zero));
+				if (_mm_movemask_ps(inside) == 0)
+				{
+					continue;
+				}
+				__m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(zx, x), _mm_mul_ps(zy, y)), z0);
+				__m128 current = _mm_loadu_ps(line + column);
+				__m128 nearest = _mm_min_ps(current, z);
+				_mm_storeu_ps(line + column, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+			}
+		}
+	}
+}
+
+bool OcclusionCuller::isVisible(const AABB& box)
+{
+	++stats.boxesTested;
+	float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, nearest = 1e30f;
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		glm::vec4 clip = viewProjection * glm::vec4(corner & 1 ? box.max.x : box.min.x, corner & 2 ? box.max.y : box.min.y, corner & 4 ? box.max.z : box.min.z, 1.0f);
+		if (clip.w < minW)
+		{
+			return true;
+		}
+		float inverseW = 1.0f / clip.w;
+		float x = (clip.x * inverseW * 0.5f + 0.5f) * width;
+		float y = (clip.y * inverseW * 0.5f + 0.5f) * height;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearest = std::min(nearest, clip.z * inverseW * 0.5f + 0.5f);
+	}
+	int columnStart = std::max(0, (int)std::floor(minX));
+	int columnEnd = std::min((int)width - 1, (int)std::ceil(maxX));
+	int rowStart = std::max(0, (int)std::floor(minY));
+	int rowEnd = std::min((int)height - 1, (int)std::ceil(maxY));
+	if (columnStart > columnEnd || rowStart > rowEnd)
+	{
+		//Off screen, that is for the frustum culling to decide
+		return true;
+	}
+	//Occluders cover the pixels whose centers they cover, so the part of the box before the first
+	//pixel's center can only show through the pixel before it
+	columnStart = std::max(0, (int)std::floor(minX - 0.5f));
+	rowStart = std::max(0, (int)std::floor(minY - 0.5f));
+
+	//Visible as soon as one pixel under the box is farther than its nearest point
+	__m128 boxDepth = _mm_set1_ps(nearest);
+	for (int row = rowStart; row <= rowEnd; ++row)
+	{
+		const float* line = depth.data() + row * width;
+		int column = columnStart;
+		for (; column + 3 <= columnEnd; column += 4)
+		{
+			if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(line + column), boxDepth)))
+			{
+				return true;
+			}
+		}
+		for (; column <= columnEnd; ++column)
+		{
+			if (line[column] >= nearest)
+			{
+				return true;
+			}
+		}
+	}
+	++stats.boxesOccluded;
+	return false;
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <glm/glm.hpp>
+#include "SimdMath.h"
+
+struct OcclusionStats
+{
+	unsigned int occluderTriangles = 0;
+	//Triangles dropped for crossing the near plane or facing away from the viewer
+	unsigned int trianglesSkipped = 0;
+	unsigned int boxesTested = 0;
+	unsigned int boxesOccluded = 0;
+	double rasterMs = 0;
+};
+
+//Depth only software rasterizer for occlusion culling, entirely on the CPU. Occluder triangles
+//are transformed and set up on the calling thread, then the depth buffer is split into bands of
+//rows filled in parallel as jobs, each band covering four pixels per SSE instruction with a coverage
+//mask from the three edge functions. Boxes are then tested against the nearest depth per pixel.
+//Everything errs towards visible: occluders crossing the near plane are skipped and so is any
+//tested box with a corner behind the camera counts as visible
+class OcclusionCuller
+{
+public:
+	//Width is rounded up to a multiple of four, 0 threads uses one band per JobSystem worker
+	OcclusionCuller(unsigned int width = 320, unsigned int height = 180, unsigned int threadCount = 0);
+
+	//Clears the depth buffer and drops the occluders of the previous frame
+	void begin(const glm::mat4& viewProjection);
+	void addOccluder(const glm::vec3* positions, const unsigned int* indices, size_t indexCount, const glm::mat4& model);
+	void rasterize();
+
+	//World space box against the rasterized occluders
+	bool isVisible(const AABB& box);
+
+	void setEnabled(bool enabled) { this->enabled = enabled; }
+	bool isEnabled() const { return enabled; }
+	unsigned int getWidth() const { return width; }
+	unsigned int getHeight() const { return height; }
+	//Normalized device depth remapped to 0 (near) to 1 (far), row 0 at the bottom of the screen
+	const std::vector<float>& getDepth() const { return depth; }
+	const OcclusionStats& getStats() const { return stats; }
+private:
+	struct Triangle
+	{
+		//Screen position in pixels
+		float x[3];
+		float y[3];
+		//Depth plane, z = zx * x + zy * y + z0
+		float zx;
+		float zy;
+		float z0;
+		int minY;
+		int maxY;
+	};
+
+	void rasterizeBand(unsigned int firstRow, unsigned int endRow);
+
+	unsigned int width;
+	unsigned int height;
+	unsigned int threadCount;
+	bool enabled = true;
+	glm::mat4 viewProjection;
+	std::vector<float> depth;
+	std::vector<Triangle> triangles;
+	std::vector<glm::vec4> clipPositions;
+	OcclusionStats stats;
+};
\ No newline at end of file
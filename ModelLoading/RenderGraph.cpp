@@ -0,0 +1,441 @@
+#include "RenderGraph.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <exception>
+#include <iomanip>
+
+namespace
+{
+	bool sameDesc(const TargetDesc& a, const TargetDesc& b)
+	{
+		return a.format == b.format && a.width == b.width && a.height == b.height && a.samples == b.samples;
+	}
+}
+
+RenderResource RenderPassBuilder::create(const std::string& name, const TargetDesc& desc)
+{
+	RenderGraph::Target target;
+	target.name = name;
+	target.desc = desc;
+	target.creator = pass;
+	target.writers.push_back(pass);
+	graph.targets.push_back(target);
+	graph.passes[pass].writes.push_back(graph.targets.size() - 1);
+	return graph.targets.size() - 1;
+}
+
+RenderResource RenderPassBuilder::write(RenderResource resource)
+{
+	graph.targets[resource].writers.push_back(pass);
+	graph.passes[pass].writes.push_back(resource);
+	return resource;
+}
+
+RenderResource RenderPassBuilder::read(RenderResource resource)
+{
+	graph.targets[resource].readers.push_back(pass);
+	graph.passes[pass].reads.push_back(resource);
+	return resource;
+}
+
+void RenderPassBuilder::sideEffect()
+{
+	graph.passes[pass].sideEffect = true;
+}
+
+RenderGraph::~RenderGraph()
+{
+	release();
+	for (Pass& pass : passes)
+	{
+		if (pass.queries[0])
+		{
+			glDeleteQueries(queryFrames, pass.queries);
+		}
+	}
+}
+
+void RenderGraph::addPass(const std::string& name, const std::function<void(RenderPassBuilder&)>& setup, const std::function<void()>& execute)
+{
+	passes.emplace_back();
+	passes.back().name = name;
+	passes.back().execute = execute;
+	passes.back().stats.name = name;
+	RenderPassBuilder builder(*this, passes.size() - 1);
+	setup(builder);
+	compiled = false;
+}
+
+void RenderGraph::compile()
+{
+	release();
+	//Writers of a target run after its creator, and readers after all of its writers
+	std::vector<std::vector<unsigned int>> dependencies(passes.size());
+	for (const Target& target : targets)
+	{
+		for (unsigned int writer : target.writers)
+		{
+			if (writer != target.creator)
+			{
+				dependencies[writer].push_back(target.creator);
+			}
+		}
+		for (unsigned int reader : target.readers)
+		{
+			for (unsigned int writer : target.writers)
+			{
+				if (writer != reader)
+				{
+					dependencies[reader].push_back(writer);
+				}
+			}
+		}
+	}
+
+	//Passes with side effects are kept, and so is everything they depend on
+	std::vector<unsigned int> pending;
+	for (unsigned int i = 0; i < passes.size(); ++i)
+	{
+		passes[i].alive = passes[i].sideEffect;
+		if (passes[i].alive)
+		{
+			pending.push_back(i);
+		}
+	}
+	while (!pending.empty())
+	{
+		unsigned int pass = pending.back();
+		pending.pop_back();
+		for (unsigned int dependency : dependencies[pass])
+		{
+			if (!passes[dependency].alive)
+			{
+				passes[dependency].alive = true;
+				pending.push_back(dependency);
+			}
+		}
+	}
+
+	//Each step runs the earliest added pass that is ready, so passes that only depend on state outside
+	//the graph, such as the camera, keep their place
+	unsigned int aliveCount = 0;
+	for (const Pass& pass : passes)
+	{
+		aliveCount += pass.alive;
+	}
+	order.clear();
+	std::vector<unsigned char> scheduled(passes.size(), 0);
+	while (order.size() < aliveCount)
+	{
+		bool found = false;
+		for (unsigned int i = 0; i < passes.size() && !found; ++i)
+		{
+			if (!passes[i].alive || scheduled[i])
+			{
+				continue;
+			}
+			bool ready = true;
+			for (unsigned int dependency : dependencies[i])
+			{
+				ready = ready && scheduled[dependency];
+			}
+			if (ready)
+			{
+				order.push_back(i);
+				scheduled[i] = 1;
+				found = true;
+			}
+		}
+		if (!found)
+		{
+			throw std::exception("Render graph passes depend on each other in a cycle");
+		}
+	}
+
+	//A target lives from the first pass using it to the last, and takes the first texture of its
+	//format and size that is free by then
+	struct Lifetime
+	{
+		unsigned int target;
+		unsigned int first;
+		unsigned int last;
+	};
+	std::vector<unsigned int> position(passes.size(), 0);
+	for (unsigned int i = 0; i < order.size(); ++i)
+	{
+		position[order[i]] = i;
+	}
+	std::vector<Lifetime> lifetimes;
+	for (unsigned int i = 0; i < targets.size(); ++i)
+	{
+		Lifetime lifetime = { i, UINT_MAX, 0 };
+		for (const std::vector<unsigned int>* users : { &targets[i].writers, &targets[i].readers })
+		{
+			for (unsigned int user : *users)
+			{
+				if (passes[user].alive)
+				{
+					lifetime.first = std::min(lifetime.first, position[user]);
+					lifetime.last = std::max(lifetime.last, position[user]);
+				}
+			}
+		}
+		targets[i].texture = -1;
+		if (lifetime.first != UINT_MAX)
+		{
+			lifetimes.push_back(lifetime);
+		}
+	}
+	std::sort(lifetimes.begin(), lifetimes.end(), [](const Lifetime& a, const Lifetime& b) { return a.first < b.first; });
+	textures.clear();
+	std::vector<unsigned int> lastUses;
+	for (const Lifetime& lifetime : lifetimes)
+	{
+		Target& target = targets[lifetime.target];
+		for (unsigned int i = 0; i < textures.size() && target.texture < 0; ++i)
+		{
+			if (sameDesc(textures[i].desc, target.desc) && lastUses[i] < lifetime.first)
+			{
+				target.texture = i;
+				lastUses[i] = lifetime.last;
+			}
+		}
+		if (target.texture < 0)
+		{
+			target.texture = textures.size();
+			textures.push_back({ target.desc, 0 });
+			lastUses.push_back(lifetime.last);
+		}
+	}
+
+	stats = RenderGraphStats();
+	stats.passes = passes.size();
+	stats.targets = lifetimes.size();
+	stats.textures = textures.size();
+	for (Pass& pass : passes)
+	{
+		pass.stats.culled = !pass.alive;
+		pass.stats.reads = pass.reads.size();
+		pass.stats.writes = pass.writes.size();
+		stats.culledPasses += !pass.alive;
+	}
+	for (unsigned int i = 0; i < order.size(); ++i)
+	{
+		passes[order[i]].stats.order = i;
+	}
+	compiled = true;
+}
+
+void RenderGraph::setBackbufferSize(unsigned int width, unsigned int height)
+{
+	//A minimized window reports 0
+	width = std::max(width, 1u);
+	height = std::max(height, 1u);
+	if (width == backbufferWidth && height == backbufferHeight)
+	{
+		return;
+	}
+	backbufferWidth = width;
+	backbufferHeight = height;
+}
+
+void RenderGraph::allocate()
+{
+	for (unsigned int index : order)
+	{
+		Pass& pass = passes[index];
+		if (!pass.queries[0])
+		{
+			glGenQueries(queryFrames, pass.queries);
+		}
+		if (!pass.writes.empty())
+		{
+			glGenFramebuffers(1, &pass.fbo);
+		}
+	}
+	allocated = true;
+}
+
+void RenderGraph::release()
+{
+	for (Pass& pass : passes)
+	{
+		if (pass.fbo)
+		{
+			glDeleteFramebuffers(1, &pass.fbo);
+			pass.fbo = 0;
+		}
+		pass.attached.clear();
+	}
+	allocated = false;
+}
+
+void RenderGraph::acquireTextures()
+{
+	stats.targetBytes = 0;
+	stats.textureBytes = 0;
+	for (Texture& texture : textures)
+	{
+		const TargetDesc& desc = texture.desc;
+		texture.id = pool.acquire(desc.format, getWidth(desc), getHeight(desc), desc.samples);
+		stats.textureBytes += RenderTargetPool::getBytes(desc.format, getWidth(desc), getHeight(desc), desc.samples);
+	}
+	for (const Target& target : targets)
+	{
+		if (target.texture >= 0)
+		{
+			stats.targetBytes += RenderTargetPool::getBytes(target.desc.format, getWidth(target.desc), getHeight(target.desc), target.desc.samples);
+		}
+	}
+}
+
+void RenderGraph::releaseTextures()
+{
+	for (Texture& texture : textures)
+	{
+		pool.release(texture.id);
+		texture.id = 0;
+	}
+}
+
+void RenderGraph::attach(Pass& pass)
+{
+	std::vector<unsigned int> ids;
+	for (RenderResource resource : pass.writes)
+	{
+		ids.push_back(textures[targets[resource].texture].id);
+	}
+	if (ids == pass.attached)
+	{
+		return;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, pass.fbo);
+	std::vector<GLenum> drawBuffers;
+	for (unsigned int i = 0; i < pass.writes.size(); ++i)
+	{
+		const TargetDesc& desc = targets[pass.writes[i]].desc;
+		bool depth = RenderTargetPool::isDepth(desc.format);
+		GLenum attachment = depth ? GL_DEPTH_STENCIL_ATTACHMENT : GL_COLOR_ATTACHMENT0 + drawBuffers.size();
+		glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, desc.samples > 1 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D, ids[i], 0);
+		if (!depth)
+		{
+			drawBuffers.push_back(attachment);
+		}
+	}
+	if (drawBuffers.empty())
+	{
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+	}
+	else
+	{
+		glDrawBuffers(drawBuffers.size(), drawBuffers.data());
+	}
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		throw std::exception("Render graph pass framebuffer incomplete!");
+	}
+	pass.attached = ids;
+}
+
+void RenderGraph::execute()
+{
+	if (!compiled)
+	{
+		compile();
+	}
+	if (!allocated)
+	{
+		allocate();
+	}
+	acquireTextures();
+	unsigned int slot = frame % queryFrames;
+	for (unsigned int index : order)
+	{
+		Pass& pass = passes[index];
+		//The query last issued in this slot is a few frames old, its time is kept if it is done and dropped otherwise
+		if (pass.queryIssued[slot])
+		{
+			GLint available = 0;
+			glGetQueryObjectiv(pass.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available)
+			{
+				GLuint64 nanoseconds = 0;
+				glGetQueryObjectui64v(pass.queries[slot], GL_QUERY_RESULT, &nanoseconds);
+				pass.stats.gpuMs = nanoseconds / 1e6;
+			}
+		}
+		if (pass.fbo)
+		{
+			attach(pass);
+		}
+		glBeginQuery(GL_TIME_ELAPSED, pass.queries[slot]);
+		glBindFramebuffer(GL_FRAMEBUFFER, pass.fbo);
+		if (pass.writes.empty())
+		{
+			glViewport(0, 0, backbufferWidth, backbufferHeight);
+		}
+		else
+		{
+			const TargetDesc& desc = targets[pass.writes[0]].desc;
+			glViewport(0, 0, getWidth(desc), getHeight(desc));
+		}
+		auto start = std::chrono::high_resolution_clock::now();
+		pass.execute();
+		pass.stats.cpuMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		glEndQuery(GL_TIME_ELAPSED);
+		pass.queryIssued[slot] = true;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	releaseTextures();
+	++frame;
+}
+
+unsigned int RenderGraph::getTexture(RenderResource resource) const
+{
+	int texture = targets[resource].texture;
+	return texture < 0 ? 0 : textures[texture].id;
+}
+
+std::vector<PassStats> RenderGraph::getPassStats() const
+{
+	std::vector<PassStats> result;
+	for (const Pass& pass : passes)
+	{
+		result.push_back(pass.stats);
+	}
+	return result;
+}
+
+void RenderGraph::printStats(std::ostream& out) const
+{
+	auto printPass = [&out](const PassStats& pass)
+	{
+		out << std::left << std::setw(20) << pass.name << std::right << std::setw(7);
+		if (pass.culled)
+		{
+			out << "culled";
+		}
+		else
+		{
+			out << pass.order;
+		}
+		out << std::setw(7) << pass.reads << std::setw(8) << pass.writes << std::fixed << std::setprecision(3) << std::setw(10) << pass.gpuMs << std::setw(10) << pass.cpuMs << std::endl;
+	};
+	out << std::left << std::setw(20) << "pass" << std::right << std::setw(7) << "order" << std::setw(7) << "reads" << std::setw(8) << "writes" << std::setw(10) << "gpu ms" << std::setw(10) << "cpu ms" << std::endl;
+	for (unsigned int index : order)
+	{
+		printPass(passes[index].stats);
+	}
+	for (const Pass& pass : passes)
+	{
+		if (!pass.alive)
+		{
+			printPass(pass.stats);
+		}
+	}
+	out << stats.targets << " targets in " << stats.textures << " textures, " << std::setprecision(1) << stats.textureBytes / (1024.0 * 1024.0) << " MB against ";
+	out << stats.targetBytes / (1024.0 * 1024.0) << " MB unaliased" << std::endl;
+}
\ No newline at end of file
@@ -0,0 +1,152 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <functional>
+#include <ostream>
+#include "RenderTargetPool.h"
+
+//A width or height of 0 follows the backbuffer
+struct TargetDesc
+{
+	TargetFormat format = TargetFormat::RGBA8;
+	unsigned int width = 0;
+	unsigned int height = 0;
+	//More than one gives a multisampled texture, which passes resolve with a blit rather than sample
+	unsigned int samples = 1;
+};
+
+//Index of a target in its graph
+typedef unsigned int RenderResource;
+
+struct PassStats
+{
+	std::string name;
+	bool culled = false;
+	//Position in the compiled order
+	unsigned int order = 0;
+	unsigned int reads = 0;
+	unsigned int writes = 0;
+	//GPU time of the latest frame whose timer query has finished
+	double gpuMs = 0;
+	double cpuMs = 0;
+};
+
+struct RenderGraphStats
+{
+	unsigned int passes = 0;
+	unsigned int culledPasses = 0;
+	unsigned int targets = 0;
+	//Textures behind the targets, fewer when targets alias
+	unsigned int textures = 0;
+	size_t targetBytes = 0;
+	size_t textureBytes = 0;
+};
+
+class RenderGraph;
+
+//Handed to a pass's setup to declare the targets it uses
+class RenderPassBuilder
+{
+public:
+	//A new target the pass writes first. Its contents start undefined, as the texture may have held
+	//another target, so the pass clears it or draws over all of it
+	RenderResource create(const std::string& name, const TargetDesc& desc);
+	//Draws on top of a target another pass created, after that pass
+	RenderResource write(RenderResource resource);
+	//Samples a target, after every pass that writes it
+	RenderResource read(RenderResource resource);
+	//The pass draws to the window or changes something outside the graph, so it is never culled
+	void sideEffect();
+private:
+	friend class RenderGraph;
+	RenderPassBuilder(RenderGraph& graph, unsigned int pass) : graph(graph), pass(pass) {}
+
+	RenderGraph& graph;
+	unsigned int pass;
+};
+
+//The frame as passes that declare which targets they read and write. compile orders the passes by
+//those dependencies, keeping the order they were added in where it is free, culls the passes whose
+//targets nothing reads, and gives targets of the same format and size whose lifetimes do not overlap
+//the same texture. The textures are taken from a RenderTargetPool at the start of every execute and
+//given back at the end, so graphs sharing a pool share textures too and a resize needs nothing
+//freed by hand. execute binds each pass's targets as one framebuffer before running it, passes
+//that write no target draw to the window. Every pass is timed on the CPU and with a GPU timer query
+class RenderGraph
+{
+public:
+	explicit RenderGraph(RenderTargetPool& pool) : pool(pool) {}
+	~RenderGraph();
+	RenderGraph(const RenderGraph&) = delete;
+	RenderGraph& operator=(const RenderGraph&) = delete;
+
+	//setup runs straight away, execute every frame
+	void addPass(const std::string& name, const std::function<void(RenderPassBuilder&)>& setup, const std::function<void()>& execute);
+	//Called by the first execute after passes were added. Throws when the passes depend on each other in a cycle
+	void compile();
+	//Targets that follow the backbuffer take textures of the new size from the pool on the next execute
+	void setBackbufferSize(unsigned int width, unsigned int height);
+	void execute();
+
+	//Texture behind a target while the passes run, 0 outside of execute
+	unsigned int getTexture(RenderResource resource) const;
+	std::vector<PassStats> getPassStats() const;
+	const RenderGraphStats& getStats() const { return stats; }
+	//A line per pass in the compiled order, then the culled passes and the target memory
+	void printStats(std::ostream& out) const;
+private:
+	friend class RenderPassBuilder;
+	static const unsigned int queryFrames = 4;
+
+	struct Target
+	{
+		std::string name;
+		TargetDesc desc;
+		unsigned int creator;
+		std::vector<unsigned int> writers;
+		std::vector<unsigned int> readers;
+		//Index into textures, culled targets have none
+		int texture = -1;
+	};
+	struct Pass
+	{
+		std::string name;
+		std::function<void()> execute;
+		std::vector<RenderResource> reads;
+		std::vector<RenderResource> writes;
+		bool sideEffect = false;
+		bool alive = false;
+		unsigned int fbo = 0;
+		//Textures attached to fbo, which is only attached again when the pool hands out others
+		std::vector<unsigned int> attached;
+		unsigned int queries[queryFrames] = {};
+		bool queryIssued[queryFrames] = {};
+		PassStats stats;
+	};
+	struct Texture
+	{
+		TargetDesc desc;
+		unsigned int id = 0;
+	};
+
+	//Framebuffers and queries of the compiled passes
+	void allocate();
+	void release();
+	void acquireTextures();
+	void releaseTextures();
+	void attach(Pass& pass);
+	unsigned int getWidth(const TargetDesc& desc) const { return desc.width ? desc.width : backbufferWidth; }
+	unsigned int getHeight(const TargetDesc& desc) const { return desc.height ? desc.height : backbufferHeight; }
+
+	RenderTargetPool& pool;
+	std::vector<Pass> passes;
+	std::vector<Target> targets;
+	std::vector<Texture> textures;
+	std::vector<unsigned int> order;
+	unsigned int backbufferWidth = 1;
+	unsigned int backbufferHeight = 1;
+	bool compiled = false;
+	bool allocated = false;
+	unsigned int frame = 0;
+	RenderGraphStats stats;
+};
\ No newline at end of file
@@ -0,0 +1,144 @@
+#include "RenderTargetPool.h"
+#include <glad/glad.h>
+#include <exception>
+
+namespace
+{
+	struct FormatInfo
+	{
+		GLenum internalFormat;
+		GLenum format;
+		GLenum type;
+		unsigned int bytes;
+	};
+
+	const FormatInfo& getFormatInfo(TargetFormat format)
+	{
+		//In TargetFormat order
+		static const FormatInfo infos[] =
+		{
+			{ GL_RGB8, GL_RGB, GL_UNSIGNED_BYTE, 3 },
+			{ GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4 },
+			{ GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, 8 },
+			{ GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, 4 }
+		};
+		return infos[(unsigned int)format];
+	}
+}
+
+RenderTargetPool::~RenderTargetPool()
+{
+	for (Entry& entry : entries)
+	{
+		glDeleteTextures(1, &entry.texture);
+	}
+}
+
+unsigned int RenderTargetPool::acquire(TargetFormat format, unsigned int width, unsigned int height, unsigned int samples)
+{
+	samples = samples ? samples : 1;
+	//The first match is taken, so users acquiring in the same order every frame get the same textures back
+	for (Entry& entry : entries)
+	{
+		if (!entry.acquired && entry.format == format && entry.width == width && entry.height == height && entry.samples == samples)
+		{
+			entry.acquired = true;
+			entry.lastUsed = frame;
+			++stats.acquired;
+			return entry.texture;
+		}
+	}
+
+	const FormatInfo& info = getFormatInfo(format);
+	Entry entry = { format, width, height, samples, 0, true, frame };
+	glGenTextures(1, &entry.texture);
+	if (samples > 1)
+	{
+		glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, entry.texture);
+		glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, samples, info.internalFormat, width, height, GL_TRUE);
+		glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+	}
+	else
+	{
+		glBindTexture(GL_TEXTURE_2D, entry.texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, info.internalFormat, width, height, 0, info.format, info.type, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	entries.push_back(entry);
+	++stats.textures;
+	++stats.acquired;
+	++stats.created;
+	stats.bytes += getBytes(format, width, height, samples);
+	return entry.texture;
+}
+
+void RenderTargetPool::release(unsigned int texture)
+{
+	for (Entry& entry : entries)
+	{
+		if (entry.texture == texture && entry.acquired)
+		{
+			entry.acquired = false;
+			entry.lastUsed = frame;
+			--stats.acquired;
+			return;
+		}
+	}
+	throw std::exception("Released a texture the render target pool did not hand out");
+}
+
+void RenderTargetPool::endFrame()
+{
+	++frame;
+	for (unsigned int i = 0; i < entries.size();)
+	{
+		if (!entries[i].acquired && frame - entries[i].lastUsed > idleFrames)
+		{
+			erase(i);
+		}
+		else
+		{
+			++i;
+		}
+	}
+}
+
+void RenderTargetPool::trim()
+{
+	for (unsigned int i = 0; i < entries.size();)
+	{
+		if (!entries[i].acquired)
+		{
+			erase(i);
+		}
+		else
+		{
+			++i;
+		}
+	}
+}
+
+void RenderTargetPool::erase(unsigned int index)
+{
+	//Order is kept so the first match acquire finds stays the same
+	Entry& entry = entries[index];
+	glDeleteTextures(1, &entry.texture);
+	--stats.textures;
+	++stats.deleted;
+	stats.bytes -= getBytes(entry.format, entry.width, entry.height, entry.samples);
+	entries.erase(entries.begin() + index);
+}
+
+bool RenderTargetPool::isDepth(TargetFormat format)
+{
+	return format == TargetFormat::Depth24Stencil8;
+}
+
+size_t RenderTargetPool::getBytes(TargetFormat format, unsigned int width, unsigned int height, unsigned int samples)
+{
+	return (size_t)width * height * (samples ? samples : 1) * getFormatInfo(format).bytes;
+}
\ No newline at end of file
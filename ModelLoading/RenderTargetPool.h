@@ -0,0 +1,66 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+enum class TargetFormat : unsigned char
+{
+	RGB8,
+	RGBA8,
+	RGBA16F,
+	Depth24Stencil8
+};
+
+struct RenderTargetPoolStats
+{
+	unsigned int textures = 0;
+	unsigned int acquired = 0;
+	size_t bytes = 0;
+	//Since the pool was made
+	unsigned int created = 0;
+	unsigned int deleted = 0;
+};
+
+//Textures to render into, shared by everything that draws off screen. acquire hands out a released
+//texture of the same format, size and sample count when there is one and makes a new one otherwise,
+//and release gives it back for the next user. endFrame deletes the textures nobody acquired for
+//idleFrames frames, so the sizes a resized window leaves behind go away on their own. Textures with
+//more than one sample are GL_TEXTURE_2D_MULTISAMPLE, the others GL_TEXTURE_2D with linear filtering
+class RenderTargetPool
+{
+public:
+	explicit RenderTargetPool(unsigned int idleFrames = 3) : idleFrames(idleFrames) {}
+	~RenderTargetPool();
+	RenderTargetPool(const RenderTargetPool&) = delete;
+	RenderTargetPool& operator=(const RenderTargetPool&) = delete;
+
+	//Contents are undefined, they may be what the last user drew
+	unsigned int acquire(TargetFormat format, unsigned int width, unsigned int height, unsigned int samples = 1);
+	//Throws for a texture the pool did not hand out
+	void release(unsigned int texture);
+	//Called once a frame, after everything using the pool has drawn
+	void endFrame();
+	//Deletes every released texture straight away
+	void trim();
+
+	const RenderTargetPoolStats& getStats() const { return stats; }
+	static bool isDepth(TargetFormat format);
+	static size_t getBytes(TargetFormat format, unsigned int width, unsigned int height, unsigned int samples);
+private:
+	struct Entry
+	{
+		TargetFormat format;
+		unsigned int width;
+		unsigned int height;
+		unsigned int samples;
+		unsigned int texture;
+		bool acquired;
+		unsigned int lastUsed;
+	};
+
+	void erase(unsigned int index);
+
+	std::vector<Entry> entries;
+	unsigned int idleFrames;
+	unsigned int frame = 0;
+	RenderTargetPoolStats stats;
+};
\ No newline at end of file
@@ -0,0 +1,224 @@
+#include "RippleField.h"
+#include "JobSystem.h"
+#include <glad/glad.h>
+#include <emmintrin.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+	//Steps per second, a frame runs at most maxSteps so a stall does not snowball
+	const float stepTime = 1.0f / 60.0f;
+	const unsigned int maxSteps = 4;
+	//Kept of the wave each step, lower settles sooner
+	const float damping = 0.985f;
+	//World units, a tile flatter than this goes to sleep
+	const float restHeight = 1e-4f;
+	const float pi = 3.14159265358979f;
+}
+
+RippleField::RippleField(const glm::vec2& origin, const glm::vec2& size, unsigned int resolution)
+{
+	this->origin = origin;
+	this->size = size;
+	tilesPerSide = std::max(1u, (resolution + tileSize - 1) / tileSize);
+	this->resolution = tilesPerSide * tileSize;
+	stride = this->resolution + 2;
+	heights[0].assign(stride * stride, 0.0f);
+	heights[1].assign(stride * stride, 0.0f);
+	active.assign(tilesPerSide * tilesPerSide, 0);
+	dirty.assign(tilesPerSide * tilesPerSide, 0);
+	tilePeaks.assign(tilesPerSide * tilesPerSide, 0.0f);
+}
+
+RippleField::~RippleField()
+{
+	if (texture)
+	{
+		glDeleteTextures(1, &texture);
+	}
+}
+
+void RippleField::disturb(const glm::vec2& position, float radius, float depth)
+{
+	//In cells, which need not be square
+	float centreX = (position.x - origin.x) / size.x * resolution;
+	float centreY = (position.y - origin.y) / size.y * resolution;
+	float radiusX = radius / size.x * resolution;
+	float radiusY = radius / size.y * resolution;
+	int minX = std::max(0, (int)std::floor(centreX - radiusX));
+	int maxX = std::min((int)resolution - 1, (int)std::ceil(centreX + radiusX));
+	int minY = std::max(0, (int)std::floor(centreY - radiusY));
+	int maxY = std::min((int)resolution - 1, (int)std::ceil(centreY + radiusY));
+	if (minX > maxX || minY > maxY || radiusX <= 0 || radiusY <= 0)
+	{
+		return;
+	}
+	std::vector<float>& now = heights[current];
+	for (int y = minY; y <= maxY; ++y)
+	{
+		for (int x = minX; x <= maxX; ++x)
+		{
+			float dx = (x + 0.5f - centreX) / radiusX;
+			float dy = (y + 0.5f - centreY) / radiusY;
+			float distance = std::sqrt(dx * dx + dy * dy);
+			if (distance < 1)
+			{
+				now[(y + 1) * stride + x + 1] -= depth * 0.5f * (1 + std::cos(pi * distance));
+			}
+		}
+	}
+	for (int tileY = minY / (int)tileSize; tileY <= maxY / (int)tileSize; ++tileY)
+	{
+		for (int tileX = minX / (int)tileSize; tileX <= maxX / (int)tileSize; ++tileX)
+		{
+			active[tileY * tilesPerSide + tileX] = 1;
+			dirty[tileY * tilesPerSide + tileX] = 1;
+		}
+	}
+}
+
+void RippleField::update(float deltaTime)
+{
+	stats.steps = 0;
+	stats.simulatedTiles = 0;
+	stats.stepMs = 0;
+	pending = std::min(pending + deltaTime, maxSteps * stepTime);
+	while (pending >= stepTime)
+	{
+		step();
+		pending -= stepTime;
+	}
+}
+
+void RippleField::step()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	//A wave moves one cell a step, so only the tiles next to an active one can wake up
+	stepping.clear();
+	for (unsigned int tileY = 0; tileY < tilesPerSide; ++tileY)
+	{
+		for (unsigned int tileX = 0; tileX < tilesPerSide; ++tileX)
+		{
+			unsigned int tile = tileY * tilesPerSide + tileX;
+			bool woken = active[tile] || (tileX > 0 && active[tile - 1]) || (tileX + 1 < tilesPerSide && active[tile + 1])
+				|| (tileY > 0 && active[tile - tilesPerSide]) || (tileY + 1 < tilesPerSide && active[tile + tilesPerSide]);
+			if (woken)
+			{
+				stepping.push_back(tile);
+			}
+		}
+	}
+	//Tiles only write their own cells of the next heights and read the current ones
+	JobSystem::get().parallelFor(stepping.size(), 4, [this](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; ++i)
+		{
+			stepTile(stepping[i]);
+		}
+	});
+	current ^= 1;
+
+	stats.activeTiles = 0;
+	for (unsigned int tile : stepping)
+	{
+		if (tilePeaks[tile] > restHeight)
+		{
+			active[tile] = 1;
+			dirty[tile] = 1;
+			++stats.activeTiles;
+		}
+		else if (tilePeaks[tile] > 0)
+		{
+			//What is left is too small to see, the texture gets the zeros if it had the waves
+			zeroTile(tile);
+			dirty[tile] |= active[tile];
+			active[tile] = 0;
+		}
+		else
+		{
+			active[tile] = 0;
+		}
+	}
+	stats.simulatedTiles += stepping.size();
+	++stats.steps;
+	stats.stepMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void RippleField::stepTile(unsigned int tile)
+{
+	//next = (sum of the four neighbours / 2 - previous) * damping, written over previous
+	const float* now = heights[current].data();
+	float* next = heights[current ^ 1].data();
+	unsigned int firstX = (tile % tilesPerSide) * tileSize + 1;
+	unsigned int firstY = (tile / tilesPerSide) * tileSize + 1;
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 keep = _mm_set1_ps(damping);
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+	__m128 peak = _mm_setzero_ps();
+	for (unsigned int y = firstY; y < firstY + tileSize; ++y)
+	{
+		const float* row = now + y * stride;
+		const float* above = row - stride;
+		const float* below = row + stride;
+		float* out = next + y * stride;
+		for (unsigned int x = firstX; x < firstX + tileSize; x += 4)
+		{
+			__m128 centre = _mm_loadu_ps(row + x);
+			__m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(row + x - 1), _mm_loadu_ps(row + x + 1)), _mm_add_ps(_mm_loadu_ps(above + x), _mm_loadu_ps(below + x)));
+			__m128 result = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(sum, half), _mm_loadu_ps(out + x)), keep);
+			_mm_storeu_ps(out + x, result);
+			//The wave can be all in the velocity with the heights crossing zero, so both steps count
+			peak = _mm_max_ps(peak, _mm_max_ps(_mm_andnot_ps(signBit, result), _mm_andnot_ps(signBit, centre)));
+		}
+	}
+	peak = _mm_max_ps(peak, _mm_shuffle_ps(peak, peak, _MM_SHUFFLE(1, 0, 3, 2)));
+	peak = _mm_max_ps(peak, _mm_shuffle_ps(peak, peak, _MM_SHUFFLE(2, 3, 0, 1)));
+	tilePeaks[tile] = _mm_cvtss_f32(peak);
+}
+
+void RippleField::zeroTile(unsigned int tile)
+{
+	unsigned int firstX = (tile % tilesPerSide) * tileSize + 1;
+	unsigned int firstY = (tile / tilesPerSide) * tileSize + 1;
+	for (unsigned int y = firstY; y < firstY + tileSize; ++y)
+	{
+		std::fill_n(&heights[0][y * stride + firstX], tileSize, 0.0f);
+		std::fill_n(&heights[1][y * stride + firstX], tileSize, 0.0f);
+	}
+	tilePeaks[tile] = 0;
+}
+
+void RippleField::upload()
+{
+	if (!texture)
+	{
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		std::vector<float> zeros(resolution * resolution, 0.0f);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, resolution, resolution, 0, GL_RED, GL_FLOAT, zeros.data());
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
+	glBindTexture(GL_TEXTURE_2D, texture);
+	//Tiles go up straight out of the bordered field
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, stride);
+	stats.uploadedTiles = 0;
+	for (unsigned int tile = 0; tile < dirty.size(); ++tile)
+	{
+		if (!dirty[tile])
+		{
+			continue;
+		}
+		unsigned int x = (tile % tilesPerSide) * tileSize;
+		unsigned int y = (tile / tilesPerSide) * tileSize;
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, tileSize, tileSize, GL_RED, GL_FLOAT, &heights[current][(y + 1) * stride + x + 1]);
+		dirty[tile] = 0;
+		++stats.uploadedTiles;
+	}
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+struct RippleStats
+{
+	unsigned int activeTiles = 0;
+	//Active tiles and their neighbours, which the waves can spread into, summed over the steps
+	unsigned int simulatedTiles = 0;
+	unsigned int uploadedTiles = 0;
+	unsigned int steps = 0;
+	double stepMs = 0;
+};
+
+//Local ripples on a patch of the water, a damped wave equation on a square heightfield stepped at a
+//fixed rate. The field is split into tiles and only tiles with waves on them, and the tiles next to
+//those, are stepped, as JobSystem jobs with a four cells per SSE instruction stencil. A tile whose
+//waves died down is zeroed and sleeps until a wave or a disturbance reaches it again. upload only
+//sends the tiles that changed since the last upload. Heights are in world units, positions in the
+//object space of the water the field lies on
+class RippleField
+{
+public:
+	static const unsigned int tileSize = 32;
+
+	//Resolution is rounded up to a multiple of tileSize
+	RippleField(const glm::vec2& origin, const glm::vec2& size, unsigned int resolution = 256);
+	~RippleField();
+	RippleField(const RippleField&) = delete;
+	RippleField& operator=(const RippleField&) = delete;
+
+	//Pushes the surface down by depth at position, easing out to nothing at radius
+	void disturb(const glm::vec2& position, float radius, float depth);
+	//Runs the steps due in deltaTime seconds, at most a few per call
+	void update(float deltaTime);
+	//Creates the texture on the first call, then sends the changed tiles
+	void upload();
+
+	//Height at a cell, x and y below getResolution
+	float getHeight(unsigned int x, unsigned int y) const { return heights[current][(y + 1) * stride + x + 1]; }
+	unsigned int getResolution() const { return resolution; }
+	const glm::vec2& getOrigin() const { return origin; }
+	const glm::vec2& getSize() const { return size; }
+	//Single channel float texture, row y and column x of the field
+	unsigned int getTexture() const { return texture; }
+	//Counts of the last update, and the tiles sent by the last upload
+	const RippleStats& getStats() const { return stats; }
+private:
+	void step();
+	void stepTile(unsigned int tile);
+	void zeroTile(unsigned int tile);
+
+	glm::vec2 origin;
+	glm::vec2 size;
+	unsigned int resolution;
+	unsigned int tilesPerSide;
+	//Row length with a border cell on each side, the border stays zero
+	unsigned int stride;
+	//Current heights and the previous ones, which each step overwrites with the next
+	std::vector<float> heights[2];
+	unsigned int current = 0;
+	float pending = 0;
+
+	std::vector<unsigned char> active;
+	std::vector<unsigned char> dirty;
+	//Largest height on each tile after its last step
+	std::vector<float> tilePeaks;
+	std::vector<unsigned int> stepping;
+	unsigned int texture = 0;
+	RippleStats stats;
+};
\ No newline at end of file
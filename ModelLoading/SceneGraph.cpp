@@ -0,0 +1,264 @@
+#include "SceneGraph.h"
+#include "SimdMath.h"
+#include "JobSystem.h"
+#include <algorithm>
+
+namespace
+{
+	//Nodes per job in the batch kernels of update, below this they run on the calling thread
+	const unsigned int batchSize = 4096;
+}
+
+const unsigned int SceneGraph::noNode;
+
+SceneGraph& SceneGraph::get()
+{
+	static SceneGraph graph;
+	return graph;
+}
+
+unsigned int SceneGraph::create(unsigned int parent)
+{
+	unsigned int node;
+	if (!freeNodes.empty())
+	{
+		node = freeNodes.back();
+		freeNodes.pop_back();
+		positions[node] = glm::vec3(0, 0, 0);
+		rotations[node] = glm::fquat(1, 0, 0, 0);
+		scales[node] = glm::vec3(1, 1, 1);
+		alive[node] = 1;
+	}
+	else
+	{
+		node = positions.size();
+		positions.push_back(glm::vec3(0, 0, 0));
+		rotations.push_back(glm::fquat(1, 0, 0, 0));
+		scales.push_back(glm::vec3(1, 1, 1));
+		parents.push_back(noNode);
+		locals.push_back(glm::mat4(1.0f));
+		worlds.push_back(glm::mat4(1.0f));
+		normalMatrices.push_back(glm::mat4(1.0f));
+		localDirty.push_back(0);
+		worldDirty.push_back(0);
+		alive.push_back(1);
+		localBounds.push_back(AABB());
+		proxies.push_back(noNode);
+	}
+	parents[node] = parent;
+	//A node destroyed while dirty is still queued, and is only composed once
+	markDirty(node);
+	hierarchyDirty = true;
+	++stats.nodes;
+	return node;
+}
+
+void SceneGraph::destroy(unsigned int node)
+{
+	for (unsigned int i = 0; i < parents.size(); ++i)
+	{
+		if (parents[i] == node)
+		{
+			parents[i] = noNode;
+			markDirty(i);
+		}
+	}
+	if (proxies[node] != noNode)
+	{
+		spatialIndex.remove(proxies[node]);
+		proxies[node] = noNode;
+	}
+	alive[node] = 0;
+	parents[node] = noNode;
+	freeNodes.push_back(node);
+	hierarchyDirty = true;
+	--stats.nodes;
+}
+
+void SceneGraph::setParent(unsigned int node, unsigned int parent)
+{
+	parents[node] = parent;
+	markDirty(node);
+	hierarchyDirty = true;
+}
+
+void SceneGraph::markDirty(unsigned int node)
+{
+	if (!localDirty[node])
+	{
+		localDirty[node] = 1;
+		dirtyNodes.push_back(node);
+	}
+}
+
+void SceneGraph::setPosition(unsigned int node, const glm::vec3& position)
+{
+	positions[node] = position;
+	markDirty(node);
+}
+
+void SceneGraph::setRotation(unsigned int node, const glm::fquat& rotation)
+{
+	rotations[node] = rotation;
+	markDirty(node);
+}
+
+void SceneGraph::setScale(unsigned int node, const glm::vec3& scale)
+{
+	scales[node] = scale;
+	markDirty(node);
+}
+
+void SceneGraph::setBounds(unsigned int node, const AABB& bounds)
+{
+	localBounds[node] = bounds;
+	if (proxies[node] == noNode)
+	{
+		//Placed properly by the next update
+		proxies[node] = spatialIndex.insert(bounds, node);
+	}
+	markDirty(node);
+}
+
+DynamicBvh& SceneGraph::getSpatialIndex()
+{
+	if (isDirty())
+	{
+		update();
+	}
+	return spatialIndex;
+}
+
+const glm::mat4& SceneGraph::getWorld(unsigned int node)
+{
+	if (isDirty())
+	{
+		update();
+	}
+	return worlds[node];
+}
+
+const glm::mat4& SceneGraph::getNormalMatrix(unsigned int node)
+{
+	if (isDirty())
+	{
+		update();
+	}
+	return normalMatrices[node];
+}
+
+void SceneGraph::gather(const unsigned int* nodes, size_t count, glm::mat4* worldsOut, glm::mat4* normalMatricesOut)
+{
+	if (isDirty())
+	{
+		update();
+	}
+	for (size_t i = 0; i < count; ++i)
+	{
+		worldsOut[i] = worlds[nodes[i]];
+	}
+	if (normalMatricesOut)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			normalMatricesOut[i] = normalMatrices[nodes[i]];
+		}
+	}
+}
+
+void SceneGraph::sortHierarchy()
+{
+	//Depth of every node, a parent always has a smaller depth than its children
+	depths.assign(parents.size(), 0);
+	for (unsigned int i = 0; i < parents.size(); ++i)
+	{
+		unsigned int depth = 0;
+		for (unsigned int parent = parents[i]; parent != noNode; parent = parents[parent])
+		{
+			++depth;
+		}
+		depths[i] = depth;
+	}
+	order.clear();
+	for (unsigned int i = 0; i < parents.size(); ++i)
+	{
+		if (alive[i])
+		{
+			order.push_back(i);
+		}
+	}
+	std::stable_sort(order.begin(), order.end(), [this](unsigned int a, unsigned int b) { return depths[a] < depths[b]; });
+	hierarchyDirty = false;
+}
+
+void SceneGraph::update()
+{
+	if (hierarchyDirty)
+	{
+		sortHierarchy();
+	}
+
+	//Local matrices of the changed nodes, four at a time and split over jobs for large changes
+	JobSystem& jobs = JobSystem::get();
+	jobs.parallelFor(dirtyNodes.size(), batchSize, [this](unsigned int begin, unsigned int end)
+	{
+		simd::composeTRS(positions.data(), rotations.data(), scales.data(), locals.data(), end - begin, dirtyNodes.data() + begin);
+	});
+	for (unsigned int node : dirtyNodes)
+	{
+		localDirty[node] = 0;
+		worldDirty[node] = 1;
+	}
+	dirtyNodes.clear();
+
+	//A changed parent dirties the child before the child is reached, so whole subtrees follow
+	changedNodes.clear();
+	for (unsigned int node : order)
+	{
+		unsigned int parent = parents[node];
+		if (parent != noNode && worldDirty[parent])
+		{
+			worldDirty[node] = 1;
+		}
+		if (worldDirty[node])
+		{
+			if (parent == noNode)
+			{
+				worlds[node] = locals[node];
+			}
+			else
+			{
+				simd::multiply(worlds[parent], locals[node], worlds[node]);
+			}
+			changedNodes.push_back(node);
+		}
+	}
+
+	jobs.parallelFor(changedNodes.size(), batchSize, [this](unsigned int begin, unsigned int end)
+	{
+		simd::normalMatrices(worlds.data(), normalMatrices.data(), end - begin, changedNodes.data() + begin);
+	});
+	for (unsigned int node : changedNodes)
+	{
+		worldDirty[node] = 0;
+		if (proxies[node] != noNode)
+		{
+			AABB bounds;
+			simd::transformAABBs(worlds[node], &localBounds[node], &bounds, 1);
+			spatialIndex.update(proxies[node], bounds);
+		}
+	}
+	spatialIndex.rebuildIfNeeded();
+	stats.nodesUpdated = changedNodes.size();
+	++stats.updates;
+}
+
+SceneObject::SceneObject()
+{
+	node = SceneGraph::get().create();
+}
+
+SceneObject::~SceneObject()
+{
+	SceneGraph::get().destroy(node);
+}
\ No newline at end of file
@@ -0,0 +1,117 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "DynamicBvh.h"
+
+struct SceneGraphStats
+{
+	unsigned int nodes = 0;
+	//World and normal matrices recomputed by the last update
+	unsigned int nodesUpdated = 0;
+	unsigned int updates = 0;
+};
+
+//Local transforms of every object in the scene, stored as separate arrays per component so the
+//update loops walk contiguous memory. Nodes are kept in an order where parents come before their
+//children, so one pass over that order propagates the world matrices down the hierarchy, and only
+//nodes that changed or have a changed parent are recomputed
+class SceneGraph
+{
+public:
+	static const unsigned int noNode = 0xFFFFFFFF;
+
+	//Shared by every SceneObject
+	static SceneGraph& get();
+
+	unsigned int create(unsigned int parent = noNode);
+	//Children of the node are moved to the root with their current local transform
+	void destroy(unsigned int node);
+	void setParent(unsigned int node, unsigned int parent);
+	unsigned int getParent(unsigned int node) const { return parents[node]; }
+
+	void setPosition(unsigned int node, const glm::vec3& position);
+	void setRotation(unsigned int node, const glm::fquat& rotation);
+	void setScale(unsigned int node, const glm::vec3& scale);
+	const glm::vec3& getPosition(unsigned int node) const { return positions[node]; }
+	const glm::fquat& getRotation(unsigned int node) const { return rotations[node]; }
+	const glm::vec3& getScale(unsigned int node) const { return scales[node]; }
+
+	//Both run update first when something changed. Not safe while other threads read the graph,
+	//so update once before handing nodes out to worker threads
+	const glm::mat4& getWorld(unsigned int node);
+	const glm::mat4& getNormalMatrix(unsigned int node);
+	//World matrices of many nodes copied into packed arrays, normal matrices too when given
+	void gather(const unsigned int* nodes, size_t count, glm::mat4* worldsOut, glm::mat4* normalMatricesOut = nullptr);
+
+	//Puts the node in the spatial index with the box transformed by its world matrix, every
+	//update refits the moved ones. Leaves in the index carry the node as their object
+	void setBounds(unsigned int node, const AABB& localBounds);
+	//Updated first like getWorld
+	DynamicBvh& getSpatialIndex();
+
+	void update();
+	bool isDirty() const { return !dirtyNodes.empty() || hierarchyDirty; }
+	const SceneGraphStats& getStats() const { return stats; }
+private:
+	SceneGraph() {}
+	SceneGraph(const SceneGraph&) = delete;
+	SceneGraph& operator=(const SceneGraph&) = delete;
+
+	void markDirty(unsigned int node);
+	void sortHierarchy();
+
+	std::vector<glm::vec3> positions;
+	std::vector<glm::fquat> rotations;
+	std::vector<glm::vec3> scales;
+	std::vector<unsigned int> parents;
+	std::vector<glm::mat4> locals;
+	std::vector<glm::mat4> worlds;
+	std::vector<glm::mat4> normalMatrices;
+	//1 when the local transform changed since the last update
+	std::vector<unsigned char> localDirty;
+	//Set during update for every node whose world matrix has to be rebuilt
+	std::vector<unsigned char> worldDirty;
+	std::vector<unsigned char> alive;
+	std::vector<AABB> localBounds;
+	//Leaf in the spatial index, noNode for nodes without bounds
+	std::vector<unsigned int> proxies;
+	DynamicBvh spatialIndex;
+
+	std::vector<unsigned int> freeNodes;
+	std::vector<unsigned int> dirtyNodes;
+	std::vector<unsigned int> changedNodes;
+	//Parents before children, rebuilt when the hierarchy changes
+	std::vector<unsigned int> order;
+	std::vector<unsigned int> depths;
+	bool hierarchyDirty = false;
+	SceneGraphStats stats;
+};
+
+//Owns a node in the shared SceneGraph, base of everything that is placed in the scene
+class SceneObject
+{
+public:
+	SceneObject();
+	~SceneObject();
+	SceneObject(const SceneObject&) = delete;
+	SceneObject& operator=(const SceneObject&) = delete;
+
+	void setPosition(const glm::vec3& position) { SceneGraph::get().setPosition(node, position); }
+	void setRotation(const glm::fquat& rotation) { SceneGraph::get().setRotation(node, rotation); }
+	void setScale(const glm::vec3& scale) { SceneGraph::get().setScale(node, scale); }
+	glm::vec3 getPosition() const { return SceneGraph::get().getPosition(node); }
+	glm::fquat getRotation() const { return SceneGraph::get().getRotation(node); }
+	glm::vec3 getScale() const { return SceneGraph::get().getScale(node); }
+
+	//The local transform becomes relative to the parent
+	void setParent(const SceneObject& parent) { SceneGraph::get().setParent(node, parent.node); }
+	void setParent(unsigned int parentNode) { SceneGraph::get().setParent(node, parentNode); }
+	unsigned int getNode() const { return node; }
+
+	//World transform, translation * rotation * scale composed with every parent
+	glm::mat4 getTransform() const { return SceneGraph::get().getWorld(node); }
+	glm::mat4 getNormalMatrix() const { return SceneGraph::get().getNormalMatrix(node); }
+protected:
+	unsigned int node;
+};
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "Shader.h"
+#include "UniformBlocks.h"
 #include <glad/glad.h>
 #include <iostream>
 
@@ -40,4 +41,20 @@ Shader::Shader(const char* vertSource, const char* fragSource)
 	checkShader(ID, true);
 
 	glLinkProgram(ID);
+	bindUniformBlocks();
+}
+
+void Shader::bindUniformBlocks()
+{
+	//Blocks the program does not declare, or the compiler optimized away, are skipped
+	const char* names[] = { "FrameData", "ObjectData", "LightData", "MaterialData", "WaveData" };
+	const unsigned int bindings[] = { FrameData::binding, ObjectData::binding, LightData::binding, MaterialData::binding, WaveData::binding };
+	for (int i = 0; i < 5; ++i)
+	{
+		unsigned int index = glGetUniformBlockIndex(ID, names[i]);
+		if (index != GL_INVALID_INDEX)
+		{
+			glUniformBlockBinding(ID, index, bindings[i]);
+		}
+	}
 }
\ No newline at end of file
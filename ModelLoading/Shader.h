@@ -8,5 +8,6 @@ public:
 	void use();
 private:
 	void checkShader(int id, bool link = false);
+	void bindUniformBlocks();
 	unsigned int ID;
 };
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include "SimdAvx.h"
+#include <immintrin.h>
+
+namespace simd
+{
+	namespace avx
+	{
+		void multiply(const float* a, size_t aStride, const float* b, float* out, size_t count)
+		{
+			for (size_t i = 0; i < count; ++i, a += aStride, b += 16, out += 16)
+			{
+				//Two result columns per iteration, each 128 bit half takes the x, y, z, w of its own column
+				__m256 wideA0 = _mm256_broadcast_ps((const __m128*)a);
+				__m256 wideA1 = _mm256_broadcast_ps((const __m128*)(a + 4));
+				__m256 wideA2 = _mm256_broadcast_ps((const __m128*)(a + 8));
+				__m256 wideA3 = _mm256_broadcast_ps((const __m128*)(a + 12));
+				__m256 b01 = _mm256_loadu_ps(b);
+				__m256 b23 = _mm256_loadu_ps(b + 8);
+				__m256 r01 = _mm256_mul_ps(wideA0, _mm256_shuffle_ps(b01, b01, 0x00));
+				r01 = _mm256_add_ps(r01, _mm256_mul_ps(wideA1, _mm256_shuffle_ps(b01, b01, 0x55)));
+				r01 = _mm256_add_ps(r01, _mm256_mul_ps(wideA2, _mm256_shuffle_ps(b01, b01, 0xAA)));
+				r01 = _mm256_add_ps(r01, _mm256_mul_ps(wideA3, _mm256_shuffle_ps(b01, b01, 0xFF)));
+				__m256 r23 = _mm256_mul_ps(wideA0, _mm256_shuffle_ps(b23, b23, 0x00));
+				r23 = _mm256_add_ps(r23, _mm256_mul_ps(wideA1, _mm256_shuffle_ps(b23, b23, 0x55)));
+				r23 = _mm256_add_ps(r23, _mm256_mul_ps(wideA2, _mm256_shuffle_ps(b23, b23, 0xAA)));
+				r23 = _mm256_add_ps(r23, _mm256_mul_ps(wideA3, _mm256_shuffle_ps(b23, b23, 0xFF)));
+				_mm256_storeu_ps(out, r01);
+				_mm256_storeu_ps(out + 8, r23);
+			}
+			_mm256_zeroupper();
+		}
+
+		size_t cullSpheres(const float* planes, const float* spheres, size_t count, unsigned char* visible)
+		{
+			size_t i = 0;
+			for (; i + 8 <= count; i += 8)
+			{
+				//Two groups of four transposed into center x, y, z and radius lanes
+				const float* s = spheres + i * 4;
+				__m128 a0 = _mm_loadu_ps(s), a1 = _mm_loadu_ps(s + 4), a2 = _mm_loadu_ps(s + 8), a3 = _mm_loadu_ps(s + 12);
+				__m128 b0 = _mm_loadu_ps(s + 16), b1 = _mm_loadu_ps(s + 20), b2 = _mm_loadu_ps(s + 24), b3 = _mm_loadu_ps(s + 28);
+				_MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+				_MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+				__m256 x = _mm256_insertf128_ps(_mm256_castps128_ps256(a0), b0, 1);
+				__m256 y = _mm256_insertf128_ps(_mm256_castps128_ps256(a1), b1, 1);
+				__m256 z = _mm256_insertf128_ps(_mm256_castps128_ps256(a2), b2, 1);
+				__m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_insertf128_ps(_mm256_castps128_ps256(a3), b3, 1));
+				__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+				for (int p = 0; p < 6; ++p)
+				{
+					const float* plane = planes + p * 4;
+					__m256 distance = _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(plane[0])), _mm256_set1_ps(plane[3]));
+					distance = _mm256_add_ps(distance, _mm256_mul_ps(y, _mm256_set1_ps(plane[1])));
+					distance = _mm256_add_ps(distance, _mm256_mul_ps(z, _mm256_set1_ps(plane[2])));
+					inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+				}
+				int mask = _mm256_movemask_ps(inside);
+				for (int lane = 0; lane < 8; ++lane)
+				{
+					visible[i + lane] = (mask >> lane) & 1;
+				}
+			}
+			_mm256_zeroupper();
+			return i;
+		}
+
+		void inverseFft(float* buffers[4], unsigned int size, const float* twiddleRe, const float* twiddleIm)
+		{
+			const unsigned int laneCount = 8;
+			float* xRe = buffers[0];
+			float* xIm = buffers[1];
+			float* yRe = buffers[2];
+			float* yIm = buffers[3];
+			for (unsigned int n = size, s = 1; n > 1; n /= 2, s *= 2)
+			{
+				unsigned int half = n / 2;
+				unsigned int step = size / n;
+				for (unsigned int p = 0; p < half; ++p)
+				{
+					__m256 wRe = _mm256_set1_ps(twiddleRe[p * step]);
+					__m256 wIm = _mm256_set1_ps(twiddleIm[p * step]);
+					for (unsigned int q = 0; q < s; ++q)
+					{
+						unsigned int a = (q + s * p) * laneCount;
+						unsigned int b = (q + s * (p + half)) * laneCount;
+						unsigned int sum = (q + s * 2 * p) * laneCount;
+						unsigned int difference = sum + s * laneCount;
+						__m256 aRe = _mm256_loadu_ps(xRe + a);
+						__m256 aIm = _mm256_loadu_ps(xIm + a);
+						__m256 bRe = _mm256_loadu_ps(xRe + b);
+						__m256 bIm = _mm256_loadu_ps(xIm + b);
+						__m256 dRe = _mm256_sub_ps(aRe, bRe);
+						__m256 dIm = _mm256_sub_ps(aIm, bIm);
+						_mm256_storeu_ps(yRe + sum, _mm256_add_ps(aRe, bRe));
+						_mm256_storeu_ps(yIm + sum, _mm256_add_ps(aIm, bIm));
+						_mm256_storeu_ps(yRe + difference, _mm256_sub_ps(_mm256_mul_ps(dRe, wRe), _mm256_mul_ps(dIm, wIm)));
+						_mm256_storeu_ps(yIm + difference, _mm256_add_ps(_mm256_mul_ps(dRe, wIm), _mm256_mul_ps(dIm, wRe)));
+					}
+				}
+				//Swapped by hand, std::swap built here could replace the one the rest of the program uses
+				float* re = xRe;
+				float* im = xIm;
+				xRe = yRe;
+				xIm = yIm;
+				yRe = re;
+				yIm = im;
+			}
+			buffers[0] = xRe;
+			buffers[1] = xIm;
+			buffers[2] = yRe;
+			buffers[3] = yIm;
+			_mm256_zeroupper();
+		}
+	}
+}
\ No newline at end of file
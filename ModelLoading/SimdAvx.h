@@ -0,0 +1,21 @@
+#pragma once
+#include <cstddef>
+
+//The AVX kernels, the only code built with /arch:AVX2. Callers check simd::hasAvx2 first and keep
+//an SSE2 path, so the program still runs on CPUs without AVX. The file takes raw floats and uses
+//nothing but intrinsics, because an inline glm or std function compiled here could be picked by the
+//linker for the whole program
+namespace simd
+{
+	namespace avx
+	{
+		//out[i] = a[i] * b[i] for column major mat4s, a steps by aStride floats so 0 applies one matrix
+		//to every b. out may alias a or b
+		void multiply(const float* a, size_t aStride, const float* b, float* out, size_t count);
+		//Sphere test of FrustumCuller::cullSpheres, eight spheres at a time against six planes. Returns
+		//how many spheres it handled, the rest are left to the caller
+		size_t cullSpheres(const float* planes, const float* spheres, size_t count, unsigned char* visible);
+		//Inverse FFT of eight sequences side by side, the layout and passes of FftOcean's SSE version
+		void inverseFft(float* buffers[4], unsigned int size, const float* twiddleRe, const float* twiddleIm);
+	}
+}
\ No newline at end of file
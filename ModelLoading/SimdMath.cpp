@@ -0,0 +1,275 @@
+#include "SimdMath.h"
+#include "SimdAvx.h"
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+	inline __m128 loadVec3(const glm::vec3& v, float w)
+	{
+		return _mm_set_ps(w, v.z, v.y, v.x);
+	}
+
+	//a x b with three shuffles instead of four, w stays 0 for w = 0 inputs
+	inline __m128 cross(__m128 a, __m128 b)
+	{
+		__m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+		__m128 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+		__m128 c = _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b));
+		return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+	}
+
+	//Sum of the lanes in every lane
+	inline __m128 dot(__m128 a, __m128 b)
+	{
+		__m128 product = _mm_mul_ps(a, b);
+		__m128 swapped = _mm_shuffle_ps(product, product, _MM_SHUFFLE(2, 3, 0, 1));
+		__m128 sums = _mm_add_ps(product, swapped);
+		swapped = _mm_shuffle_ps(sums, sums, _MM_SHUFFLE(1, 0, 3, 2));
+		return _mm_add_ps(sums, swapped);
+	}
+
+	//Columns of b are read before anything is written, so out may alias a or b
+	inline void multiplyOne(const float* a, const float* b, float* out)
+	{
+		__m128 a0 = _mm_loadu_ps(a);
+		__m128 a1 = _mm_loadu_ps(a + 4);
+		__m128 a2 = _mm_loadu_ps(a + 8);
+		__m128 a3 = _mm_loadu_ps(a + 12);
+		__m128 r[4];
+		for (int j = 0; j < 4; ++j)
+		{
+			const float* column = b + j * 4;
+			__m128 c = _mm_mul_ps(a0, _mm_set1_ps(column[0]));
+			c = _mm_add_ps(c, _mm_mul_ps(a1, _mm_set1_ps(column[1])));
+			c = _mm_add_ps(c, _mm_mul_ps(a2, _mm_set1_ps(column[2])));
+			c = _mm_add_ps(c, _mm_mul_ps(a3, _mm_set1_ps(column[3])));
+			r[j] = c;
+		}
+		for (int j = 0; j < 4; ++j)
+		{
+			_mm_storeu_ps(out + j * 4, r[j]);
+		}
+	}
+
+	inline void normalMatrixOne(const float* m, float* out)
+	{
+		const __m128 xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+		__m128 c0 = _mm_and_ps(_mm_loadu_ps(m), xyzMask);
+		__m128 c1 = _mm_and_ps(_mm_loadu_ps(m + 4), xyzMask);
+		__m128 c2 = _mm_and_ps(_mm_loadu_ps(m + 8), xyzMask);
+		//The rows of the inverse are the cross products over the determinant, so they are the columns of the inverse transpose
+		__m128 n0 = cross(c1, c2);
+		__m128 n1 = cross(c2, c0);
+		__m128 n2 = cross(c0, c1);
+		__m128 inverseDeterminant = _mm_div_ps(_mm_set1_ps(1.0f), dot(c0, n0));
+		_mm_storeu_ps(out, _mm_mul_ps(n0, inverseDeterminant));
+		_mm_storeu_ps(out + 4, _mm_mul_ps(n1, inverseDeterminant));
+		_mm_storeu_ps(out + 8, _mm_mul_ps(n2, inverseDeterminant));
+		_mm_storeu_ps(out + 12, _mm_set_ps(1, 0, 0, 0));
+	}
+
+	inline void composeOne(const glm::vec3& position, const glm::fquat& q, const glm::vec3& scale, glm::mat4& out)
+	{
+		float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+		float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+		float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+		out[0] = glm::vec4(1 - 2 * (yy + zz), 2 * (xy + wz), 2 * (xz - wy), 0) * scale.x;
+		out[1] = glm::vec4(2 * (xy - wz), 1 - 2 * (xx + zz), 2 * (yz + wx), 0) * scale.y;
+		out[2] = glm::vec4(2 * (xz + wy), 2 * (yz - wx), 1 - 2 * (xx + yy), 0) * scale.z;
+		out[3] = glm::vec4(position, 1);
+	}
+
+	inline void transformAABBOne(const float* m, const AABB& in, AABB& out)
+	{
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+		__m128 boxMin = loadVec3(in.min, 0);
+		__m128 boxMax = loadVec3(in.max, 0);
+		__m128 center = _mm_mul_ps(_mm_add_ps(boxMin, boxMax), half);
+		__m128 extent = _mm_mul_ps(_mm_sub_ps(boxMax, boxMin), half);
+		__m128 c0 = _mm_loadu_ps(m);
+		__m128 c1 = _mm_loadu_ps(m + 4);
+		__m128 c2 = _mm_loadu_ps(m + 8);
+		__m128 c3 = _mm_loadu_ps(m + 12);
+
+		//The center moves with the matrix, the extent grows by the absolute value of the 3x3 part
+		__m128 newCenter = _mm_add_ps(c3, _mm_mul_ps(c0, _mm_shuffle_ps(center, center, _MM_SHUFFLE(0, 0, 0, 0))));
+		newCenter = _mm_add_ps(newCenter, _mm_mul_ps(c1, _mm_shuffle_ps(center, center, _MM_SHUFFLE(1, 1, 1, 1))));
+		newCenter = _mm_add_ps(newCenter, _mm_mul_ps(c2, _mm_shuffle_ps(center, center, _MM_SHUFFLE(2, 2, 2, 2))));
+		__m128 newExtent = _mm_mul_ps(_mm_and_ps(c0, absMask), _mm_shuffle_ps(extent, extent, _MM_SHUFFLE(0, 0, 0, 0)));
+		newExtent = _mm_add_ps(newExtent, _mm_mul_ps(_mm_and_ps(c1, absMask), _mm_shuffle_ps(extent, extent, _MM_SHUFFLE(1, 1, 1, 1))));
+		newExtent = _mm_add_ps(newExtent, _mm_mul_ps(_mm_and_ps(c2, absMask), _mm_shuffle_ps(extent, extent, _MM_SHUFFLE(2, 2, 2, 2))));
+
+		alignas(16) float lower[4];
+		alignas(16) float upper[4];
+		_mm_store_ps(lower, _mm_sub_ps(newCenter, newExtent));
+		_mm_store_ps(upper, _mm_add_ps(newCenter, newExtent));
+		out.min = glm::vec3(lower[0], lower[1], lower[2]);
+		out.max = glm::vec3(upper[0], upper[1], upper[2]);
+	}
+
+	inline void storeColumns(__m128 x, __m128 y, __m128 z, __m128 w, glm::mat4* out[4], int column)
+	{
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		_mm_storeu_ps(&(*out[0])[column][0], x);
+		_mm_storeu_ps(&(*out[1])[column][0], y);
+		_mm_storeu_ps(&(*out[2])[column][0], z);
+		_mm_storeu_ps(&(*out[3])[column][0], w);
+	}
+}
+
+namespace simd
+{
+	void composeTRS(const glm::vec3* positions, const glm::fquat* rotations, const glm::vec3* scales, glm::mat4* out, size_t count, const unsigned int* indices)
+	{
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 two = _mm_set1_ps(2.0f);
+		const __m128 zero = _mm_setzero_ps();
+		size_t i = 0;
+		//Four objects at once, one object per lane, transposed back into columns on the way out
+		for (; i + 4 <= count; i += 4)
+		{
+			unsigned int n[4];
+			for (int lane = 0; lane < 4; ++lane)
+			{
+				n[lane] = indices ? indices[i + lane] : (unsigned int)(i + lane);
+			}
+			const glm::fquat& q0 = rotations[n[0]];
+			const glm::fquat& q1 = rotations[n[1]];
+			const glm::fquat& q2 = rotations[n[2]];
+			const glm::fquat& q3 = rotations[n[3]];
+			__m128 x = _mm_set_ps(q3.x, q2.x, q1.x, q0.x);
+			__m128 y = _mm_set_ps(q3.y, q2.y, q1.y, q0.y);
+			__m128 z = _mm_set_ps(q3.z, q2.z, q1.z, q0.z);
+			__m128 w = _mm_set_ps(q3.w, q2.w, q1.w, q0.w);
+			__m128 sx = _mm_set_ps(scales[n[3]].x, scales[n[2]].x, scales[n[1]].x, scales[n[0]].x);
+			__m128 sy = _mm_set_ps(scales[n[3]].y, scales[n[2]].y, scales[n[1]].y, scales[n[0]].y);
+			__m128 sz = _mm_set_ps(scales[n[3]].z, scales[n[2]].z, scales[n[1]].z, scales[n[0]].z);
+
+			__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+			__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+			__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+			glm::mat4* targets[4] = { &out[n[0]], &out[n[1]], &out[n[2]], &out[n[3]] };
+			storeColumns(
+				_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx),
+				_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx),
+				_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx),
+				zero, targets, 0);
+			storeColumns(
+				_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy),
+				_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy),
+				_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy),
+				zero, targets, 1);
+			storeColumns(
+				_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz),
+				_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz),
+				_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz),
+				zero, targets, 2);
+			storeColumns(
+				_mm_set_ps(positions[n[3]].x, positions[n[2]].x, positions[n[1]].x, positions[n[0]].x),
+				_mm_set_ps(positions[n[3]].y, positions[n[2]].y, positions[n[1]].y, positions[n[0]].y),
+				_mm_set_ps(positions[n[3]].z, positions[n[2]].z, positions[n[1]].z, positions[n[0]].z),
+				one, targets, 3);
+		}
+		for (; i < count; ++i)
+		{
+			unsigned int n = indices ? indices[i] : (unsigned int)i;
+			composeOne(positions[n], rotations[n], scales[n], out[n]);
+		}
+	}
+
+	bool hasAvx2()
+	{
+		//Asked once. The OS has to save the wide registers too, which XGETBV reports
+		static const bool supported = []()
+		{
+#if defined(_MSC_VER)
+			int info[4];
+			__cpuid(info, 0);
+			if (info[0] < 7)
+			{
+				return false;
+			}
+			__cpuid(info, 1);
+			bool osSavesRegisters = (info[2] & (1 << 27)) != 0;
+			bool avx = (info[2] & (1 << 28)) != 0;
+			if (!osSavesRegisters || !avx || (_xgetbv(0) & 6) != 6)
+			{
+				return false;
+			}
+			__cpuidex(info, 7, 0);
+			return (info[1] & (1 << 5)) != 0;
+#else
+			return __builtin_cpu_supports("avx2") != 0;
+#endif
+		}();
+		return supported;
+	}
+
+	void multiply(const glm::mat4* a, const glm::mat4* b, glm::mat4* out, size_t count)
+	{
+		if (hasAvx2())
+		{
+			avx::multiply(&a[0][0][0], 16, &b[0][0][0], &out[0][0][0], count);
+			return;
+		}
+		for (size_t i = 0; i < count; ++i)
+		{
+			multiplyOne(&a[i][0][0], &b[i][0][0], &out[i][0][0]);
+		}
+	}
+
+	void multiply(const glm::mat4& a, const glm::mat4* b, glm::mat4* out, size_t count)
+	{
+		if (hasAvx2())
+		{
+			avx::multiply(&a[0][0], 0, &b[0][0][0], &out[0][0][0], count);
+			return;
+		}
+		for (size_t i = 0; i < count; ++i)
+		{
+			multiplyOne(&a[0][0], &b[i][0][0], &out[i][0][0]);
+		}
+	}
+
+	void multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out)
+	{
+		multiplyOne(&a[0][0], &b[0][0], &out[0][0]);
+	}
+
+	void normalMatrices(const glm::mat4* models, glm::mat4* out, size_t count, const unsigned int* indices)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			size_t n = indices ? indices[i] : i;
+			normalMatrixOne(&models[n][0][0], &out[n][0][0]);
+		}
+	}
+
+	glm::mat4 normalMatrix(const glm::mat4& model)
+	{
+		glm::mat4 result;
+		normalMatrixOne(&model[0][0], &result[0][0]);
+		return result;
+	}
+
+	void transformAABBs(const glm::mat4* models, const AABB* in, AABB* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			transformAABBOne(&models[i][0][0], in[i], out[i]);
+		}
+	}
+
+	void transformAABBs(const glm::mat4& model, const AABB* in, AABB* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			transformAABBOne(&model[0][0], in[i], out[i]);
+		}
+	}
+}
\ No newline at end of file
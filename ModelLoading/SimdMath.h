@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+struct AABB
+{
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+//Batch kernels for the matrix work done per object every frame. SSE2 is the baseline, the wider
+//kernels in SimdAvx run instead when hasAvx2 finds the CPU supports them. Results match the glm
+//expressions noted on each function up to float rounding.
+//Where an indices array is taken, element i of the batch is indices[i] in every input and output
+//array, which lets the scene graph run a kernel over only its dirty nodes
+namespace simd
+{
+	//Whether the CPU and the OS support AVX2, asked once
+	bool hasAvx2();
+	//translate(position) * toMat4(rotation) * scale(scale)
+	void composeTRS(const glm::vec3* positions, const glm::fquat* rotations, const glm::vec3* scales, glm::mat4* out, size_t count, const unsigned int* indices = nullptr);
+	//a[i] * b[i]
+	void multiply(const glm::mat4* a, const glm::mat4* b, glm::mat4* out, size_t count);
+	//a * b[i], for a parent or a view projection applied to many matrices
+	void multiply(const glm::mat4& a, const glm::mat4* b, glm::mat4* out, size_t count);
+	void multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out);
+	//mat4(transpose(inverse(mat3(models[i]))))
+	void normalMatrices(const glm::mat4* models, glm::mat4* out, size_t count, const unsigned int* indices = nullptr);
+	glm::mat4 normalMatrix(const glm::mat4& model);
+	//Smallest box around the transformed corners of in[i]
+	void transformAABBs(const glm::mat4* models, const AABB* in, AABB* out, size_t count);
+	//Every box by the same matrix, the sub meshes of one model
+	void transformAABBs(const glm::mat4& model, const AABB* in, AABB* out, size_t count);
+}
\ No newline at end of file
@@ -0,0 +1,196 @@
+#include "Skeleton.h"
+#include "SimdMath.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cmath>
+#include <exception>
+
+unsigned int Skeleton::addJoint(const std::string& name, int parent, const glm::vec3& position, const glm::fquat& rotation, const glm::vec3& scale)
+{
+	unsigned int index = parents.size();
+	parents.push_back(parent);
+	bindPositions.push_back(position);
+	bindRotations.push_back(rotation);
+	bindScales.push_back(scale);
+	bindLocals.push_back(glm::mat4(1.0f));
+	simd::composeTRS(&position, &rotation, &scale, &bindLocals.back(), 1);
+	//Names are not unique in every file, bones bind to the first joint with theirs
+	jointIndices.insert(std::make_pair(name, index));
+	return index;
+}
+
+int Skeleton::findJoint(const std::string& name) const
+{
+	auto found = jointIndices.find(name);
+	return found == jointIndices.end() ? -1 : (int)found->second;
+}
+
+unsigned int Skeleton::addBone(const std::string& jointName, const glm::mat4& offset)
+{
+	int joint = findJoint(jointName);
+	if (joint < 0)
+	{
+		throw std::exception("Bone without a matching node!");
+	}
+	for (unsigned int i = 0; i < boneJoints.size(); ++i)
+	{
+		if (boneJoints[i] == (unsigned int)joint)
+		{
+			return i;
+		}
+	}
+	if (boneJoints.size() >= maxBones)
+	{
+		throw std::exception("Too many bones, vertices address at most 256!");
+	}
+	boneJoints.push_back(joint);
+	boneOffsets.push_back(offset);
+	return boneJoints.size() - 1;
+}
+
+void Skeleton::computePalette(const glm::mat4* locals, glm::mat4* globals, glm::mat4* palette) const
+{
+	for (unsigned int i = 0; i < parents.size(); ++i)
+	{
+		if (parents[i] < 0)
+		{
+			globals[i] = locals[i];
+		}
+		else
+		{
+			simd::multiply(globals[parents[i]], locals[i], globals[i]);
+		}
+	}
+	for (unsigned int i = 0; i < boneJoints.size(); ++i)
+	{
+		glm::mat4 bone;
+		simd::multiply(globals[boneJoints[i]], boneOffsets[i], bone);
+		simd::multiply(globalInverse, bone, palette[i]);
+	}
+}
+
+Animator::Animator(const Skeleton& skeleton, const std::vector<CompressedClip>& clips)
+{
+	this->skeleton = &skeleton;
+	this->clips = &clips;
+	globals.resize(skeleton.getJointCount());
+	palette.resize(skeleton.getBoneCount());
+	play(-1);
+}
+
+void Animator::resetPose()
+{
+	positions = skeleton->getBindPositions();
+	rotations = skeleton->getBindRotations();
+	scales = skeleton->getBindScales();
+	locals = skeleton->getBindPose();
+}
+
+void Animator::play(int clip, bool loop)
+{
+	this->clip = clip < (int)clips->size() ? clip : -1;
+	this->loop = loop;
+	time = 0;
+	previousClip = -1;
+	//Joints the new clip does not animate go back to the bind pose
+	resetPose();
+	if (this->clip < 0)
+	{
+		skeleton->computePalette(locals.data(), globals.data(), palette.data());
+		return;
+	}
+	update(0);
+}
+
+void Animator::crossFade(int clip, float duration, bool loop)
+{
+	if (this->clip < 0 || duration <= 0)
+	{
+		play(clip, loop);
+		return;
+	}
+	previousClip = this->clip;
+	previousTime = time;
+	previousLoop = this->loop;
+	fadeDuration = duration;
+	fadeElapsed = 0;
+	this->clip = clip < (int)clips->size() ? clip : -1;
+	this->loop = loop;
+	time = 0;
+	if (this->clip < 0)
+	{
+		play(-1);
+		return;
+	}
+	update(0);
+}
+
+float Animator::advance(const CompressedClip& playing, float time, float deltaTime, bool loop) const
+{
+	time += deltaTime;
+	float duration = playing.getDuration();
+	if (duration <= 0)
+	{
+		return 0;
+	}
+	if (!loop)
+	{
+		return std::min(time, duration);
+	}
+	time = std::fmod(time, duration);
+	return time < 0 ? time + duration : time;
+}
+
+void Animator::update(float deltaTime)
+{
+	if (clip < 0)
+	{
+		return;
+	}
+	const CompressedClip& playing = (*clips)[clip];
+	time = advance(playing, time, deltaTime, loop);
+	if (previousClip >= 0)
+	{
+		fadeElapsed += deltaTime;
+		if (fadeElapsed >= fadeDuration)
+		{
+			//Whatever only the old clip moved returns to the bind pose
+			previousClip = -1;
+			resetPose();
+		}
+	}
+
+	if (previousClip >= 0)
+	{
+		const CompressedClip& previous = (*clips)[previousClip];
+		previousTime = advance(previous, previousTime, deltaTime, previousLoop);
+		previous.sample(previousTime, positions.data(), rotations.data(), scales.data());
+		playing.sample(time, positions.data(), rotations.data(), scales.data(), fadeElapsed / fadeDuration);
+		simd::composeTRS(positions.data(), rotations.data(), scales.data(), locals.data(), previous.getJoints().size(), previous.getJoints().data());
+	}
+	else
+	{
+		playing.sample(time, positions.data(), rotations.data(), scales.data());
+	}
+	simd::composeTRS(positions.data(), rotations.data(), scales.data(), locals.data(), playing.getJoints().size(), playing.getJoints().data());
+	skeleton->computePalette(locals.data(), globals.data(), palette.data());
+}
+
+void Animator::updateAll(Animator* animators, unsigned int count, float deltaTime)
+{
+	//A character is a few microseconds of work, batches keep the job overhead small next to it
+	const unsigned int batchSize = 16;
+	JobSystem::get().parallelFor(count, batchSize, [animators, deltaTime](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; ++i)
+		{
+			animators[i].update(deltaTime);
+		}
+	});
+}
+
+size_t Animator::getMemoryBytes() const
+{
+	return sizeof(Animator) + (positions.capacity() + scales.capacity()) * sizeof(glm::vec3) + rotations.capacity() * sizeof(glm::fquat)
+		+ (locals.capacity() + globals.capacity() + palette.capacity()) * sizeof(glm::mat4);
+}
\ No newline at end of file
@@ -0,0 +1,91 @@
+#pragma once
+#include "AnimationClip.h"
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+//Joint hierarchy of a skinned model. Every node of the file becomes a joint, stored parents first
+//so one pass resolves the global transforms. Bones are the joints meshes are bound to, the vertices
+//reference them by bone index and the palette holds one matrix per bone
+class Skeleton
+{
+public:
+	static const unsigned int maxBones = 256;
+
+	//The bind pose is kept as a transform rather than a matrix so clips can blend from it
+	unsigned int addJoint(const std::string& name, int parent, const glm::vec3& position, const glm::fquat& rotation, const glm::vec3& scale);
+	//Returns the existing bone when another mesh already bound the joint
+	unsigned int addBone(const std::string& jointName, const glm::mat4& offset);
+	int findJoint(const std::string& name) const;
+	//Inverse of the root transform, so the palette is in model space
+	void setGlobalInverse(const glm::mat4& globalInverse) { this->globalInverse = globalInverse; }
+
+	unsigned int getJointCount() const { return parents.size(); }
+	unsigned int getBoneCount() const { return boneJoints.size(); }
+	const std::vector<glm::mat4>& getBindPose() const { return bindLocals; }
+	const std::vector<glm::vec3>& getBindPositions() const { return bindPositions; }
+	const std::vector<glm::fquat>& getBindRotations() const { return bindRotations; }
+	const std::vector<glm::vec3>& getBindScales() const { return bindScales; }
+
+	//Local joint transforms to palette matrices, globals is scratch space of getJointCount matrices
+	void computePalette(const glm::mat4* locals, glm::mat4* globals, glm::mat4* palette) const;
+private:
+	std::vector<int> parents;
+	std::vector<glm::vec3> bindPositions;
+	std::vector<glm::fquat> bindRotations;
+	std::vector<glm::vec3> bindScales;
+	std::vector<glm::mat4> bindLocals;
+	std::unordered_map<std::string, unsigned int> jointIndices;
+	std::vector<unsigned int> boneJoints;
+	std::vector<glm::mat4> boneOffsets;
+	glm::mat4 globalInverse = glm::mat4(1.0f);
+};
+
+//Plays the clips of one skeleton, one per skinned instance. The skeleton and the clips belong to
+//the model and have to outlive the animator. Animators share nothing, so any number of them can
+//be updated at once on different threads
+class Animator
+{
+public:
+	Animator(const Skeleton& skeleton, const std::vector<CompressedClip>& clips);
+
+	//-1 goes back to the bind pose
+	void play(int clip, bool loop = true);
+	//Blends from the playing clip into the new one over duration seconds. Joints only the old clip
+	//animates hold its pose until the fade ends
+	void crossFade(int clip, float duration, bool loop = true);
+	void setTime(float time) { this->time = time; }
+	float getTime() const { return time; }
+	//Advances the clip and rebuilds the palette
+	void update(float deltaTime);
+	//Updates every animator, spread over the JobSystem workers
+	static void updateAll(Animator* animators, unsigned int count, float deltaTime);
+
+	const std::vector<glm::mat4>& getPalette() const { return palette; }
+	//Pose and palette storage of this instance, the clips are shared and not counted
+	size_t getMemoryBytes() const;
+private:
+	void resetPose();
+	float advance(const CompressedClip& clip, float time, float deltaTime, bool loop) const;
+
+	const Skeleton* skeleton;
+	const std::vector<CompressedClip>* clips;
+	int clip = -1;
+	float time = 0;
+	bool loop = true;
+	int previousClip = -1;
+	float previousTime = 0;
+	bool previousLoop = true;
+	float fadeDuration = 0;
+	float fadeElapsed = 0;
+
+	//Indexed by joint like locals, only the joints of the playing clips are sampled
+	std::vector<glm::vec3> positions;
+	std::vector<glm::fquat> rotations;
+	std::vector<glm::vec3> scales;
+	std::vector<glm::mat4> locals;
+	std::vector<glm::mat4> globals;
+	std::vector<glm::mat4> palette;
+};
\ No newline at end of file
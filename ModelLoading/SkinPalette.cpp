@@ -0,0 +1,63 @@
+#include "SkinPalette.h"
+#include "Shader.h"
+#include <glad/glad.h>
+
+SkinPalette::SkinPalette()
+{
+	glGenBuffers(1, &buffer);
+	glGenTextures(1, &texture);
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(BoneRows), nullptr, GL_STREAM_DRAW);
+	glBindTexture(GL_TEXTURE_BUFFER, texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+SkinPalette::~SkinPalette()
+{
+	glDeleteBuffers(1, &buffer);
+	glDeleteTextures(1, &texture);
+}
+
+void SkinPalette::begin()
+{
+	bones.clear();
+}
+
+unsigned int SkinPalette::add(const glm::mat4* matrices, unsigned int count)
+{
+	unsigned int offset = bones.size();
+	bones.resize(offset + count);
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		const glm::mat4& m = matrices[i];
+		BoneRows& out = bones[offset + i];
+		for (int row = 0; row < 3; ++row)
+		{
+			out.rows[row] = glm::vec4(m[0][row], m[1][row], m[2][row], m[3][row]);
+		}
+	}
+	return offset;
+}
+
+void SkinPalette::upload()
+{
+	if (bones.empty())
+	{
+		return;
+	}
+	//Orphaned every frame, the driver hands out fresh storage while the last frame still reads the old one
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(BoneRows) * bones.size(), bones.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void SkinPalette::bind(Shader& shader) const
+{
+	shader.use();
+	glUniform1i(glGetUniformLocation(shader.getID(), "bonePalette"), textureUnit);
+	glActiveTexture(GL_TEXTURE0 + textureUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, texture);
+	glActiveTexture(GL_TEXTURE0);
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+class Shader;
+
+//Top three rows of a bone matrix, the last row of an affine transform is implied
+struct BoneRows
+{
+	glm::vec4 rows[3];
+};
+
+//Bone matrices of every skinned instance drawn in a frame, packed into one texture buffer and sent
+//with a single upload. Each instance adds its palette and passes the returned offset with its meshes
+//to IndirectRenderer::add, so any number of skinned instances share one multi draw
+class SkinPalette
+{
+public:
+	//Texture unit of the palette, below the draw data buffer of the IndirectRenderer
+	static const unsigned int textureUnit = 6;
+
+	SkinPalette();
+	~SkinPalette();
+	SkinPalette(const SkinPalette&) = delete;
+	SkinPalette& operator=(const SkinPalette&) = delete;
+
+	void begin();
+	//Returns the index of the first bone, which the shader adds to the vertex bone indices
+	unsigned int add(const glm::mat4* matrices, unsigned int count);
+	void upload();
+	//Uses the shader and points its bonePalette sampler at the buffer
+	void bind(Shader& shader) const;
+
+	unsigned int getBoneCount() const { return bones.size(); }
+private:
+	unsigned int buffer;
+	unsigned int texture;
+	std::vector<BoneRows> bones;
+};
\ No newline at end of file
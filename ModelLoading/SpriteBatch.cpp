@@ -0,0 +1,155 @@
+#include "SpriteBatch.h"
+#include "Window.h"
+#include "Shader.h"
+#include "Model.h"
+#include <algorithm>
+#include <cstddef>
+
+SpriteBatch::SpriteBatch(unsigned int spritesPerRegion)
+	: vertices(sizeof(SpriteVertex) * 4 * spritesPerRegion)
+{
+	this->spritesPerRegion = spritesPerRegion;
+
+	//Indices only address one region, the region is selected with the base vertex
+	std::vector<unsigned int> indices;
+	indices.reserve(spritesPerRegion * 6);
+	for (unsigned int i = 0; i < spritesPerRegion; ++i)
+	{
+		unsigned int first = i * 4;
+		indices.push_back(first + 0);
+		indices.push_back(first + 1);
+		indices.push_back(first + 3);
+		indices.push_back(first + 1);
+		indices.push_back(first + 2);
+		indices.push_back(first + 3);
+	}
+
+	glGenVertexArrays(1, &VAO);
+	glBindVertexArray(VAO);
+	glGenBuffers(1, &EBO);
+	glBindBuffer(GL_ARRAY_BUFFER, vertices.getBuffer());
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), indices.data(), GL_STATIC_DRAW);
+
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, x));
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, u));
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, r));
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+SpriteBatch::~SpriteBatch()
+{
+	glDeleteBuffers(1, &EBO);
+	glDeleteVertexArrays(1, &VAO);
+}
+
+void SpriteBatch::begin()
+{
+	queue.clear();
+	stats = SpriteBatchStats();
+	vertices.resetStats();
+	vertices.beginFrame();
+}
+
+void SpriteBatch::draw(unsigned int texture, const glm::mat4& model, const glm::vec4& tint, const glm::vec4& uvRect)
+{
+	QueuedSprite sprite;
+	sprite.model = model;
+	sprite.tint = tint;
+	sprite.uvRect = uvRect;
+	sprite.texture = texture;
+	queue.push_back(sprite);
+}
+
+void SpriteBatch::draw(const Sprite& sprite, const glm::vec4& tint)
+{
+	draw(sprite.getTexture(), sprite.getTransform(), tint);
+}
+
+void SpriteBatch::writeQuad(SpriteVertex* out, const QueuedSprite& sprite) const
+{
+	//Same corner order and uvs as Sprite::verticesData
+	static const float corners[4][4] = {
+		{ 0.5f,  0.5f, 1.0f, 1.0f },
+		{ 0.5f, -0.5f, 1.0f, 0.0f },
+		{ -0.5f, -0.5f, 0.0f, 0.0f },
+		{ -0.5f,  0.5f, 0.0f, 1.0f }
+	};
+	const glm::mat4& m = sprite.model;
+	for (int i = 0; i < 4; ++i)
+	{
+		glm::vec4 world = m[0] * corners[i][0] + m[1] * corners[i][1] + m[3];
+		out[i].x = world.x;
+		out[i].y = world.y;
+		out[i].z = world.z;
+		out[i].u = sprite.uvRect.x + corners[i][2] * sprite.uvRect.z;
+		out[i].v = sprite.uvRect.y + corners[i][3] * sprite.uvRect.w;
+		out[i].r = sprite.tint.r;
+		out[i].g = sprite.tint.g;
+		out[i].b = sprite.tint.b;
+		out[i].a = sprite.tint.a;
+	}
+}
+
+void SpriteBatch::end(Window& window, Shader& shader)
+{
+	stats.sprites = queue.size();
+	if (queue.empty())
+	{
+		vertices.endFrame();
+		return;
+	}
+
+	sortKeys.resize(queue.size());
+	for (unsigned int i = 0; i < queue.size(); ++i)
+	{
+		sortKeys[i] = ((uint64_t)queue[i].texture << 32) | i;
+	}
+	std::sort(sortKeys.begin(), sortKeys.end());
+
+	shader.use();
+	glUniform1i(glGetUniformLocation(shader.getID(), "textureApply"), 0);
+	window.bindFrameData();
+	glActiveTexture(GL_TEXTURE0);
+	glBindVertexArray(VAO);
+
+	//Anything that does not fit in one region wraps into the next one, the ring fences what was drawn so far
+	unsigned int written = 0;
+	while (written < sortKeys.size())
+	{
+		unsigned int chunk = std::min(spritesPerRegion, (unsigned int)sortKeys.size() - written);
+		RingAllocation allocation = vertices.allocate(sizeof(SpriteVertex) * 4 * chunk, sizeof(SpriteVertex));
+		SpriteVertex* quads = (SpriteVertex*)allocation.data;
+		for (unsigned int i = 0; i < chunk; ++i)
+		{
+			writeQuad(quads + i * 4, queue[(uint32_t)sortKeys[written + i]]);
+		}
+		vertices.flush();
+
+		GLint baseVertex = allocation.offset / sizeof(SpriteVertex);
+		unsigned int runStart = 0;
+		while (runStart < chunk)
+		{
+			unsigned int texture = queue[(uint32_t)sortKeys[written + runStart]].texture;
+			unsigned int runEnd = runStart + 1;
+			while (runEnd < chunk && queue[(uint32_t)sortKeys[written + runEnd]].texture == texture)
+			{
+				++runEnd;
+			}
+			glBindTexture(GL_TEXTURE_2D, texture);
+			glDrawElementsBaseVertex(GL_TRIANGLES, (runEnd - runStart) * 6, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int) * 6 * runStart), baseVertex);
+			++stats.drawCalls;
+			runStart = runEnd;
+		}
+		written += chunk;
+	}
+	glBindVertexArray(0);
+	vertices.endFrame();
+	stats.fenceWaits = vertices.getStats().stalls;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "GpuRingBuffer.h"
+
+class Window;
+class Shader;
+class Sprite;
+
+//Vertex written by the batch, positions are already in world space
+struct SpriteVertex
+{
+	float x;
+	float y;
+	float z;
+
+	float u;
+	float v;
+
+	float r;
+	float g;
+	float b;
+	float a;
+};
+
+struct SpriteBatchStats
+{
+	unsigned int sprites = 0;
+	unsigned int drawCalls = 0;
+	//Times the CPU had to wait for the GPU to release a region of the buffer
+	unsigned int fenceWaits = 0;
+};
+
+//Collects sprites between begin and end, sorts them by texture (atlas page) and streams the
+//transformed quads through a triple buffered GpuRingBuffer, so each texture costs one draw call
+class SpriteBatch
+{
+public:
+	SpriteBatch(unsigned int spritesPerRegion = 16384);
+	~SpriteBatch();
+	SpriteBatch(const SpriteBatch&) = delete;
+	SpriteBatch& operator=(const SpriteBatch&) = delete;
+
+	void begin();
+	//uvRect is (u, v, width, height) of the sub image for atlases, the whole texture by default
+	void draw(unsigned int texture, const glm::mat4& model, const glm::vec4& tint = glm::vec4(1, 1, 1, 1), const glm::vec4& uvRect = glm::vec4(0, 0, 1, 1));
+	void draw(const Sprite& sprite, const glm::vec4& tint = glm::vec4(1, 1, 1, 1));
+	void end(Window& window, Shader& shader);
+
+	const SpriteBatchStats& getStats() const { return stats; }
+	bool isPersistent() const { return vertices.isPersistent(); }
+private:
+	struct QueuedSprite
+	{
+		glm::mat4 model;
+		glm::vec4 tint;
+		glm::vec4 uvRect;
+		unsigned int texture;
+	};
+
+	void writeQuad(SpriteVertex* out, const QueuedSprite& sprite) const;
+
+	unsigned int VAO;
+	unsigned int EBO;
+	unsigned int spritesPerRegion;
+	//One region per begin/end pair
+	GpuRingBuffer vertices;
+
+	std::vector<QueuedSprite> queue;
+	//Texture in the high bits, queue index in the low bits
+	std::vector<uint64_t> sortKeys;
+	SpriteBatchStats stats;
+};
@@ -0,0 +1,153 @@
+#pragma once
+#include <coroutine>
+#include <atomic>
+#include <exception>
+#include <optional>
+#include <utility>
+
+//State shared by every Task promise. The task starts running as soon as it is created, whoever
+//awaits it later either finds it finished or leaves its handle in state to be resumed by the
+//thread that finishes it. state is null while running with nobody waiting, a waiting handle, or
+//one of the two tags below
+class TaskPromiseBase
+{
+public:
+	std::suspend_never initial_suspend() noexcept { return {}; }
+
+	struct FinalAwaiter
+	{
+		bool await_ready() noexcept { return false; }
+		template<typename Promise>
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+		{
+			void* waiting = handle.promise().state.exchange(&finishedTag, std::memory_order_acq_rel);
+			if (waiting == &detachedTag)
+			{
+				//The Task was dropped while running, nobody else will free the frame
+				handle.destroy();
+				return std::noop_coroutine();
+			}
+			if (waiting)
+			{
+				return std::coroutine_handle<>::from_address(waiting);
+			}
+			return std::noop_coroutine();
+		}
+		void await_resume() noexcept {}
+	};
+	FinalAwaiter final_suspend() noexcept { return {}; }
+	void unhandled_exception() { exception = std::current_exception(); }
+
+	bool isFinished() const { return state.load(std::memory_order_acquire) == &finishedTag; }
+	//Returns false when the task finished in the meantime and the awaiting coroutine should carry on
+	bool setContinuation(std::coroutine_handle<> continuation)
+	{
+		void* expected = nullptr;
+		return state.compare_exchange_strong(expected, continuation.address(), std::memory_order_acq_rel, std::memory_order_acquire);
+	}
+	//Returns true when the task already finished and its frame can be destroyed right away
+	bool detach() { return state.exchange(&detachedTag, std::memory_order_acq_rel) == &finishedTag; }
+	void rethrow()
+	{
+		if (exception)
+		{
+			std::rethrow_exception(exception);
+		}
+	}
+private:
+	std::atomic<void*> state{ nullptr };
+	std::exception_ptr exception;
+
+	static inline char finishedTag = 0;
+	static inline char detachedTag = 0;
+};
+
+template<typename T>
+class Task;
+
+template<typename T>
+class TaskPromise : public TaskPromiseBase
+{
+public:
+	Task<T> get_return_object();
+	void return_value(T value) { result.emplace(std::move(value)); }
+	T takeResult()
+	{
+		rethrow();
+		return std::move(*result);
+	}
+private:
+	std::optional<T> result;
+};
+
+template<>
+class TaskPromise<void> : public TaskPromiseBase
+{
+public:
+	Task<void> get_return_object();
+	void return_void() {}
+	void takeResult() { rethrow(); }
+};
+
+//Eagerly started coroutine that can be awaited once, from another coroutine with co_await or from
+//plain code by polling isReady and calling get. Exceptions thrown inside come out of the await.
+//Dropping an unfinished task is allowed, the frame frees itself when the coroutine ends
+template<typename T = void>
+class Task
+{
+public:
+	using promise_type = TaskPromise<T>;
+
+	Task() {}
+	explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+	Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+	Task& operator=(Task&& other) noexcept
+	{
+		if (this != &other)
+		{
+			release();
+			handle = std::exchange(other.handle, nullptr);
+		}
+		return *this;
+	}
+	Task(const Task&) = delete;
+	Task& operator=(const Task&) = delete;
+	~Task() { release(); }
+
+	bool isValid() const { return (bool)handle; }
+	bool isReady() const { return handle && handle.promise().isFinished(); }
+	//Only valid once isReady returns true, the result is moved out
+	T get() { return handle.promise().takeResult(); }
+
+	struct Awaiter
+	{
+		std::coroutine_handle<promise_type> handle;
+
+		bool await_ready() const noexcept { return handle.promise().isFinished(); }
+		bool await_suspend(std::coroutine_handle<> awaiting) noexcept { return handle.promise().setContinuation(awaiting); }
+		T await_resume() { return handle.promise().takeResult(); }
+	};
+	Awaiter operator co_await() noexcept { return Awaiter{ handle }; }
+private:
+	void release()
+	{
+		if (handle && handle.promise().detach())
+		{
+			handle.destroy();
+		}
+		handle = nullptr;
+	}
+
+	std::coroutine_handle<promise_type> handle;
+};
+
+template<typename T>
+Task<T> TaskPromise<T>::get_return_object()
+{
+	return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object()
+{
+	return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
\ No newline at end of file
@@ -0,0 +1,77 @@
+#pragma once
+#include <glm/glm.hpp>
+#include "SimdMath.h"
+
+//CPU side of the std140 uniform blocks used by the shaders. Shader assigns the binding points
+//after linking, the data itself is written through the window's uniform ring buffer
+
+struct FrameData
+{
+	static const unsigned int binding = 0;
+
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec4 viewPos;
+	float time;
+	float padding[3];
+};
+
+struct ObjectData
+{
+	static const unsigned int binding = 1;
+
+	ObjectData() {}
+	ObjectData(const glm::mat4& model)
+	{
+		this->model = model;
+		normalMatrix = simd::normalMatrix(model);
+	}
+	//For transforms whose normal matrix is already known, such as SceneGraph nodes
+	ObjectData(const glm::mat4& model, const glm::mat4& normalMatrix)
+	{
+		this->model = model;
+		this->normalMatrix = normalMatrix;
+	}
+
+	glm::mat4 model = glm::mat4(1.0f);
+	glm::mat4 normalMatrix = glm::mat4(1.0f);
+};
+
+//One uvec4 per material, filled by MaterialLibrary. With texture arrays it holds (diffuse array,
+//diffuse layer, specular array, specular layer), with bindless textures the two 64 bit handles
+struct MaterialData
+{
+	static const unsigned int binding = 3;
+	static const unsigned int maxMaterials = 256;
+};
+
+//Matches a block holding one DirectionalLight struct, every vec3 is padded to 16 bytes
+struct LightData
+{
+	static const unsigned int binding = 2;
+
+	LightData() {}
+	LightData(const glm::vec3& direction)
+	{
+		this->direction = glm::vec4(direction, 0.0f);
+	}
+
+	glm::vec4 direction = glm::vec4(0, -1, 0, 0);
+	glm::vec4 ambient = glm::vec4(0.2f, 0.2f, 0.2f, 0.0f);
+	glm::vec4 diffuse = glm::vec4(0.5f, 0.5f, 0.5f, 0.0f);
+	glm::vec4 specular = glm::vec4(1, 1, 1, 0);
+};
+
+//The Gerstner waves summed by the water shader, filled by GerstnerWaves
+struct WaveData
+{
+	static const unsigned int binding = 4;
+	static const unsigned int maxWaves = 8;
+
+	//Per wave (direction x, direction z, wave number, angular frequency)
+	glm::vec4 shape[maxWaves];
+	//Per wave (amplitude, sideways amplitude, 0, 0)
+	glm::vec4 size[maxWaves];
+	int count = 0;
+	int padding[3];
+};
\ No newline at end of file
@@ -0,0 +1,162 @@
+#include "WaterClipmap.h"
+#include "Shader.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	void addCell(std::vector<unsigned int>& indices, unsigned int i, unsigned int j)
+	{
+		//Two triangles per cell, wound like the uniform grid was
+		unsigned int row = WaterClipmap::gridSize;
+		unsigned int corner = i * row + j;
+		indices.insert(indices.end(), { corner, corner + row, corner + row + 1 });
+		indices.insert(indices.end(), { corner, corner + row + 1, corner + 1 });
+	}
+}
+
+WaterClipmap::WaterClipmap(float width, float height, float cellSize)
+{
+	halfExtent = glm::vec2(width, height) * 0.5f;
+	this->cellSize = cellSize;
+	//The camera can sit a cell off the centre of each level, so only the inner ring cells are counted
+	float reach = (gridSize / 2 - 1) * cellSize;
+	levelCount = 1;
+	while (reach < 2.0f * std::max(halfExtent.x, halfExtent.y) && levelCount < 16)
+	{
+		reach *= 2;
+		++levelCount;
+	}
+
+	//Lattice coordinates only, the level origin and spacing place them
+	std::vector<float> vertices;
+	vertices.reserve(gridSize * gridSize * 2);
+	for (unsigned int i = 0; i < gridSize; ++i)
+	{
+		for (unsigned int j = 0; j < gridSize; ++j)
+		{
+			vertices.push_back((float)i);
+			vertices.push_back((float)j);
+		}
+	}
+
+	const unsigned int holeBegin = ringCells;
+	const unsigned int holeEnd = gridSize - 1 - ringCells;
+	auto inHole = [&](unsigned int i) { return i >= holeBegin && i < holeEnd; };
+	std::vector<unsigned int> indices;
+	ring.first = indices.size();
+	for (unsigned int i = 0; i < gridSize - 1; ++i)
+	{
+		for (unsigned int j = 0; j < gridSize - 1; ++j)
+		{
+			if (!inHole(i) || !inHole(j))
+			{
+				addCell(indices, i, j);
+			}
+		}
+	}
+	ring.count = indices.size() - ring.first;
+	centre.first = indices.size();
+	for (unsigned int i = holeBegin; i < holeEnd; ++i)
+	{
+		for (unsigned int j = holeBegin; j < holeEnd; ++j)
+		{
+			addCell(indices, i, j);
+		}
+	}
+	centre.count = indices.size() - centre.first;
+	for (unsigned int trim = 0; trim < 4; ++trim)
+	{
+		unsigned int column = trim & 1 ? holeEnd - 1 : holeBegin;
+		unsigned int row = trim & 2 ? holeEnd - 1 : holeBegin;
+		trims[trim].first = indices.size();
+		for (unsigned int k = holeBegin; k < holeEnd; ++k)
+		{
+			addCell(indices, column, k);
+			if (k != column)
+			{
+				addCell(indices, k, row);
+			}
+		}
+		trims[trim].count = indices.size() - trims[trim].first;
+	}
+
+	glGenVertexArrays(1, &VAO);
+	glBindVertexArray(VAO);
+	glGenBuffers(1, &VBO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
+	glGenBuffers(1, &EBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), indices.data(), GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 2, (void*)0);
+	glEnableVertexAttribArray(0);
+	glBindVertexArray(0);
+}
+
+WaterClipmap::~WaterClipmap()
+{
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(1, &VBO);
+	glDeleteBuffers(1, &EBO);
+}
+
+std::vector<ClipmapLevel> WaterClipmap::placeLevels(const glm::vec2& camera) const
+{
+	std::vector<ClipmapLevel> levels(levelCount);
+	float spacing = cellSize;
+	float half = (gridSize - 1) / 2;
+	for (int axis = 0; axis < 2; ++axis)
+	{
+		levels[0].origin[axis] = std::round((camera[axis] - half * spacing) / (2 * spacing)) * 2 * spacing;
+	}
+	levels[0].spacing = spacing;
+	levels[0].trim = 0;
+	for (unsigned int level = 1; level < levelCount; ++level)
+	{
+		spacing *= 2;
+		const glm::vec2& inner = levels[level - 1].origin;
+		ClipmapLevel& placed = levels[level];
+		placed.spacing = spacing;
+		placed.trim = 0;
+		//The inner level sits ringCells or ringCells + 1 cells in, whichever keeps this origin on
+		//the lattice of the next level out. The trim fills the cell on the other side
+		for (int axis = 0; axis < 2; ++axis)
+		{
+			long long cell = (long long)std::llround(inner[axis] / spacing);
+			bool even = ((cell - ringCells) & 1) == 0;
+			placed.origin[axis] = inner[axis] - (even ? ringCells : ringCells + 1) * spacing;
+			if (even)
+			{
+				placed.trim |= 1 << axis;
+			}
+		}
+	}
+	return levels;
+}
+
+void WaterClipmap::draw(Shader& shader, const glm::vec2& camera) const
+{
+	shader.use();
+	glUniform2f(glGetUniformLocation(shader.getID(), "halfExtent"), halfExtent.x, halfExtent.y);
+	int levelLocation = glGetUniformLocation(shader.getID(), "clipLevel");
+	glBindVertexArray(VAO);
+	std::vector<ClipmapLevel> levels = placeLevels(camera);
+	for (unsigned int level = 0; level < levels.size(); ++level)
+	{
+		glUniform3f(levelLocation, levels[level].origin.x, levels[level].origin.y, levels[level].spacing);
+		drawRange(ring);
+		drawRange(level == 0 ? centre : trims[levels[level].trim]);
+	}
+}
+
+void WaterClipmap::drawRange(const IndexRange& range) const
+{
+	glDrawElements(GL_TRIANGLES, range.count, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int) * range.first));
+}
+
+unsigned int WaterClipmap::getTriangleCount() const
+{
+	return (ring.count * levelCount + centre.count + trims[0].count * (levelCount - 1)) / 3;
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+class Shader;
+
+//Where one level of the clipmap sits in the water's object space
+struct ClipmapLevel
+{
+	//Object space position of lattice vertex 0, 0
+	glm::vec2 origin;
+	float spacing;
+	//Side of the hole the one cell wide trim fills, bit 0 set for high x and bit 1 for high y
+	unsigned int trim;
+};
+
+//Geometry clipmap of the flat water grid. Every level is the same square lattice of gridSize
+//vertices per side with twice the spacing of the level inside it, so the vertices drawn stay the
+//same however large the surface is. Levels snap to twice their own spacing around the camera, which
+//leaves each level's hole one cell wider than the level inside it, and that cell is filled by an
+//L shaped trim on the side away from the camera. The finest level fills its hole instead. The
+//vertex shader slides the odd vertices near a level's outer edge onto the coarser lattice, so the
+//edges of neighbouring levels match exactly
+class WaterClipmap
+{
+public:
+	static const unsigned int gridSize = 63;
+	//Cells of the ring on each side of the hole
+	static const unsigned int ringCells = 15;
+
+	//Enough levels are made for the coarsest to cover the whole surface from anywhere above it.
+	//Vertices falling outside the surface are clamped to its edge by the shader
+	WaterClipmap(float width, float height, float cellSize);
+	~WaterClipmap();
+	WaterClipmap(const WaterClipmap&) = delete;
+	WaterClipmap& operator=(const WaterClipmap&) = delete;
+
+	//Levels around the camera, given in object space, finest first
+	std::vector<ClipmapLevel> placeLevels(const glm::vec2& camera) const;
+	//Uses the shader and draws every level, the shader's clipLevel and halfExtent uniforms are set here
+	void draw(Shader& shader, const glm::vec2& camera) const;
+
+	unsigned int getLevelCount() const { return levelCount; }
+	glm::vec2 getHalfExtent() const { return halfExtent; }
+	//Triangles drawn each frame, wherever the camera is
+	unsigned int getTriangleCount() const;
+private:
+	struct IndexRange
+	{
+		unsigned int first;
+		unsigned int count;
+	};
+	void drawRange(const IndexRange& range) const;
+
+	unsigned int VAO;
+	unsigned int VBO;
+	unsigned int EBO;
+	glm::vec2 halfExtent;
+	float cellSize;
+	unsigned int levelCount;
+	IndexRange ring;
+	IndexRange centre;
+	IndexRange trims[4];
+};
\ No newline at end of file
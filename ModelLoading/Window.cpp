@@ -1,8 +1,10 @@
 #include "Window.h"
+#include "GLExtensions.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <string>
 #include <functional>
+#include <algorithm>
 
 bool Window::glfwInited = false;
 
@@ -10,6 +12,7 @@ int Window::numWindows = 0;
 
 Window::~Window()
 {
+	uniformRing.reset();
 	--numWindows;
 	if (numWindows == 0)
 	{
@@ -94,6 +97,8 @@ Window::Window(unsigned int width, unsigned int height, const std::string& title
 		glfwSetCursorPosCallback(window, mousePosCallback);
 	}
 	gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+	GLExtensions::load();
+	uniformRing = std::make_unique<GpuRingBuffer>(4 * 1024 * 1024);
 	glEnable(GL_CULL_FACE);
 	glEnable(GL_DEPTH_TEST);
 	glEnable(GL_BLEND);
@@ -115,9 +120,48 @@ void Window::disableFaceCulling() const
 	glDisable(GL_CULL_FACE);
 }
 
-void Window::swapBuffers() const
+void Window::swapBuffers()
 {
+	uniformRing->endFrame();
 	glfwSwapBuffers(window);
+	uniformRing->beginFrame();
+	frameTime = glfwGetTime();
+	culler.endFrame();
+}
+
+void Window::bindFrameData()
+{
+	//A copy from before the ring changed region is in one that is fenced and will be reused, so draws
+	//after the change need a copy in the current region
+	if (frameDataDirty || frameDataRegion != uniformRing->getRegionChanges())
+	{
+		FrameData data;
+		data.view = view;
+		data.projection = projection;
+		data.viewPos = glm::vec4(cameraPosition, 1.0f);
+		data.time = frameTime;
+		frameDataAllocation = uniformRing->allocateUniform(sizeof(FrameData));
+		frameDataRegion = uniformRing->getRegionChanges();
+		memcpy(frameDataAllocation.data, &data, sizeof(FrameData));
+		frameDataDirty = false;
+	}
+	uniformRing->bindRange(GL_UNIFORM_BUFFER, FrameData::binding, frameDataAllocation);
+}
+
+unsigned int Window::getWidth() const
+{
+	int width;
+	int height;
+	glfwGetFramebufferSize(window, &width, &height);
+	return std::max(width, 1);
+}
+
+unsigned int Window::getHeight() const
+{
+	int width;
+	int height;
+	glfwGetFramebufferSize(window, &width, &height);
+	return std::max(height, 1);
 }
 
 void Window::clear() const
@@ -131,3 +175,13 @@ bool Window::shouldClose() const
 {
 	return glfwWindowShouldClose(window);
 }
+
+FrustumCuller& Window::getCuller()
+{
+	if (frustumDirty)
+	{
+		culler.setViewProjection(projection * view);
+		frustumDirty = false;
+	}
+	return culler;
+}
\ No newline at end of file
@@ -4,11 +4,17 @@
 #include <GLFW/glfw3.h>
 #include "Shader.h"
 #include "Drawable.h"
+#include "GpuRingBuffer.h"
+#include "UniformBlocks.h"
+#include "FrustumCuller.h"
+#include "OcclusionCuller.h"
+#include "HiZCuller.h"
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/glm.hpp>
 #include <glm/gtx/quaternion.hpp>
 
 #include <string>
+#include <memory>
 
 class Window
 {
@@ -17,23 +23,41 @@ public:
 	~Window();
 	bool shouldClose() const;
 	void clear() const;
-	void swapBuffers() const;
+	//Also closes the frame of the uniform ring and starts the next one
+	void swapBuffers();
 	void draw(Drawable& drawable, Shader& shader) { drawable.draw(*this, shader); }
 	void setClearColor(const glm::vec4& clearColor) { this->clearColor = clearColor; }
 
-	void setCameraPosition(const glm::vec3& pos) { cameraPosition = pos; view = glm::toMat4(cameraRotation) * glm::translate(glm::mat4(1.0f), cameraPosition); }
-	void rotateCamera(const glm::fquat& rot) { cameraRotation = rot * cameraRotation; view = glm::toMat4(cameraRotation) * glm::translate(glm::mat4(1.0f), cameraPosition); }
-	void setView(const glm::vec3& pos, const glm::vec3& center, const glm::vec3& up) { this->view = glm::lookAt(pos, center, up); this->cameraPosition = pos; }
-	void setView(const glm::mat4& view) { this->view = view; }
+	void setCameraPosition(const glm::vec3& pos) { cameraPosition = pos; view = glm::toMat4(cameraRotation) * glm::translate(glm::mat4(1.0f), cameraPosition); frameDataDirty = true; frustumDirty = true; }
+	void rotateCamera(const glm::fquat& rot) { cameraRotation = rot * cameraRotation; view = glm::toMat4(cameraRotation) * glm::translate(glm::mat4(1.0f), cameraPosition); frameDataDirty = true; frustumDirty = true; }
+	void setView(const glm::vec3& pos, const glm::vec3& center, const glm::vec3& up) { this->view = glm::lookAt(pos, center, up); this->cameraPosition = pos; frameDataDirty = true; frustumDirty = true; }
+	void setView(const glm::mat4& view) { this->view = view; frameDataDirty = true; frustumDirty = true; }
 	void enableFaceCulling() const;
 	void disableFaceCulling() const;
-	void setProjection(const glm::mat4& proj) { this->projection = proj; }
+	void setProjection(const glm::mat4& proj) { this->projection = proj; frameDataDirty = true; frustumDirty = true; }
 
 	void processEvents(float dt);
 
 	glm::vec3 getCameraPosition() const { return cameraPosition; }
 	const glm::mat4& getView() const { return view; }
 	const glm::mat4& getProjection() const { return projection; }
+	float getFrameTime() const { return frameTime; }
+	//Size of the window's framebuffer in pixels, at least 1 so a minimized window still has an aspect ratio
+	unsigned int getWidth() const;
+	unsigned int getHeight() const;
+
+	//Per frame uniform data is allocated from here and bound by offset
+	GpuRingBuffer& getUniformRing() { return *uniformRing; }
+	//Uploads the camera when it changed since the last call and binds it to the FrameData block
+	void bindFrameData();
+	//Frustum of the current view and projection, its stats are moved to the last frame ones in swapBuffers
+	FrustumCuller& getCuller();
+	//Occluders rasterized for this frame, models drawn through the window skip meshes hidden behind them
+	void setOcclusionCuller(OcclusionCuller* occlusionCuller) { this->occlusionCuller = occlusionCuller; }
+	OcclusionCuller* getOcclusionCuller() const { return occlusionCuller; }
+	//Visibility from the depth of earlier frames, models drawn through the window skip meshes it found hidden
+	void setHiZCuller(HiZCuller* hiZCuller) { this->hiZCuller = hiZCuller; }
+	HiZCuller* getHiZCuller() const { return hiZCuller; }
 
 
 	glm::vec3 front = glm::vec3(0, 0, 1);
@@ -54,4 +78,15 @@ private:
 	glm::mat4 projection;
 	glm::mat4 view;
 	glm::vec3 cameraPosition = glm::vec3(0, 0, -3);
+
+	std::unique_ptr<GpuRingBuffer> uniformRing;
+	RingAllocation frameDataAllocation;
+	bool frameDataDirty = true;
+	//Region changes of the uniform ring when frameDataAllocation was made
+	unsigned int frameDataRegion = 0;
+	FrustumCuller culler;
+	bool frustumDirty = true;
+	OcclusionCuller* occlusionCuller = nullptr;
+	HiZCuller* hiZCuller = nullptr;
+	float frameTime = 0;
 };
\ No newline at end of file